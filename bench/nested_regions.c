@@ -0,0 +1,87 @@
+// Measures the cost of a start and end measurement pair on nested regions. Each iteration starts DEPTH nested routines
+// and ends them again, cycling over CHAINS chains of distinct routines so that the readings touched grow with the number
+// of routines. With EVICT_KB the iterations first walk a buffer of that size, evicting the readings from the cache as
+// the work of an application does, and the same loop without measurements is taken off.
+//
+// Usage: nested_regions_bench [DEPTH [CHAINS [ITERATIONS [EVICT_KB]]]]
+//
+// The best of several runs is reported in nanoseconds per pair. Build in Release and use the timer backend to measure
+// the library rather than the counters, e.g. STOPWATCH_BACKEND=timer ./nested_regions_bench 16 30 200000
+//
+// Differences of a few percent are within the spread between runs. To compare two builds, pin both to the same CPU
+// with taskset -c, alternate between them over many repetitions and compare the medians. With EVICT_KB the loops with
+// and without measurements are timed separately, so a single result may be far off or even negative.
+#include "stopwatch/stopwatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_RUNS 7
+#define CACHE_LINE_SIZE 64
+
+static volatile long sink;
+
+static double now_nsec() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) now.tv_sec * 1e9 + (double) now.tv_nsec;
+}
+
+// Shortest of the runs in nanoseconds
+static double run(size_t depth, size_t chains, size_t iterations, char *buffer, size_t buffer_size, int measure) {
+  double best = -1;
+  for (int run_idx = 0; run_idx < NUM_RUNS; run_idx++) {
+    const double start = now_nsec();
+    for (size_t iteration = 0; iteration < iterations; iteration++) {
+      long touched = 0;
+      for (size_t offset = 0; offset < buffer_size; offset += CACHE_LINE_SIZE) {
+        buffer[offset]++;
+        touched += buffer[offset];
+      }
+      sink = touched;
+      if (!measure) {
+        continue;
+      }
+      const size_t first_id = 1 + (iteration % chains) * depth;
+      for (size_t level = 0; level < depth; level++) {
+        stopwatch_record_start_measurements(first_id + level, "nested", level == 0 ? 0 : first_id + level - 1);
+      }
+      for (size_t level = depth; level-- > 0;) {
+        stopwatch_record_end_measurements(first_id + level);
+      }
+    }
+    const double elapsed = now_nsec() - start;
+    if (best < 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  const size_t depth = argc > 1 ? strtoul(argv[1], NULL, 10) : 16;
+  const size_t chains = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  const size_t iterations = argc > 3 ? strtoul(argv[3], NULL, 10) : 200000;
+  const size_t buffer_size = (argc > 4 ? strtoul(argv[4], NULL, 10) : 0) * 1024;
+  // Routine 0 is the root of every chain
+  if (depth == 0 || chains == 0 || iterations == 0 || chains * depth >= STOPWATCH_MAX_FUNCTION_CALLS) {
+    fprintf(stderr, "Usage: %s [DEPTH [CHAINS [ITERATIONS [EVICT_KB]]]], with DEPTH * CHAINS below %d\n", argv[0],
+            STOPWATCH_MAX_FUNCTION_CALLS);
+    return EXIT_FAILURE;
+  }
+
+  char *buffer = calloc(1, buffer_size + 1);
+  if (buffer == NULL || stopwatch_init() != STOPWATCH_OK) {
+    fprintf(stderr, "Error initializing stopwatch\n");
+    return EXIT_FAILURE;
+  }
+
+  const double without = buffer_size == 0 ? 0 : run(depth, chains, iterations, buffer, buffer_size, 0);
+  const double with = run(depth, chains, iterations, buffer, buffer_size, 1);
+  printf("depth %zu chains %zu evict %zu KiB: %.1f ns per start/end pair\n", depth, chains, buffer_size / 1024,
+         (with - without) / (double) (iterations * depth));
+
+  stopwatch_destroy();
+  free(buffer);
+  return EXIT_SUCCESS;
+}
@@ -54,20 +54,17 @@ if (UNIX)
         find_path(PAPI_INCLUDE_DIR
                 NAMES papi.h
                 HINTS ENV PAPI_DIR
-                PATH_SUFFIXES include
-                REQUIRED)
+                PATH_SUFFIXES include)
 
         find_library(PAPI_LIBRARY
                 NAMES libpapi.a papi
                 HINTS ENV PAPI_DIR
-                PATH_SUFFIXES lib
-                REQUIRED)
-
-        message(STATUS "Found PAPI via find_path")
+                PATH_SUFFIXES lib)
 
         include(FindPackageHandleStandardArgs)
-        # handle the QUIETLY and REQUIRED arguments and set PAPI_FOUND to TRUE
-        # if all listed variables are TRUE
+        # handle the QUIETLY and REQUIRED arguments and set PAPI_FOUND to TRUE if all listed variables are TRUE. PAPI
+        # is optional for the stopwatch, so a missing header or library only fails the configure if the caller asked
+        # for find_package(PAPI REQUIRED).
         find_package_handle_standard_args(
                 PAPI
                 DEFAULT_MSG
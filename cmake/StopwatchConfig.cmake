@@ -2,7 +2,13 @@ get_filename_component(STOPWATCH_CMAKE_DIR "${CMAKE_CURRENT_LIST_FILE}" PATH)
 include(CMakeFindDependencyMacro)
 
 list(APPEND CMAKE_MODULE_PATH ${STOPWATCH_CMAKE_DIR})
-find_dependency(PAPI REQUIRED)
+# Only installed if the library was built with PAPI
+if(EXISTS "${STOPWATCH_CMAKE_DIR}/FindPAPI.cmake")
+    find_dependency(PAPI REQUIRED)
+endif()
+find_dependency(Threads REQUIRED)
+# Stopwatch::Mpi links to MPI::MPI_C, which is only needed by consumers of that library
+find_package(MPI QUIET COMPONENTS C)
 list(REMOVE_AT CMAKE_MODULE_PATH -1)
 
 if(NOT TARGET Stopwatch::Stopwatch)
@@ -0,0 +1,73 @@
+// Multiplies matrices row wise multiple times where every function is measured through compiler instrumentation. Only
+// initialization, output and clean up call the stopwatch directly.
+#include "stopwatch/stopwatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void row_major(int N, float A[N][N], float B[N][N], float C[N][N]);
+
+void single_cycle(int N, float A[N][N], float B[N][N], float C[N][N]);
+
+void total_loop(int N, int itercount, float A[N][N], float B[N][N], float C[N][N]);
+
+int main() {
+  if (stopwatch_init() != STOPWATCH_OK) {
+    printf("Error initializing stopwatch\n");
+    exit(-1);
+  }
+
+  {
+    int N = 500;
+    int itercount = 10;
+
+    // Allocate the A, B, and C arrays on the heap.
+    float (*A)[N], (*B)[N], (*C)[N];
+
+    // Use calloc for the allocation to initialize the memory to 0
+    A = calloc(sizeof(float), N * N);
+    B = calloc(sizeof(float), N * N);
+    C = calloc(sizeof(float), N * N);
+
+    // Initialize A and B to token values: i+j and i*j.  Memory accesses are base-zero.
+    for (int ii = 0; ii < N; ii++) {
+      for (int jj = 0; jj < N; jj++) {
+        A[ii][jj] = ii + jj;
+        B[ii][jj] = ii * jj;
+      }
+    }
+
+    total_loop(N, itercount, A, B, C);
+
+    free(A);
+    free(B);
+    free(C);
+
+    stopwatch_print_result_table();
+  }
+
+  stopwatch_destroy();
+}
+
+void total_loop(int N, int itercount, float A[N][N], float B[N][N], float C[N][N]) {
+  for (int iter = 0; iter < itercount; iter++) {
+    single_cycle(N, A, B, C);
+  }
+}
+
+void single_cycle(int N, float A[N][N], float B[N][N], float C[N][N]) {
+  // clear C array
+  memset(C, 0, sizeof(float) * N * N);
+  row_major(N, A, B, C);
+}
+
+void row_major(int N, float A[N][N], float B[N][N], float C[N][N]) {
+  for (int row = 0; row < N; row++) {
+    for (int col = 0; col < N; col++) {
+      // Take the product of A[row,*] and B[*,col] to set C[row,col]
+      for (int ii = 0; ii < N; ii++) {
+        C[row][col] += A[row][ii] * B[ii][col];
+      }
+    }
+  }
+}
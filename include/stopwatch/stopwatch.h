@@ -2,6 +2,11 @@
 #define STOPWATCH_STOPWATCH_H
 
 #include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Function return statuses
 enum StopwatchStatus {
   STOPWATCH_OK,
@@ -14,6 +19,16 @@ enum StopwatchStatus {
 
 #define STOPWATCH_MAX_EVENTS 10
 #define NULL_TERM_MAX_ROUTINE_NAME_LEN 16
+#define STOPWATCH_MAX_FUNCTION_CALLS 500  // Maximum number of distinct routine IDs a process measures, main included
+#define STOPWATCH_DEFAULT_SERIES_SIZE 65536  // Default series buffer size in bytes per routine per thread
+#define STOPWATCH_MAX_SLOWEST 64  // Maximum number of slowest invocations kept per routine
+#define STOPWATCH_MAX_SAMPLING_INTERVAL 65536  // Maximum number of invocations per measured invocation of a routine
+#define STOPWATCH_MAX_WORK_COUNTERS 4  // Maximum number of work counters of each routine, see `stopwatch_add_work`
+#define STOPWATCH_WORK_NAME_LEN 32
+#define STOPWATCH_EVENT_NAME_LEN 128
+#define STOPWATCH_EVENT_DESCRIPTION_LEN 256
+#define STOPWATCH_EVENT_UNITS_LEN 64
+#define STOPWATCH_EVENT_COMPONENT_LEN 64
 
 // =====================================================================================================================
 // Structure holding results for a specific entry
@@ -25,7 +40,110 @@ struct StopwatchMeasurementResult {
   char routine_name[NULL_TERM_MAX_ROUTINE_NAME_LEN];
   size_t caller_routine_id;
   size_t num_of_events;
-  int event_names[STOPWATCH_MAX_EVENTS];
+  int event_names[STOPWATCH_MAX_EVENTS];  // Event codes. Their names are available through `stopwatch_event_name`
+  // Invocations whose real time and events were measured. Less than `total_times_called` if the routine is sampled, in
+  // which case the totals are scaled up from the measured invocations.
+  long long sampled_times_called;
+  double real_usec_error;  // Half width of the 95% confidence interval of `total_real_usec`. 0 unless sampled
+  // Asynchronous invocations that ended on another thread than they started on. Their events are not part of the totals
+  long long migrated_times_called;
+  // Units of work added through `stopwatch_add_work` by every invocation, sampled or not. Each index is one counter
+  long long total_work[STOPWATCH_MAX_WORK_COUNTERS];
+  // Smallest and largest value of each event in a single invocation whose events were measured, or 0 if there was none
+  long long min_event_values[STOPWATCH_MAX_EVENTS];
+  long long max_event_values[STOPWATCH_MAX_EVENTS];
+  // Sum of the squared value of each event in every invocation, scaled up like `total_event_values` if the routine is
+  // sampled. The variance of an invocation is this over `total_times_called` less the squared mean.
+  double sum_squared_event_values[STOPWATCH_MAX_EVENTS];
+  // 1 if `min_event_values` and `max_event_values` hold the smallest and largest values, 0 if they are unknown and left
+  // 0. They are unknown if no invocation had its events measured, and always in a difference of snapshots, as the
+  // extremes within the phase cannot be taken apart from those before it.
+  int event_extremes_known;
+};
+
+// =====================================================================================================================
+// Structure holding a single invocation of a routine that keeps a series
+// =====================================================================================================================
+struct StopwatchSeriesSample {
+  long long invocation;  // Number of the invocation on the thread where the first invocation is 1
+  long long real_usec;
+  long long event_values[STOPWATCH_MAX_EVENTS];
+};
+
+// =====================================================================================================================
+// Structure holding an invocation of a routine that may end on another thread than it started on
+// =====================================================================================================================
+struct StopwatchAsyncRegion {
+  size_t routine_id;
+  long long start_real_usec;
+  long long start_event_values[STOPWATCH_MAX_EVENTS];  // Counted on the thread the region started on
+  size_t start_thread_index;  // Number of threads that started measuring before the thread the region started on
+  unsigned int generation;    // Initialization the region was started in, or 0 if it is not being measured
+};
+
+// =====================================================================================================================
+// Structure holding one of the slowest invocations of a routine
+// =====================================================================================================================
+struct StopwatchInvocation {
+  size_t routine_id;
+  size_t thread_index;         // Number of threads that started measuring before the thread of the invocation
+  long long start_usec;        // Real microseconds since `stopwatch_init` when the invocation started
+  long long real_usec;
+  long long event_values[STOPWATCH_MAX_EVENTS];
+  size_t caller_routine_id;    // Routine that was open on the thread when the invocation started, or the caller of the
+                               // routine if there was none
+  long long caller_start_usec; // Start of the invocation of the caller the invocation was part of, or -1 if the caller
+                               // was not open on the same thread or its invocation was only counted
+};
+
+// =====================================================================================================================
+// Structure holding a decision of the overhead budget to measure a routine less
+// =====================================================================================================================
+// How much of a routine is measured, from everything down to nothing. Routines only ever move down.
+enum StopwatchThrottling {
+  STOPWATCH_THROTTLE_NONE,        // Measured as configured
+  STOPWATCH_THROTTLE_SAMPLED,     // Only some invocations are measured, see `stopwatch_enable_sampling`
+  STOPWATCH_THROTTLE_COUNT_ONLY,  // Invocations are counted but not measured
+  STOPWATCH_THROTTLE_OFF,         // Invocations are neither counted nor measured
+};
+
+struct StopwatchThrottleDecision {
+  size_t routine_id;
+  size_t thread_index;                  // Thread whose measurements of the routine led to the decision
+  long long time_usec;                  // Real microseconds since `stopwatch_init` when the decision was made
+  enum StopwatchThrottling throttling;  // Level the routine was moved to
+  size_t sampling_interval;             // Invocations per measured invocation if the routine was moved to sampled
+  double mean_real_nsec;                // Mean real nanoseconds of the measured invocations of the routine
+  double overhead;                      // Estimated fraction of the real time of the routine spent measuring it before
+                                        // the decision
+};
+
+// =====================================================================================================================
+// Structure holding the spread of the totals of a routine over the threads that measured it
+// =====================================================================================================================
+struct StopwatchImbalance {
+  size_t routine_id;
+  size_t num_threads;            // Threads that measured the routine at least once
+  long long min_real_usec;
+  double avg_real_usec;
+  long long max_real_usec;
+  long long min_event_values[STOPWATCH_MAX_EVENTS];
+  double avg_event_values[STOPWATCH_MAX_EVENTS];
+  long long max_event_values[STOPWATCH_MAX_EVENTS];
+  double imbalance;              // (max - avg) / max of the real time, which is the fraction of the time of the slowest
+                                 // thread the others spend idle or waiting if they are joined at the end
+  size_t slowest_thread_index;   // Number of threads that started measuring before the thread with the most real time
+};
+
+// =====================================================================================================================
+// Structure describing a measured event
+// =====================================================================================================================
+struct StopwatchEventInfo {
+  int code;
+  char name[STOPWATCH_EVENT_NAME_LEN];
+  char description[STOPWATCH_EVENT_DESCRIPTION_LEN];
+  char units[STOPWATCH_EVENT_UNITS_LEN];           // Empty for events that are plain counts
+  char component[STOPWATCH_EVENT_COMPONENT_LEN];   // PAPI component the event is measured by i.e. perf_event
 };
 
 // =====================================================================================================================
@@ -33,18 +151,46 @@ struct StopwatchMeasurementResult {
 // =====================================================================================================================
 // Initializes the event timers. Currently the events that are measured are hard coded. This will also start the
 // monotonic measurement clock as currently it is assumed that consumers would immediately start the clock after
-// initializing the stopwatch structure.
+// initializing the stopwatch structure. The routine filters `STOPWATCH_ENABLE`, `STOPWATCH_INCLUDE`,
+// `STOPWATCH_EXCLUDE` and `STOPWATCH_MAX_DEPTH`, the series settings `STOPWATCH_SERIES`, `STOPWATCH_SERIES_SIZE` and
+// `STOPWATCH_SERIES_DECIMATION`, the sampling settings `STOPWATCH_SAMPLED`, `STOPWATCH_SAMPLING_INTERVAL` and
+// `STOPWATCH_SAMPLING_RANDOM`, the number of slowest invocations kept `STOPWATCH_SLOWEST` and the overhead budget
+// `STOPWATCH_OVERHEAD_BUDGET` are read from the environment here, as is `STOPWATCH_SHM` which names the shared memory
+// segment the totals are published to (see `stopwatch/stopwatch_shm.h`), and `STOPWATCH_DUMP_FILE` which installs the
+// dump signal handler (see `stopwatch_dump`). The events are counted by the backend named in `STOPWATCH_BACKEND`, one
+// of `papi`, `perf_event` or `timer`, or by the default backend of the build if it is unset. Operating system metrics
+// listed in `STOPWATCH_OS_METRICS`, allocation metrics listed in `STOPWATCH_ALLOC_METRICS` (see
+// `stopwatch/stopwatch_alloc.h`) and I/O metrics listed in `STOPWATCH_IO_METRICS` (see `stopwatch/stopwatch_io.h`) are
+// measured after the events. The work counters are named by `STOPWATCH_WORK_COUNTERS` (see `stopwatch_add_work`).
 enum StopwatchStatus stopwatch_init();
 
 // Stops the monotonic event timers and cleans up resources used by the timer. Interestingly valgrind still reports a
 // memory leak with the PAPI specific resources
 void stopwatch_destroy();
 
+// =====================================================================================================================
+// Measured events
+// =====================================================================================================================
+
+// Number of events measured since `stopwatch_init`. Events are indexed in the order they were listed in
+// `STOPWATCH_EVENTS`, which is also the order of `total_event_values` in the results.
+size_t stopwatch_num_events();
+
+// Copies the description of event `event_idx` into `info`. Everything is looked up once by `stopwatch_init`, so this
+// never calls PAPI. Returns STOPWATCH_ERR if there is no such event.
+enum StopwatchStatus stopwatch_get_event_info(size_t event_idx, struct StopwatchEventInfo *info);
+
+// Name of event `event_idx`, or NULL if there is no such event. Valid until the next `stopwatch_init`.
+const char *stopwatch_event_name(size_t event_idx);
+
 // =====================================================================================================================
 // Operations
 // =====================================================================================================================
 
-// Records the current values on the monotonic event timers
+// Records the current values on the monotonic event timers. Routine IDs may be any value other than 0, which is main,
+// i.e. a 64 bit hash of the routine name, as each ID is given a dense entry the first time it is seen. Returns
+// STOPWATCH_ERR if the ID is new and STOPWATCH_MAX_FUNCTION_CALLS IDs were already seen. A routine started again on the
+// same thread before it ended i.e. by recursion, is counted on every call but measured only by its outermost call.
 enum StopwatchStatus stopwatch_record_start_measurements(size_t routine_id, const char *function_name, size_t caller_routine_id);
 
 // Records the current values on the monotonic event timers. Will also perform a delta between the values recorded from
@@ -52,8 +198,47 @@ enum StopwatchStatus stopwatch_record_start_measurements(size_t routine_id, cons
 // between the calls of `stopwatch_record_start_measurements` and `stopwatch_record_end_measurements`
 enum StopwatchStatus stopwatch_record_end_measurements(size_t routine_id);
 
+// Reserves an unused ID for a routine that is not given one by hand and writes it into `routine_id`. Reserved IDs are
+// handed out counting down from SIZE_MAX so that they do not collide with small hand picked IDs. Does
+// nothing if `routine_id` is already non zero, which lets a zero initialized static variable be registered lazily from
+// any thread. `routine_name` may be NULL, in which case the name is looked up through the name resolver when results
+// are reported. Registered IDs and names outlive `stopwatch_destroy`.
+enum StopwatchStatus stopwatch_register_routine(const char *routine_name, size_t *routine_id);
+
+// Copies up to `max_routine_ids` IDs of the routines seen by the process so far into `routine_ids`, in the order they
+// were first seen, leaving out main. Returns the number of IDs copied.
+size_t stopwatch_get_routine_ids(size_t *routine_ids, size_t max_routine_ids);
+
+// Same as `stopwatch_record_start_measurements` but for a registered routine. The caller is the innermost routine that
+// is currently being measured on the calling thread, or 0 (main) if there is none.
+enum StopwatchStatus stopwatch_record_start_registered(size_t routine_id);
+
+// Returns the ID of the innermost routine that is currently being measured on the calling thread, or 0 (main) if there
+// is none.
+size_t stopwatch_current_routine_id();
+
+// Stops new measurements from starting until `stopwatch_resume` is called i.e. to leave out a warm up phase. Routines
+// that are already being measured are still measured until they end.
+void stopwatch_pause();
+
+// Resumes starting new measurements after `stopwatch_pause`
+void stopwatch_resume();
+
+// Looks up the name of a routine that was registered without one. The returned string must stay valid until the next
+// call to the resolver.
+typedef const char *(*StopwatchNameResolver)(size_t routine_id);
+
+// Sets the resolver used for routines registered without a name. Mainly used by companion libraries i.e.
+// stopwatch_instrument, which only resolves symbol names when results are reported.
+void stopwatch_set_name_resolver(StopwatchNameResolver resolver);
+
+// Fills `result` with the totals of a routine summed over every thread. A routine that was never seen has an empty result.
 enum StopwatchStatus stopwatch_get_measurement_results(size_t routine_id, struct StopwatchMeasurementResult *result);
 
+// Size of `struct StopwatchMeasurementResult`. Lets bindings in other languages check that their copy of the structure
+// has the same layout.
+size_t stopwatch_measurement_result_size();
+
 // Prints out the results
 void stopwatch_print_measurement_results(struct StopwatchMeasurementResult *result);
 
@@ -63,4 +248,173 @@ void stopwatch_print_result_table();
 // Saves results to specified file
 enum StopwatchStatus stopwatch_result_to_csv(const char* file_name);
 
+// =====================================================================================================================
+// Work counters
+// =====================================================================================================================
+
+// Adds `amount` units of work, i.e. items, bytes or grid cells processed, to counter `counter_index` of a routine on the
+// calling thread. Usually called from within the routine, but the work is added whether or not it is being measured.
+// Costs a thread local increment. The counters are named by `STOPWATCH_WORK_COUNTERS`, a comma delimited list of
+// names read by `stopwatch_init`, and are called `WORK<index>` otherwise. Every output reports the counters that are
+// named or were added to, along with the work per second, the nanoseconds per unit of work and the events per unit of
+// work of each routine.
+enum StopwatchStatus stopwatch_add_work(size_t routine_id, size_t counter_index, long long amount);
+
+// Name of a work counter, or NULL if the index is out of range
+const char *stopwatch_work_counter_name(size_t counter_index);
+
+// =====================================================================================================================
+// Dumping from a signal handler
+// =====================================================================================================================
+
+// Writes the totals of every routine on every thread to `fd` as CSV, along with how long the invocations that have not
+// ended yet have been running, which is left empty for invocations that are only counted. Only uses async-signal-safe functions and does not allocate, so it may be called from a
+// signal handler. If `STOPWATCH_DUMP_FILE` is set when `stopwatch_init` is called, a SIGUSR1 handler that dumps to that
+// file is installed until `stopwatch_destroy`.
+enum StopwatchStatus stopwatch_dump(int fd);
+
+// =====================================================================================================================
+// Snapshots
+// =====================================================================================================================
+
+// Copy of the totals of every routine at one point in time. Snapshots are never modified after they are taken.
+struct StopwatchSnapshot;
+
+// Takes a snapshot of the totals of every routine summed over all threads. Measurements continue unaffected, so a
+// program phase can be reported from the difference of the snapshots taken before and after it. Returns NULL if the
+// snapshot cannot be allocated.
+struct StopwatchSnapshot *stopwatch_snapshot();
+
+// Creates a snapshot of what was measured between `before` and `after`. Its smallest and largest event values are
+// unknown, see `event_extremes_known`. Returns NULL if the snapshots were not taken with the same events, i.e., with a
+// `stopwatch_destroy` in between, or the snapshot cannot be allocated.
+struct StopwatchSnapshot *stopwatch_snapshot_diff(const struct StopwatchSnapshot *before,
+                                                  const struct StopwatchSnapshot *after);
+
+void stopwatch_destroy_snapshot(struct StopwatchSnapshot *snapshot);
+
+// Same as `stopwatch_get_measurement_results` but for the totals of a snapshot
+enum StopwatchStatus stopwatch_snapshot_get_results(const struct StopwatchSnapshot *snapshot,
+                                                    size_t routine_id,
+                                                    struct StopwatchMeasurementResult *result);
+
+// Same as `stopwatch_print_result_table` but for the totals of a snapshot
+void stopwatch_print_snapshot_table(const struct StopwatchSnapshot *snapshot);
+
+// Same as `stopwatch_result_to_csv` but for the totals of a snapshot
+enum StopwatchStatus stopwatch_snapshot_to_csv(const struct StopwatchSnapshot *snapshot, const char *file_name);
+
+// Clears the totals and series of every routine without stopping the event timers. Routines that are being measured
+// still end normally and count their whole invocation. Should not be called while other threads are measuring.
+void stopwatch_reset();
+
+// =====================================================================================================================
+// Series of individual invocations
+// =====================================================================================================================
+
+// Keeps the values of individual invocations of a routine on top of its totals. Each thread gets a buffer of
+// `buffer_size` bytes for the routine, allocated the first time the routine ends on the thread, and only every
+// `decimation`th invocation is kept starting with the first. Samples are compressed, usually to a few bytes per value,
+// and are dropped once the buffer is full. Must be called after `stopwatch_init` and before the routine is first
+// measured.
+enum StopwatchStatus stopwatch_enable_series(size_t routine_id, size_t buffer_size, size_t decimation);
+
+// Copies up to `max_samples` samples of a routine measured on the calling thread into `samples`. Returns the number of
+// samples copied.
+size_t stopwatch_get_series(size_t routine_id, struct StopwatchSeriesSample *samples, size_t max_samples);
+
+// Saves the samples of every routine on every thread to the specified file, one row per sample
+enum StopwatchStatus stopwatch_series_to_csv(const char *file_name);
+
+// =====================================================================================================================
+// Asynchronous regions
+// =====================================================================================================================
+
+// Starts measuring an invocation of a routine that may end on another thread, i.e. a task or a coroutine, and stores its
+// start in `region`, which is owned by the caller. Any number of invocations of the same routine can be in flight at
+// once. Asynchronous invocations are not nested and are never the current routine, so the caller is given explicitly.
+enum StopwatchStatus stopwatch_start_async(size_t routine_id,
+                                           const char *function_name,
+                                           size_t caller_routine_id,
+                                           struct StopwatchAsyncRegion *region);
+
+// Ends an invocation started with `stopwatch_start_async` on any thread and adds it to the totals of the ending thread.
+// The real time is exact across threads as the clock is shared. Events are counted per thread, so they are only added
+// if the region ends on the thread it started on, otherwise the invocation is counted in `migrated_times_called`.
+// Regions that were not started, already ended or were started before re-initializing are ignored.
+enum StopwatchStatus stopwatch_end_async(struct StopwatchAsyncRegion *region);
+
+// =====================================================================================================================
+// Sampled routines
+// =====================================================================================================================
+
+// Only measures some invocations of a routine, for routines called so often that measuring every invocation costs more
+// than the routine itself. Every invocation is still counted. Each thread measures every `interval`th invocation
+// starting with the first, or if `STOPWATCH_SAMPLING_RANDOM` is set, invocations a random number of invocations apart
+// with the same average. If `interval` is 0 each thread chooses it after measuring the first invocations, so that
+// measuring adds at most 1% to the real time of the routine. The reported totals are scaled up to every invocation.
+// Must be called after `stopwatch_init` and before the routine is first measured.
+enum StopwatchStatus stopwatch_enable_sampling(size_t routine_id, size_t interval);
+
+// =====================================================================================================================
+// Overhead budget
+// =====================================================================================================================
+
+// When `STOPWATCH_OVERHEAD_BUDGET` is set to a percentage P when `stopwatch_init` is called, every routine whose
+// measuring is estimated to add more than P% to its real time is measured less, one step at a time: first only some of
+// its invocations are measured, then its invocations are only counted and last it is not measured at all. The estimate
+// uses the overhead of a start and end measurement pair that `stopwatch_init` measures and the mean real time of the
+// invocations measured on each thread, and is made again every 64 invocations. `stopwatch_print_result_table` prints
+// every decision below the totals.
+
+// Copies up to `max_decisions` of the decisions made so far into `decisions` in the order they were made. Returns the
+// number of decisions copied.
+size_t stopwatch_get_throttle_decisions(struct StopwatchThrottleDecision *decisions, size_t max_decisions);
+
+// Prints every decision made so far
+void stopwatch_print_throttle_table();
+
+// Saves every decision made so far to the specified file, one row per decision
+enum StopwatchStatus stopwatch_throttle_decisions_to_csv(const char *file_name);
+
+// =====================================================================================================================
+// Slowest invocations
+// =====================================================================================================================
+
+// When `STOPWATCH_SLOWEST` is set to a number K when `stopwatch_init` is called, at most STOPWATCH_MAX_SLOWEST, each
+// thread keeps the K slowest invocations of every routine. An invocation faster than all of them costs one comparison.
+// `stopwatch_print_result_table` then also prints them below the totals.
+
+// Copies up to `max_invocations` of the slowest invocations of a routine over all threads into `invocations`, slowest
+// first. Returns the number of invocations copied.
+size_t stopwatch_get_slowest(size_t routine_id, struct StopwatchInvocation *invocations, size_t max_invocations);
+
+// Prints the slowest invocations of every routine
+void stopwatch_print_slowest_table();
+
+// Saves the slowest invocations of every routine to the specified file, one row per invocation
+enum StopwatchStatus stopwatch_slowest_to_csv(const char *file_name);
+
+// =====================================================================================================================
+// Load imbalance
+// =====================================================================================================================
+
+// The totals of a routine measured on several threads, i.e. the body of a parallel region, are compared between those
+// threads. Threads that never measured the routine are left out. `stopwatch_print_result_table` prints the routines
+// measured on more than one thread below the totals.
+
+// Fills `imbalance` with the spread of the totals of a routine over the threads that measured it. A routine that no
+// thread measured has no threads and zeroes everywhere.
+enum StopwatchStatus stopwatch_get_imbalance(size_t routine_id, struct StopwatchImbalance *imbalance);
+
+// Prints the spread of every routine measured on more than one thread, most imbalanced first
+void stopwatch_print_imbalance_table();
+
+// Saves the spread of every routine measured on more than one thread to the specified file, one row per routine
+enum StopwatchStatus stopwatch_imbalance_to_csv(const char *file_name);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif //STOPWATCH_STOPWATCH_H
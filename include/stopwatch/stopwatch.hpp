@@ -0,0 +1,139 @@
+#ifndef STOPWATCH_STOPWATCH_HPP
+#define STOPWATCH_STOPWATCH_HPP
+
+// Header only C++ interface on top of the C interface. Requires C++11.
+//
+//   void solve() {
+//     STOPWATCH_REGION("solve");  // Measured until the end of the enclosing scope
+//     ...
+//     std::for_each(std::execution::par, cells.begin(), cells.end(), STOPWATCH_TIMED("cell-update", update_cell));
+//   }
+//
+// The name of a region is hashed at compile time and the hash selects the static routine ID of the region, so a region
+// is registered once per distinct name no matter how many translation units or threads measure it. Measuring a region
+// is then a single call at the start and a single call at the end. Nothing here throws or allocates.
+//
+// As with `stopwatch_scope.h`, defining `STOPWATCH_DISABLE` compiles both macros away.
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "stopwatch/stopwatch.h"
+
+namespace stopwatch {
+
+// 64 bit FNV-1a hash of a null terminated string
+constexpr std::uint64_t fnv1a(const char *str, std::uint64_t hash = 14695981039346656037ull) noexcept {
+  return *str == '\0' ? hash : fnv1a(str + 1, (hash ^ static_cast<unsigned char>(*str)) * 1099511628211ull);
+}
+
+// Routine ID shared by every region whose name hashes to `NameHash`. Zero until the first region with the name starts.
+template <std::uint64_t NameHash>
+struct RoutineHandle {
+  static std::size_t id;
+};
+
+template <std::uint64_t NameHash>
+std::size_t RoutineHandle<NameHash>::id = 0;
+
+// Returns the routine ID of the regions named `routine_name`, registering it the first time. Returns 0 if it could not
+// be registered.
+template <std::uint64_t NameHash>
+inline std::size_t routine_id(const char *routine_name) noexcept {
+  std::size_t id = __atomic_load_n(&RoutineHandle<NameHash>::id, __ATOMIC_ACQUIRE);
+  if (__builtin_expect(id == 0, 0)) {
+    stopwatch_register_routine(routine_name, &RoutineHandle<NameHash>::id);
+    id = __atomic_load_n(&RoutineHandle<NameHash>::id, __ATOMIC_ACQUIRE);
+  }
+  return id;
+}
+
+// Measures from construction until destruction. The caller is the innermost region being measured on the constructing
+// thread unless given explicitly.
+template <std::uint64_t NameHash>
+class Region {
+ public:
+  explicit Region(const char *routine_name) noexcept : routine_id_(routine_id<NameHash>(routine_name)) {
+    if (routine_id_ != 0) {
+      stopwatch_record_start_registered(routine_id_);
+    }
+  }
+
+  Region(const char *routine_name, std::size_t caller_routine_id) noexcept
+      : routine_id_(routine_id<NameHash>(routine_name)) {
+    if (routine_id_ != 0) {
+      stopwatch_record_start_measurements(routine_id_, nullptr, caller_routine_id);
+    }
+  }
+
+  ~Region() noexcept {
+    if (routine_id_ != 0) {
+      stopwatch_record_end_measurements(routine_id_);
+    }
+  }
+
+  Region(const Region &) = delete;
+  Region &operator=(const Region &) = delete;
+
+ private:
+  std::size_t routine_id_;
+};
+
+// Function object that measures every call of `Function` as a region. Calls may happen concurrently on any thread i.e.
+// as the body of a parallel algorithm. They are nested under the region that was being measured when the `Timed` was
+// created, as the threads running the calls usually have no region of their own open. A call made from within another
+// call on the same thread i.e. a nested task picked up by a worker, is counted but only the outermost call is measured,
+// the same as a recursive `Region`.
+template <std::uint64_t NameHash, class Function>
+class Timed {
+ public:
+  Timed(const char *routine_name, Function function)
+      : routine_name_(routine_name), caller_routine_id_(stopwatch_current_routine_id()), function_(std::move(function)) {}
+
+  template <class... Args>
+  auto operator()(Args &&... args) -> decltype(std::declval<Function &>()(std::forward<Args>(args)...)) {
+    Region<NameHash> region(routine_name_, caller_routine_id_);
+    return function_(std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  auto operator()(Args &&... args) const -> decltype(std::declval<const Function &>()(std::forward<Args>(args)...)) {
+    Region<NameHash> region(routine_name_, caller_routine_id_);
+    return function_(std::forward<Args>(args)...);
+  }
+
+ private:
+  const char *routine_name_;
+  std::size_t caller_routine_id_;
+  Function function_;
+};
+
+template <std::uint64_t NameHash, class Function>
+inline Timed<NameHash, Function> timed(const char *routine_name, Function function) {
+  return Timed<NameHash, Function>(routine_name, std::move(function));
+}
+
+} // namespace stopwatch
+
+#ifdef STOPWATCH_DISABLE
+
+#define STOPWATCH_REGION(routine_name) ((void) 0)
+#define STOPWATCH_TIMED(routine_name, function) (function)
+
+#else
+
+#define STOPWATCH_CPP_CONCAT_IMPL(lhs, rhs) lhs##rhs
+#define STOPWATCH_CPP_CONCAT(lhs, rhs) STOPWATCH_CPP_CONCAT_IMPL(lhs, rhs)
+
+// Measures from this statement until the end of the enclosing scope. `routine_name` must be a string literal.
+#define STOPWATCH_REGION(routine_name)                                                                                 \
+  const ::stopwatch::Region<::stopwatch::fnv1a(routine_name)> STOPWATCH_CPP_CONCAT(stopwatch_region_, __COUNTER__)(     \
+      routine_name)
+
+// Wraps `function` so that each call is measured. `routine_name` must be a string literal.
+#define STOPWATCH_TIMED(routine_name, function) ::stopwatch::timed<::stopwatch::fnv1a(routine_name)>(routine_name, function)
+
+#endif // STOPWATCH_DISABLE
+
+#endif //STOPWATCH_STOPWATCH_HPP
@@ -0,0 +1,34 @@
+#ifndef STOPWATCH_STOPWATCH_ALLOC_H
+#define STOPWATCH_STOPWATCH_ALLOC_H
+
+// Interface of the optional allocation accounting libraries, which wrap `malloc`, `calloc`, `realloc`, `free`,
+// `posix_memalign` and `aligned_alloc` and count the allocations of each thread:
+//   stopwatch_alloc          Static library that wraps the calls made by the program through `-Wl,--wrap`. Linking it
+//                            adds the wrap options.
+//   stopwatch_alloc_preload  Shared library that replaces the allocator of every library of the program when loaded
+//                            through `LD_PRELOAD`.
+//
+// The stopwatch finds the counters through `stopwatch_alloc_counters` when `STOPWATCH_ALLOC_METRICS` is set and
+// measures how they change over each region, the same as the events.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Allocations of a single thread since it started. Only ever written by the owning thread.
+struct StopwatchAllocCounters {
+  long long allocations;       // Number of successful allocations, including reallocations
+  long long allocated_bytes;   // Bytes requested by those allocations
+  long long live_bytes;        // Usable bytes of the allocations that have not been freed yet. Memory allocated on one
+                               // thread and freed on another moves live bytes between the threads
+  long long peak_live_bytes;   // Largest `live_bytes` since the stopwatch last lowered it
+};
+
+// Counters of the calling thread. Never NULL.
+struct StopwatchAllocCounters *stopwatch_alloc_counters();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //STOPWATCH_STOPWATCH_ALLOC_H
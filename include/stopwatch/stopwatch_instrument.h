@@ -0,0 +1,27 @@
+#ifndef STOPWATCH_STOPWATCH_INSTRUMENT_H
+#define STOPWATCH_STOPWATCH_INSTRUMENT_H
+
+// Interface of the optional stopwatch_instrument library. Linking it to a program compiled with
+// `-finstrument-functions` measures every instrumented function without any calls to the stopwatch API other than
+// `stopwatch_init`, the result output functions and `stopwatch_destroy`.
+//
+// Each instrumented function is registered through `stopwatch_register_routine` the first time it is called, so it is
+// given an ID from the top of the ID space. The caller of a function is the innermost measured function on the calling
+// thread. Function names are only looked up when results are reported.
+//
+// Configuration through environment variables, read the first time an instrumented function is called:
+//   STOPWATCH_INSTRUMENT_INCLUDE    Comma delimited globs of function names to measure. Measures all if unset
+//   STOPWATCH_INSTRUMENT_EXCLUDE    Comma delimited globs of function names to never measure
+//   STOPWATCH_INSTRUMENT_MAX_DEPTH  Functions nested deeper than this are not measured. Defaults to
+//                                   STOPWATCH_INSTRUMENT_MAX_DEPTH
+
+#include <stddef.h>
+
+#define STOPWATCH_INSTRUMENT_MAX_FUNCTIONS 256  // Maximum number of distinct functions that are measured
+#define STOPWATCH_INSTRUMENT_MAX_DEPTH 64       // Maximum call depth that is measured
+
+// Looks up the name of the instrumented function measured with `routine_id`. Returns NULL if `routine_id` does not
+// belong to an instrumented function. This is the name resolver that the library installs in the stopwatch.
+const char *stopwatch_instrument_routine_name(size_t routine_id);
+
+#endif //STOPWATCH_STOPWATCH_INSTRUMENT_H
@@ -0,0 +1,35 @@
+#ifndef STOPWATCH_STOPWATCH_IO_H
+#define STOPWATCH_STOPWATCH_IO_H
+
+// Interface of the optional I/O accounting libraries, which wrap `read`, `write`, `pread` and `pwrite` and count the
+// calls, bytes and time blocked of each thread:
+//   stopwatch_io          Static library that wraps the calls made by the program through `-Wl,--wrap`. Linking it adds
+//                         the wrap options.
+//   stopwatch_io_preload  Shared library that replaces the functions for every library of the program when loaded
+//                         through `LD_PRELOAD`.
+// Neither sees the calls that the C library makes internally, i.e., when `fwrite` flushes its buffer.
+//
+// The stopwatch finds the counters through `stopwatch_io_counters` when `STOPWATCH_IO_METRICS` is set and measures how
+// they change over each region, the same as the events.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// I/O of a single thread since it started. Only ever written by the owning thread.
+struct StopwatchIoCounters {
+  long long read_calls;      // Calls of `read` and `pread`, including failed ones
+  long long write_calls;     // Calls of `write` and `pwrite`, including failed ones
+  long long bytes_read;
+  long long bytes_written;
+  long long blocked_nsec;    // Time spent inside the calls
+};
+
+// Counters of the calling thread. Never NULL.
+struct StopwatchIoCounters *stopwatch_io_counters();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //STOPWATCH_STOPWATCH_IO_H
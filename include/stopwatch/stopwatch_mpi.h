@@ -0,0 +1,49 @@
+#ifndef STOPWATCH_STOPWATCH_MPI_H
+#define STOPWATCH_STOPWATCH_MPI_H
+
+// Interface of the optional stopwatch_mpi library, which measures the MPI calls of a program through the PMPI profiling
+// interface and combines the totals of every rank when the program calls `MPI_Finalize`. Linking the library replaces
+// the measured MPI functions, so the program itself is left unchanged apart from the usual `stopwatch_init` and
+// `stopwatch_destroy`, which must be called after `MPI_Init` and after `MPI_Finalize` respectively.
+//
+// Each MPI function is registered through `stopwatch_register_routine` once for every routine it is called in, so the
+// calls appear in the call tree under the stopwatch region that encloses them, named after the function, i.e.
+// `MPI_Allreduce`. The functions measured are the point to point `MPI_Send`, `MPI_Recv`, `MPI_Isend`, `MPI_Irecv`,
+// `MPI_Sendrecv`, `MPI_Wait` and `MPI_Waitall`, and the collective `MPI_Barrier`, `MPI_Bcast`, `MPI_Reduce`,
+// `MPI_Allreduce`, `MPI_Gather`, `MPI_Scatter`, `MPI_Allgather` and `MPI_Alltoall`. The bytes of each call are the
+// bytes this rank sends, or receives for `MPI_Recv`, `MPI_Irecv` and `MPI_Scatter`, computed from the counts and
+// datatypes of the call. Non-blocking calls count their bytes when they are posted.
+//
+// `MPI_Finalize` reduces the totals of every routine over the ranks into a single CSV file written by rank 0, named by
+// `STOPWATCH_MPI_SUMMARY` or `STOPWATCH_MPI_DEFAULT_SUMMARY` if unset. Setting it to an empty value skips the
+// reduction.
+
+#include <mpi.h>
+
+#include "stopwatch/stopwatch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STOPWATCH_MPI_MAX_REGIONS 256  // Maximum number of distinct MPI function and enclosing routine pairs measured
+#define STOPWATCH_MPI_PATH_LEN 256     // Maximum length of the call path identifying a routine across ranks
+#define STOPWATCH_MPI_DEFAULT_SUMMARY "stopwatch_mpi_summary.csv"
+
+// Prints the calls, real time and bytes of every MPI function measured on this rank, summed over the routines it was
+// called in. `stopwatch_print_result_table` prints it below the totals.
+void stopwatch_mpi_print_summary();
+
+// Reduces the totals of every routine over the ranks of `comm` and saves them to the specified file on rank 0, one row
+// per routine. Routines are matched between ranks by their call path, the names of the routines enclosing them joined
+// by `/`, so they need not have the same IDs on every rank. Each row holds the number of ranks that measured the
+// routine, its calls and bytes summed over those ranks, the minimum, average and maximum over those ranks of the real
+// time and of every event, the imbalance (max - avg) / max of the real time and the rank with the most real time.
+// Collective over `comm`. Every rank returns the status of rank 0.
+enum StopwatchStatus stopwatch_mpi_summary_to_csv(const char *file_name, MPI_Comm comm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //STOPWATCH_STOPWATCH_MPI_H
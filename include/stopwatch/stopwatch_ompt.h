@@ -0,0 +1,27 @@
+#ifndef STOPWATCH_STOPWATCH_OMPT_H
+#define STOPWATCH_STOPWATCH_OMPT_H
+
+// Interface of the optional stopwatch_ompt library, an OpenMP tool that measures the OpenMP constructs of a program
+// without any calls to the stopwatch API other than `stopwatch_init`, the result output functions and
+// `stopwatch_destroy`. The OpenMP runtime must support the OMPT interface, i.e. LLVM libomp. Linking the library
+// defines `ompt_start_tool`, which the runtime calls when it starts. Setting `OMP_TOOL=disabled` turns it off.
+//
+// Each kind of construct is registered through `stopwatch_register_routine` once for every routine it is nested in, so
+// the constructs appear in the call tree under the stopwatch region that encloses them:
+//   omp parallel   Parallel region, on the thread that encountered it
+//   omp thread     Implicit task of each thread of a parallel region, nested under the parallel region
+//   omp loop       Worksharing loop
+//   omp workshare  Other worksharing constructs, i.e. sections and single
+//   omp barrier    Waiting at explicit and implicit barriers
+//   omp taskwait   Waiting at taskwait and taskgroup constructs
+//   omp lock wait  Waiting to acquire locks and critical sections
+//
+// Measuring starts when the runtime starts, so regions that run before `stopwatch_init` are not measured.
+
+#define STOPWATCH_OMPT_MAX_REGIONS 256  // Maximum number of distinct constructs and enclosing routine pairs measured
+
+// Prints, for every parallel region, the real time its threads spent working and waiting at barriers, taskwaits and
+// locks, summed over the threads. `stopwatch_print_result_table` prints it below the totals.
+void stopwatch_ompt_print_summary();
+
+#endif //STOPWATCH_STOPWATCH_OMPT_H
@@ -0,0 +1,69 @@
+#ifndef STOPWATCH_STOPWATCH_SCOPE_H
+#define STOPWATCH_STOPWATCH_SCOPE_H
+
+// Scoped measurement macros for C. A region is measured from the `STOPWATCH_SCOPE` statement until the end of the
+// enclosing scope, including early returns and breaks:
+//
+//   void solve() {
+//     STOPWATCH_SCOPE("solve");
+//     ...
+//   }
+//
+// Each `STOPWATCH_SCOPE` has its own static routine ID that is registered the first time the scope is entered, so the
+// measurement itself is a single call at the start and a single call at the end of the scope. The caller is the
+// innermost region that is being measured on the calling thread. Requires the `cleanup` attribute of GCC or Clang.
+//
+// Defining `STOPWATCH_DISABLE` before including this header compiles every macro to nothing, so instrumented code does
+// not reference the stopwatch library at all.
+
+#include "stopwatch/stopwatch.h"
+
+#ifdef STOPWATCH_DISABLE
+
+#define STOPWATCH_SCOPE(routine_name) ((void) 0)
+#define STOPWATCH_INIT() (STOPWATCH_OK)
+#define STOPWATCH_DESTROY() ((void) 0)
+#define STOPWATCH_PRINT_RESULT_TABLE() ((void) 0)
+#define STOPWATCH_RESULT_TO_CSV(file_name) (STOPWATCH_OK)
+
+#else
+
+#define STOPWATCH_CONCAT_IMPL(lhs, rhs) lhs##rhs
+#define STOPWATCH_CONCAT(lhs, rhs) STOPWATCH_CONCAT_IMPL(lhs, rhs)
+
+// __COUNTER__ gives every scope in a translation unit its own variable names, even on the same line of a macro
+#define STOPWATCH_SCOPE(routine_name) STOPWATCH_SCOPE_IMPL(routine_name, __COUNTER__)
+#define STOPWATCH_SCOPE_IMPL(routine_name, counter)                                                                    \
+  static size_t STOPWATCH_CONCAT(stopwatch_scope_id_, counter) = 0;                                                    \
+  __attribute__((cleanup(stopwatch_scope_end), unused)) const size_t STOPWATCH_CONCAT(stopwatch_scope_, counter) =     \
+      stopwatch_scope_begin(&STOPWATCH_CONCAT(stopwatch_scope_id_, counter), routine_name)
+
+#define STOPWATCH_INIT() stopwatch_init()
+#define STOPWATCH_DESTROY() stopwatch_destroy()
+#define STOPWATCH_PRINT_RESULT_TABLE() stopwatch_print_result_table()
+#define STOPWATCH_RESULT_TO_CSV(file_name) stopwatch_result_to_csv(file_name)
+
+// Registers the scope the first time it is entered and starts its measurement. Returns the routine ID of the scope, or
+// 0 if it could not be registered in which case the scope is not measured.
+static inline size_t stopwatch_scope_begin(size_t *routine_id, const char *routine_name) {
+  size_t id = __atomic_load_n(routine_id, __ATOMIC_ACQUIRE);
+  if (__builtin_expect(id == 0, 0)) {
+    stopwatch_register_routine(routine_name, routine_id);
+    id = __atomic_load_n(routine_id, __ATOMIC_ACQUIRE);
+  }
+  if (id != 0) {
+    stopwatch_record_start_registered(id);
+  }
+  return id;
+}
+
+// Ends the measurement of a scope. Called automatically when the scope is left.
+static inline void stopwatch_scope_end(const size_t *routine_id) {
+  if (*routine_id != 0) {
+    stopwatch_record_end_measurements(*routine_id);
+  }
+}
+
+#endif // STOPWATCH_DISABLE
+
+#endif //STOPWATCH_STOPWATCH_SCOPE_H
@@ -0,0 +1,99 @@
+#ifndef STOPWATCH_STOPWATCH_SHM_H
+#define STOPWATCH_STOPWATCH_SHM_H
+
+// Layout of the POSIX shared memory segment that the stopwatch publishes its totals to when the `STOPWATCH_SHM`
+// environment variable holds a segment name i.e. `/stopwatch-solver`. The segment is created by `stopwatch_init` and
+// unlinked by `stopwatch_destroy`. Other processes, such as `stopwatch-top`, may map it read only at any time.
+//
+// Each measuring thread owns one `StopwatchShmThread` and is its only writer. After every end measurement the thread
+// makes the sequence odd, updates the totals of the routine and makes the sequence even again, so the instrumented
+// process never waits for readers. Readers copy the totals and retry if the sequence was odd or changed meanwhile, which
+// `stopwatch_shm_read_thread` does.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STOPWATCH_SHM_MAGIC 0x57505453u    // "STPW"
+#define STOPWATCH_SHM_VERSION 2u
+#define STOPWATCH_SHM_MAX_THREADS 64       // Threads that start measuring after this many are not published
+#define STOPWATCH_SHM_EVENT_NAME_LEN 64
+
+// Routines are stored at the entry the stopwatch gave them, in the order they were first measured, and their IDs are
+// kept in `routine_ids`.
+
+// Totals of a single routine on a single thread
+struct StopwatchShmRoutine {
+  long long total_times_called;
+  long long total_real_usec;
+  long long total_event_values[STOPWATCH_MAX_EVENTS];
+};
+
+struct StopwatchShmThread {
+  // Odd while the owning thread is updating `routines`. Only accessed through atomic builtins.
+  uint64_t sequence;
+  struct StopwatchShmRoutine routines[STOPWATCH_MAX_FUNCTION_CALLS];
+};
+
+struct StopwatchShmSegment {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t size;        // Size of the whole segment in bytes
+  int64_t pid;          // Process that created the segment
+  uint64_t num_events;
+  char event_names[STOPWATCH_MAX_EVENTS][STOPWATCH_SHM_EVENT_NAME_LEN];
+  // Routine IDs, names and callers are written under a single sequence as any thread may record a routine
+  uint64_t routines_sequence;
+  uint64_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  char routine_names[STOPWATCH_MAX_FUNCTION_CALLS][NULL_TERM_MAX_ROUTINE_NAME_LEN];
+  uint64_t caller_routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  // Number of entries of `threads` in use. Only accessed through atomic builtins.
+  uint64_t num_threads;
+  struct StopwatchShmThread threads[STOPWATCH_SHM_MAX_THREADS];
+};
+
+// Copies the totals of `thread` into `routines`, which must hold STOPWATCH_MAX_FUNCTION_CALLS entries, retrying until
+// the copy was not torn by the owning thread. Returns the number of attempts.
+static inline unsigned int stopwatch_shm_read_thread(const struct StopwatchShmThread *thread,
+                                                     struct StopwatchShmRoutine *routines) {
+  unsigned int attempts = 0;
+  uint64_t before;
+  uint64_t after;
+  do {
+    attempts++;
+    before = __atomic_load_n(&thread->sequence, __ATOMIC_ACQUIRE);
+    memcpy(routines, thread->routines, sizeof(thread->routines));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&thread->sequence, __ATOMIC_RELAXED);
+  } while ((before & 1) || before != after);
+  return attempts;
+}
+
+// Same as `stopwatch_shm_read_thread` for the routine IDs, names and callers of `segment`
+static inline void stopwatch_shm_read_routines(const struct StopwatchShmSegment *segment,
+                                               uint64_t *routine_ids,
+                                               char (*routine_names)[NULL_TERM_MAX_ROUTINE_NAME_LEN],
+                                               uint64_t *caller_routine_ids) {
+  uint64_t before;
+  uint64_t after;
+  do {
+    before = __atomic_load_n(&segment->routines_sequence, __ATOMIC_ACQUIRE);
+    memcpy(routine_ids, segment->routine_ids, sizeof(segment->routine_ids));
+    memcpy(routine_names, segment->routine_names, sizeof(segment->routine_names));
+    memcpy(caller_routine_ids, segment->caller_routine_ids, sizeof(segment->caller_routine_ids));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&segment->routines_sequence, __ATOMIC_RELAXED);
+  } while ((before & 1) || before != after);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //STOPWATCH_STOPWATCH_SHM_H
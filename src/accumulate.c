@@ -0,0 +1,273 @@
+#include "accumulate.h"
+
+#include <limits.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define ACCUMULATE_HAVE_X86 1
+#endif
+
+// The kernel tables below list one kernel for each number of events
+_Static_assert(STOPWATCH_MAX_EVENTS == 10, "accumulation kernels must be defined for every number of events");
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static bool isa_supported(enum AccumulateIsa isa);
+
+// =====================================================================================================================
+// Kernels
+// =====================================================================================================================
+
+// Nothing is measured but the real time
+static void accumulate_none(long long *values, const long long *start_values, struct EventTotals *totals) {
+  (void) values;
+  (void) start_values;
+  (void) totals;
+}
+
+static inline __attribute__((always_inline)) void accumulate_scalar(long long *values,
+                                                                    const long long *start_values,
+                                                                    struct EventTotals *totals,
+                                                                    size_t num_events) {
+  for (size_t idx = 0; idx < num_events; idx++) {
+    // Counters wrap around, which signed arithmetic leaves undefined
+    const long long value = (long long) ((unsigned long long) values[idx] - (unsigned long long) start_values[idx]);
+    values[idx] = value;
+    EVENT_TOTAL(totals, sums, idx) =
+        (long long) ((unsigned long long) EVENT_TOTAL(totals, sums, idx) + (unsigned long long) value);
+    EVENT_TOTAL(totals, mins, idx) = value < EVENT_TOTAL(totals, mins, idx) ? value : EVENT_TOTAL(totals, mins, idx);
+    EVENT_TOTAL(totals, maxs, idx) = value > EVENT_TOTAL(totals, maxs, idx) ? value : EVENT_TOTAL(totals, maxs, idx);
+    EVENT_TOTAL(totals, sums_of_squares, idx) += (double) value * (double) value;
+  }
+}
+
+#ifdef ACCUMULATE_HAVE_X86
+// AVX2 has no conversion of 64-bit integers to doubles. The upper 48 and lower 16 bits go into the mantissas of two
+// doubles whose sum is rounded once, as the conversion of a single integer is.
+static inline __attribute__((always_inline, target("avx2"))) __m256d int64_to_double_avx2(__m256i value) {
+  __m256i high = _mm256_srai_epi32(value, 16);
+  high = _mm256_blend_epi16(high, _mm256_setzero_si256(), 0x33);
+  high = _mm256_add_epi64(high, _mm256_castpd_si256(_mm256_set1_pd(442721857769029238784.0)));  // 3 * 2^67
+  const __m256i low = _mm256_blend_epi16(value, _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0)), 0x88);  // 2^52
+  const __m256d high_double = _mm256_sub_pd(_mm256_castsi256_pd(high), _mm256_set1_pd(442726361368656609280.0));
+  return _mm256_add_pd(high_double, _mm256_castsi256_pd(low));
+}
+
+// Adds the values of four events to their totals
+static inline __attribute__((always_inline, target("avx2"))) void add_values_avx2(
+    __m256i value, __m256i *sum, __m256i *min, __m256i *max, __m256d *sum_of_squares) {
+  *sum = _mm256_add_epi64(*sum, value);
+  *min = _mm256_blendv_epi8(*min, value, _mm256_cmpgt_epi64(*min, value));
+  *max = _mm256_blendv_epi8(*max, value, _mm256_cmpgt_epi64(value, *max));
+  const __m256d value_double = int64_to_double_avx2(value);
+  *sum_of_squares = _mm256_add_pd(*sum_of_squares, _mm256_mul_pd(value_double, value_double));
+}
+
+// One block of four events at a time, the events past the last whole block through masked loads and stores
+static inline __attribute__((always_inline, target("avx2"))) void accumulate_avx2(long long *values,
+                                                                                  const long long *start_values,
+                                                                                  struct EventTotals *totals,
+                                                                                  size_t num_events) {
+  size_t idx = 0;
+  for (; idx + 4 <= num_events; idx += 4) {
+    struct EventTotalsBlock *block = &totals->blocks[idx / ACCUMULATE_BLOCK_EVENTS];
+    const __m256i start = _mm256_loadu_si256((const __m256i *) (start_values + idx));
+    const __m256i value = _mm256_sub_epi64(_mm256_loadu_si256((const __m256i *) (values + idx)), start);
+    __m256i sum = _mm256_loadu_si256((const __m256i *) block->sums);
+    __m256i min = _mm256_loadu_si256((const __m256i *) block->mins);
+    __m256i max = _mm256_loadu_si256((const __m256i *) block->maxs);
+    __m256d sum_of_squares = _mm256_loadu_pd(block->sums_of_squares);
+    add_values_avx2(value, &sum, &min, &max, &sum_of_squares);
+    _mm256_storeu_si256((__m256i *) (values + idx), value);
+    _mm256_storeu_si256((__m256i *) block->sums, sum);
+    _mm256_storeu_si256((__m256i *) block->mins, min);
+    _mm256_storeu_si256((__m256i *) block->maxs, max);
+    _mm256_storeu_pd(block->sums_of_squares, sum_of_squares);
+  }
+  if (idx < num_events) {
+    struct EventTotalsBlock *block = &totals->blocks[idx / ACCUMULATE_BLOCK_EVENTS];
+    const __m256i mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x((long long) (num_events - idx)),
+                                            _mm256_setr_epi64x(0, 1, 2, 3));
+    const __m256i start = _mm256_maskload_epi64(start_values + idx, mask);
+    const __m256i value = _mm256_sub_epi64(_mm256_maskload_epi64(values + idx, mask), start);
+    __m256i sum = _mm256_maskload_epi64(block->sums, mask);
+    __m256i min = _mm256_maskload_epi64(block->mins, mask);
+    __m256i max = _mm256_maskload_epi64(block->maxs, mask);
+    __m256d sum_of_squares = _mm256_maskload_pd(block->sums_of_squares, mask);
+    add_values_avx2(value, &sum, &min, &max, &sum_of_squares);
+    _mm256_maskstore_epi64(values + idx, mask, value);
+    _mm256_maskstore_epi64(block->sums, mask, sum);
+    _mm256_maskstore_epi64(block->mins, mask, min);
+    _mm256_maskstore_epi64(block->maxs, mask, max);
+    _mm256_maskstore_pd(block->sums_of_squares, mask, sum_of_squares);
+  }
+}
+
+// Four events at a time like AVX2, but with the events past the last one masked off through a mask register and with
+// the minimums, maximums and conversions to doubles in single instructions. 256-bit vectors are faster than 512-bit ones
+// for at most 10 events, where the latter mostly hold masked off lanes.
+static inline __attribute__((always_inline, target("avx512f,avx512vl,avx512dq"))) void accumulate_avx512(
+    long long *values, const long long *start_values, struct EventTotals *totals, size_t num_events) {
+  for (size_t idx = 0; idx < num_events; idx += 4) {
+    struct EventTotalsBlock *block = &totals->blocks[idx / ACCUMULATE_BLOCK_EVENTS];
+    const __mmask8 mask = num_events - idx >= 4 ? 0xF : (__mmask8) ((1u << (num_events - idx)) - 1);
+    const __m256i start = _mm256_maskz_loadu_epi64(mask, start_values + idx);
+    const __m256i value = _mm256_sub_epi64(_mm256_maskz_loadu_epi64(mask, values + idx), start);
+    const __m256i sum = _mm256_maskz_loadu_epi64(mask, block->sums);
+    const __m256i min = _mm256_maskz_loadu_epi64(mask, block->mins);
+    const __m256i max = _mm256_maskz_loadu_epi64(mask, block->maxs);
+    const __m256d sum_of_squares = _mm256_maskz_loadu_pd(mask, block->sums_of_squares);
+    const __m256d value_double = _mm256_cvtepi64_pd(value);
+    _mm256_mask_storeu_epi64(values + idx, mask, value);
+    _mm256_mask_storeu_epi64(block->sums, mask, _mm256_add_epi64(sum, value));
+    _mm256_mask_storeu_epi64(block->mins, mask, _mm256_min_epi64(min, value));
+    _mm256_mask_storeu_epi64(block->maxs, mask, _mm256_max_epi64(max, value));
+    _mm256_mask_storeu_pd(block->sums_of_squares,
+                          mask,
+                          _mm256_add_pd(sum_of_squares, _mm256_mul_pd(value_double, value_double)));
+  }
+}
+#endif
+
+// Kernels of every instruction set for `num_events` events, which is a constant the loops above are unrolled for
+#define DEFINE_SCALAR_KERNEL(num_events)                                                                               \
+  static void accumulate_scalar_##num_events(long long *values,                                                       \
+                                             const long long *start_values,                                            \
+                                             struct EventTotals *totals) {                                             \
+    accumulate_scalar(values, start_values, totals, num_events);                                                       \
+  }
+
+#ifdef ACCUMULATE_HAVE_X86
+#define DEFINE_KERNELS(num_events)                                                                                     \
+  DEFINE_SCALAR_KERNEL(num_events)                                                                                     \
+  __attribute__((target("avx2"))) static void accumulate_avx2_##num_events(long long *values,                          \
+                                                                           const long long *start_values,              \
+                                                                           struct EventTotals *totals) {               \
+    accumulate_avx2(values, start_values, totals, num_events);                                                         \
+  }                                                                                                                    \
+  __attribute__((target("avx512f,avx512vl,avx512dq"))) static void accumulate_avx512_##num_events(                   \
+      long long *values, const long long *start_values, struct EventTotals *totals) {                                  \
+    accumulate_avx512(values, start_values, totals, num_events);                                                       \
+  }
+#else
+#define DEFINE_KERNELS(num_events) DEFINE_SCALAR_KERNEL(num_events)
+#endif
+
+DEFINE_KERNELS(1)
+DEFINE_KERNELS(2)
+DEFINE_KERNELS(3)
+DEFINE_KERNELS(4)
+DEFINE_KERNELS(5)
+DEFINE_KERNELS(6)
+DEFINE_KERNELS(7)
+DEFINE_KERNELS(8)
+DEFINE_KERNELS(9)
+DEFINE_KERNELS(10)
+
+// Indexed by the number of events
+static const AccumulateKernel scalar_kernels[STOPWATCH_MAX_EVENTS + 1] = {
+    accumulate_none, accumulate_scalar_1, accumulate_scalar_2, accumulate_scalar_3, accumulate_scalar_4,
+    accumulate_scalar_5, accumulate_scalar_6, accumulate_scalar_7, accumulate_scalar_8, accumulate_scalar_9,
+    accumulate_scalar_10,
+};
+
+#ifdef ACCUMULATE_HAVE_X86
+static const AccumulateKernel avx2_kernels[STOPWATCH_MAX_EVENTS + 1] = {
+    accumulate_none, accumulate_avx2_1, accumulate_avx2_2, accumulate_avx2_3, accumulate_avx2_4,
+    accumulate_avx2_5, accumulate_avx2_6, accumulate_avx2_7, accumulate_avx2_8, accumulate_avx2_9,
+    accumulate_avx2_10,
+};
+
+static const AccumulateKernel avx512_kernels[STOPWATCH_MAX_EVENTS + 1] = {
+    accumulate_none, accumulate_avx512_1, accumulate_avx512_2, accumulate_avx512_3, accumulate_avx512_4,
+    accumulate_avx512_5, accumulate_avx512_6, accumulate_avx512_7, accumulate_avx512_8, accumulate_avx512_9,
+    accumulate_avx512_10,
+};
+#endif
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+AccumulateKernel find_accumulate_kernel(enum AccumulateIsa isa, size_t num_events) {
+  if (num_events > STOPWATCH_MAX_EVENTS || !isa_supported(isa)) {
+    return NULL;
+  }
+  switch (isa) {
+    case ACCUMULATE_SCALAR:
+      return scalar_kernels[num_events];
+#ifdef ACCUMULATE_HAVE_X86
+    case ACCUMULATE_AVX2:
+      return avx2_kernels[num_events];
+    case ACCUMULATE_AVX512:
+      return avx512_kernels[num_events];
+#endif
+    default:
+      return NULL;
+  }
+}
+
+AccumulateKernel select_accumulate_kernel(size_t num_events) {
+  // A single event is a scalar subtract, add, minimum, maximum and square either way. AVX2 needs several instructions for
+  // the minimums, maximums and conversions to doubles, which only pay off from three events.
+  if (num_events > 1 && isa_supported(ACCUMULATE_AVX512)) {
+    return find_accumulate_kernel(ACCUMULATE_AVX512, num_events);
+  }
+  if (num_events > 2 && isa_supported(ACCUMULATE_AVX2)) {
+    return find_accumulate_kernel(ACCUMULATE_AVX2, num_events);
+  }
+  return find_accumulate_kernel(ACCUMULATE_SCALAR, num_events);
+}
+
+void clear_event_totals(struct EventTotals *totals) {
+  for (size_t idx = 0; idx < ACCUMULATE_NUM_BLOCKS * ACCUMULATE_BLOCK_EVENTS; idx++) {
+    EVENT_TOTAL(totals, sums, idx) = 0;
+    EVENT_TOTAL(totals, mins, idx) = LLONG_MAX;
+    EVENT_TOTAL(totals, maxs, idx) = LLONG_MIN;
+    EVENT_TOTAL(totals, sums_of_squares, idx) = 0;
+  }
+}
+
+void merge_event_totals(struct EventTotals *totals, const struct EventTotals *other, size_t num_events) {
+  for (size_t idx = 0; idx < num_events; idx++) {
+    EVENT_TOTAL(totals, sums, idx) = (long long) ((unsigned long long) EVENT_TOTAL(totals, sums, idx) +
+                                                  (unsigned long long) EVENT_TOTAL(other, sums, idx));
+    if (EVENT_TOTAL(other, mins, idx) < EVENT_TOTAL(totals, mins, idx)) {
+      EVENT_TOTAL(totals, mins, idx) = EVENT_TOTAL(other, mins, idx);
+    }
+    if (EVENT_TOTAL(other, maxs, idx) > EVENT_TOTAL(totals, maxs, idx)) {
+      EVENT_TOTAL(totals, maxs, idx) = EVENT_TOTAL(other, maxs, idx);
+    }
+    EVENT_TOTAL(totals, sums_of_squares, idx) += EVENT_TOTAL(other, sums_of_squares, idx);
+  }
+}
+
+void subtract_event_totals(struct EventTotals *totals, const struct EventTotals *before, size_t num_events) {
+  for (size_t idx = 0; idx < num_events; idx++) {
+    EVENT_TOTAL(totals, sums, idx) = (long long) ((unsigned long long) EVENT_TOTAL(totals, sums, idx) -
+                                                  (unsigned long long) EVENT_TOTAL(before, sums, idx));
+    EVENT_TOTAL(totals, sums_of_squares, idx) -= EVENT_TOTAL(before, sums_of_squares, idx);
+  }
+}
+
+// =====================================================================================================================
+// Private helper functions implementations
+// =====================================================================================================================
+static bool isa_supported(enum AccumulateIsa isa) {
+  switch (isa) {
+    case ACCUMULATE_SCALAR:
+      return true;
+#ifdef ACCUMULATE_HAVE_X86
+    case ACCUMULATE_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+    case ACCUMULATE_AVX512:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+             __builtin_cpu_supports("avx512dq");
+#endif
+    default:
+      return false;
+  }
+}
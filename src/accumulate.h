@@ -0,0 +1,66 @@
+#ifndef LIBSTOPWATCH_SRC_ACCUMULATE_H_
+#define LIBSTOPWATCH_SRC_ACCUMULATE_H_
+
+#include <stddef.h>
+
+#include "stopwatch/stopwatch.h"
+
+// Every end measurement turns the events read at the end into the values of the invocation and adds them to the
+// totals. Kernels doing so are specialized for each number of events, so their loops are fully unrolled, and are built
+// for each instruction set that can do all events in a few instructions. One is selected when the stopwatch is
+// initialized, once the number of events is known.
+
+// Events are kept in blocks of four, one vector of each statistic per block. The masked off lanes past the last event
+// of a kernel then never overlap the next array, which the same kernel has just stored to, as masked loads cannot be
+// forwarded from stores.
+#define ACCUMULATE_BLOCK_EVENTS 4
+#define ACCUMULATE_NUM_BLOCKS ((STOPWATCH_MAX_EVENTS + ACCUMULATE_BLOCK_EVENTS - 1) / ACCUMULATE_BLOCK_EVENTS)
+
+// Totals of the values each event in a block took in the invocations added to them. Each index corresponds to one
+// event. Sums wrap around like the counters do. The statistics of a block follow each other, so that an end
+// measurement of up to four events touches 128 contiguous bytes rather than four arrays spread over the readings.
+struct EventTotalsBlock {
+  long long sums[ACCUMULATE_BLOCK_EVENTS];
+  long long mins[ACCUMULATE_BLOCK_EVENTS];  // LLONG_MAX until an invocation is added
+  long long maxs[ACCUMULATE_BLOCK_EVENTS];  // LLONG_MIN until an invocation is added
+  double sums_of_squares[ACCUMULATE_BLOCK_EVENTS];
+};
+
+struct EventTotals {
+  struct EventTotalsBlock blocks[ACCUMULATE_NUM_BLOCKS];
+};
+
+// Statistic `field` i.e. `sums`, of event `event_idx` in `totals`
+#define EVENT_TOTAL(totals, field, event_idx)                                                                          \
+  ((totals)->blocks[(event_idx) / ACCUMULATE_BLOCK_EVENTS].field[(event_idx) % ACCUMULATE_BLOCK_EVENTS])
+
+// Instruction sets the kernels are built for. Only the scalar kernels exist on processors other than x86-64.
+enum AccumulateIsa {
+  ACCUMULATE_SCALAR,
+  ACCUMULATE_AVX2,
+  ACCUMULATE_AVX512,  // AVX-512VL and AVX-512DQ on 256-bit vectors
+  ACCUMULATE_NUM_ISAS,
+};
+
+// Subtracts `start_values` from `values`, leaving the values of the invocation in `values`, and adds them to `totals`.
+// Only the events the kernel is specialized for are touched.
+typedef void (*AccumulateKernel)(long long *values, const long long *start_values, struct EventTotals *totals);
+
+// Kernel of `isa` for `num_events` events, or NULL if `num_events` is more than STOPWATCH_MAX_EVENTS or if the build or
+// the processor does not support `isa`
+AccumulateKernel find_accumulate_kernel(enum AccumulateIsa isa, size_t num_events);
+
+// Fastest kernel for `num_events` events on the processor. Never NULL for up to STOPWATCH_MAX_EVENTS events.
+AccumulateKernel select_accumulate_kernel(size_t num_events);
+
+// Empties `totals` of every event
+void clear_event_totals(struct EventTotals *totals);
+
+// Adds the invocations of `other` to `totals`
+void merge_event_totals(struct EventTotals *totals, const struct EventTotals *other, size_t num_events);
+
+// Takes the invocations of `before` out of the sums of `totals`, which must have been added to `before`. Smallest and
+// largest values cannot be taken apart, so they are kept as they are in `totals`.
+void subtract_event_totals(struct EventTotals *totals, const struct EventTotals *before, size_t num_events);
+
+#endif //LIBSTOPWATCH_SRC_ACCUMULATE_H_
@@ -0,0 +1,132 @@
+// Allocator wrappers of the stopwatch_alloc libraries. Compiled with STOPWATCH_ALLOC_PRELOAD the wrappers replace the
+// allocator functions themselves and forward to the glibc implementations, otherwise they are the `__wrap_` functions
+// of `-Wl,--wrap` and forward to the `__real_` functions.
+#include "stopwatch/stopwatch_alloc.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef STOPWATCH_ALLOC_PRELOAD
+// Exported by glibc so that replacements do not have to look the allocator up through dlsym, which allocates itself
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+#define WRAPPED(function) function
+#define REAL_MALLOC __libc_malloc
+#define REAL_CALLOC __libc_calloc
+#define REAL_REALLOC __libc_realloc
+#define REAL_FREE __libc_free
+#define REAL_ALIGNED_ALLOC __libc_memalign
+#else
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+int __real_posix_memalign(void **ptr, size_t alignment, size_t size);
+void __real_free(void *ptr);
+
+#define WRAPPED(function) __wrap_##function
+#define REAL_MALLOC __real_malloc
+#define REAL_CALLOC __real_calloc
+#define REAL_REALLOC __real_realloc
+#define REAL_FREE __real_free
+#define REAL_ALIGNED_ALLOC __real_aligned_alloc
+#endif
+
+// Initial exec so that accessing the counters never calls into the dynamic loader, which may allocate
+static __thread struct StopwatchAllocCounters thread_counters __attribute__((tls_model("initial-exec")));
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static void record_allocation(void *ptr, size_t size);
+
+static void record_free(void *ptr);
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+struct StopwatchAllocCounters *stopwatch_alloc_counters() {
+  return &thread_counters;
+}
+
+void *WRAPPED(malloc)(size_t size) {
+  void *ptr = REAL_MALLOC(size);
+  record_allocation(ptr, size);
+  return ptr;
+}
+
+void *WRAPPED(calloc)(size_t num, size_t size) {
+  void *ptr = REAL_CALLOC(num, size);
+  record_allocation(ptr, num * size);
+  return ptr;
+}
+
+void *WRAPPED(realloc)(void *ptr, size_t size) {
+  // The usable size of the old allocation is gone once it is reallocated
+  const size_t old_usable_size = ptr ? malloc_usable_size(ptr) : 0;
+  void *new_ptr = REAL_REALLOC(ptr, size);
+  if (new_ptr || size == 0) {
+    thread_counters.live_bytes -= (long long) old_usable_size;
+  }
+  record_allocation(new_ptr, size);
+  return new_ptr;
+}
+
+void *WRAPPED(aligned_alloc)(size_t alignment, size_t size) {
+  void *ptr = REAL_ALIGNED_ALLOC(alignment, size);
+  record_allocation(ptr, size);
+  return ptr;
+}
+
+int WRAPPED(posix_memalign)(void **ptr, size_t alignment, size_t size) {
+#ifdef STOPWATCH_ALLOC_PRELOAD
+  // Alignments that are not a power of two multiple of the pointer size are rejected the same as by glibc
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0) {
+    return EINVAL;
+  }
+  void *new_ptr = __libc_memalign(alignment, size);
+  if (new_ptr == NULL) {
+    return ENOMEM;
+  }
+  *ptr = new_ptr;
+  const int ret_val = 0;
+#else
+  const int ret_val = __real_posix_memalign(ptr, alignment, size);
+#endif
+  if (ret_val == 0) {
+    record_allocation(*ptr, size);
+  }
+  return ret_val;
+}
+
+void WRAPPED(free)(void *ptr) {
+  record_free(ptr);
+  REAL_FREE(ptr);
+}
+
+// =====================================================================================================================
+// Private helper functions implementations
+// =====================================================================================================================
+static void record_allocation(void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return;
+  }
+  thread_counters.allocations++;
+  thread_counters.allocated_bytes += (long long) size;
+  thread_counters.live_bytes += (long long) malloc_usable_size(ptr);
+  if (thread_counters.live_bytes > thread_counters.peak_live_bytes) {
+    thread_counters.peak_live_bytes = thread_counters.live_bytes;
+  }
+}
+
+static void record_free(void *ptr) {
+  if (ptr) {
+    thread_counters.live_bytes -= (long long) malloc_usable_size(ptr);
+  }
+}
@@ -0,0 +1,84 @@
+// RTLD_DEFAULT is a GNU extension
+#define _GNU_SOURCE
+#include "alloc_metrics.h"
+
+#include <dlfcn.h>
+#include <string.h>
+
+// Defined by the stopwatch_alloc libraries. Weak so that programs without them still link.
+extern struct StopwatchAllocCounters *stopwatch_alloc_counters() __attribute__((weak));
+
+// Codes continue below the operating system metrics
+enum AllocMetric {
+  ALLOC_METRIC_ALLOCATIONS = -11,
+  ALLOC_METRIC_ALLOCATED_BYTES = -12,
+  ALLOC_METRIC_PEAK_LIVE_BYTES = -13,
+};
+
+struct AllocMetricDescription {
+  enum AllocMetric metric;
+  const char *name;
+  const char *description;
+  const char *units;
+};
+
+static const struct AllocMetricDescription alloc_metrics[] = {
+    {ALLOC_METRIC_ALLOCATIONS, "allocations", "Successful heap allocations, including reallocations", ""},
+    {ALLOC_METRIC_ALLOCATED_BYTES, "allocated-bytes", "Bytes requested from the heap", "bytes"},
+    // The stopwatch lowers the peak to the live bytes when a routine starts, so the difference is the growth within it
+    {ALLOC_METRIC_PEAK_LIVE_BYTES, "peak-live-bytes", "Largest growth of the live heap bytes of the thread", "bytes"},
+};
+
+#define NUM_ALLOC_METRICS (sizeof(alloc_metrics) / sizeof(alloc_metrics[0]))
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+enum StopwatchStatus find_alloc_metric(const char *metric_name, struct StopwatchEventInfo *info) {
+  for (size_t idx = 0; idx < NUM_ALLOC_METRICS; idx++) {
+    if (strcmp(alloc_metrics[idx].name, metric_name) == 0) {
+      memset(info, 0, sizeof(struct StopwatchEventInfo));
+      info->code = alloc_metrics[idx].metric;
+      strncpy(info->name, alloc_metrics[idx].name, STOPWATCH_EVENT_NAME_LEN - 1);
+      strncpy(info->description, alloc_metrics[idx].description, STOPWATCH_EVENT_DESCRIPTION_LEN - 1);
+      strncpy(info->units, alloc_metrics[idx].units, STOPWATCH_EVENT_UNITS_LEN - 1);
+      strncpy(info->component, "alloc", STOPWATCH_EVENT_COMPONENT_LEN - 1);
+      return STOPWATCH_OK;
+    }
+  }
+  return STOPWATCH_INVALID_EVENT;
+}
+
+const char *alloc_metric_name(size_t metric_idx) {
+  return metric_idx < NUM_ALLOC_METRICS ? alloc_metrics[metric_idx].name : NULL;
+}
+
+AllocCountersGetter find_alloc_counters_getter() {
+  // Linked through --wrap
+  if (stopwatch_alloc_counters) {
+    return stopwatch_alloc_counters;
+  }
+  // Preloaded, in which case the weak reference was already resolved to nothing when the program was linked
+  AllocCountersGetter getter;
+  *(void **) &getter = dlsym(RTLD_DEFAULT, "stopwatch_alloc_counters");
+  return getter;
+}
+
+void read_alloc_metrics(const struct StopwatchAllocCounters *counters,
+                        const struct StopwatchEventInfo *metrics,
+                        size_t num_metrics,
+                        long long *values) {
+  for (size_t idx = 0; idx < num_metrics; idx++) {
+    switch ((enum AllocMetric) metrics[idx].code) {
+      case ALLOC_METRIC_ALLOCATIONS:
+        values[idx] = counters->allocations;
+        break;
+      case ALLOC_METRIC_ALLOCATED_BYTES:
+        values[idx] = counters->allocated_bytes;
+        break;
+      case ALLOC_METRIC_PEAK_LIVE_BYTES:
+        values[idx] = counters->peak_live_bytes;
+        break;
+    }
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef LIBSTOPWATCH_SRC_ALLOC_METRICS_H_
+#define LIBSTOPWATCH_SRC_ALLOC_METRICS_H_
+
+#include <stddef.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_alloc.h"
+
+// Allocations of each thread counted by one of the stopwatch_alloc libraries, measured alongside the events of the
+// backend.
+
+typedef struct StopwatchAllocCounters *(*AllocCountersGetter)();
+
+// Describes the metric `metric_name` i.e. `allocations`. Returns STOPWATCH_INVALID_EVENT if there is no such metric.
+enum StopwatchStatus find_alloc_metric(const char *metric_name, struct StopwatchEventInfo *info);
+
+// Name of the metric `metric_idx`, or NULL past the last metric. Used to enable every metric.
+const char *alloc_metric_name(size_t metric_idx);
+
+// Finds `stopwatch_alloc_counters` whether it was linked into the program or preloaded. Returns NULL if there is no
+// allocation accounting library.
+AllocCountersGetter find_alloc_counters_getter();
+
+// Reads the current values of `metrics` from the counters of the calling thread
+void read_alloc_metrics(const struct StopwatchAllocCounters *counters,
+                        const struct StopwatchEventInfo *metrics,
+                        size_t num_metrics,
+                        long long *values);
+
+#endif //LIBSTOPWATCH_SRC_ALLOC_METRICS_H_
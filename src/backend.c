@@ -0,0 +1,85 @@
+#include "backend.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Every backend built in, the default first
+static const struct CounterBackend *const backends[] = {
+#ifdef STOPWATCH_HAVE_PAPI
+    &papi_backend,
+#endif
+#ifdef STOPWATCH_HAVE_PERF_EVENT
+    &perf_event_backend,
+#endif
+    &timer_backend,
+};
+
+// =====================================================================================================================
+// Timer backend
+// =====================================================================================================================
+
+// Only the wall clock is measured, which the stopwatch reads itself, so there are no events and nothing to count them
+static const char *const timer_default_events[] = {NULL};
+
+// Handed out as the counters of every thread so that they are never mistaken for counters that failed to be created
+static char timer_counters;
+
+static bool timer_init() {
+  return true;
+}
+
+static void timer_shutdown() {
+}
+
+static enum StopwatchStatus timer_find_event(const char *event_name, struct StopwatchEventInfo *info) {
+  (void) event_name;
+  (void) info;
+  return STOPWATCH_INVALID_EVENT;
+}
+
+static enum StopwatchStatus timer_create_counters(const struct StopwatchEventInfo *events,
+                                                  size_t num_events,
+                                                  void **counters) {
+  (void) events;
+  if (num_events > 0) {
+    return STOPWATCH_INVALID_EVENT_COMB;
+  }
+  *counters = &timer_counters;
+  return STOPWATCH_OK;
+}
+
+static bool timer_read_counters(void *counters, long long *values) {
+  (void) counters;
+  (void) values;
+  return true;
+}
+
+static void timer_destroy_counters(void *counters) {
+  (void) counters;
+}
+
+const struct CounterBackend timer_backend = {
+    "timer",
+    timer_default_events,
+    timer_init,
+    timer_shutdown,
+    timer_find_event,
+    timer_create_counters,
+    timer_read_counters,
+    timer_destroy_counters,
+};
+
+// =====================================================================================================================
+// Backend selection
+// =====================================================================================================================
+const struct CounterBackend *find_backend(const char *name) {
+  if (name == NULL) {
+    return backends[0];
+  }
+  for (size_t idx = 0; idx < sizeof(backends) / sizeof(backends[0]); idx++) {
+    if (strcmp(backends[idx]->name, name) == 0) {
+      return backends[idx];
+    }
+  }
+  return NULL;
+}
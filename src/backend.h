@@ -0,0 +1,46 @@
+#ifndef LIBSTOPWATCH_SRC_BACKEND_H_
+#define LIBSTOPWATCH_SRC_BACKEND_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "stopwatch/stopwatch.h"
+
+// Source of the event counts. The stopwatch only ever reads all events of a thread at once and takes differences, so a
+// backend only has to provide counters that start when they are created and never stop or reset.
+struct CounterBackend {
+  // Name selected through `STOPWATCH_BACKEND`
+  const char *name;
+  // Events measured when `STOPWATCH_EVENTS` is not set. NULL terminated.
+  const char *const *default_events;
+  // Called by `stopwatch_init` before anything else. Returns false if the backend cannot be used.
+  bool (*init)();
+  // Called by `stopwatch_destroy` after every counter is destroyed, even if `init` failed
+  void (*shutdown)();
+  // Describes the event `event_name`. Returns STOPWATCH_INVALID_EVENT if the backend does not know it.
+  enum StopwatchStatus (*find_event)(const char *event_name, struct StopwatchEventInfo *info);
+  // Creates and starts counters of `events` on the calling thread. Returns STOPWATCH_INVALID_EVENT_COMB if the events
+  // cannot be measured together.
+  enum StopwatchStatus (*create_counters)(const struct StopwatchEventInfo *events, size_t num_events, void **counters);
+  // Reads the current value of every event of `counters` in the order they were created with. Only called by the thread
+  // that created them.
+  bool (*read_counters)(void *counters, long long *values);
+  // Stops and frees counters. May be called by any thread once the owning thread no longer reads them.
+  void (*destroy_counters)(void *counters);
+};
+
+#ifdef STOPWATCH_HAVE_PAPI
+extern const struct CounterBackend papi_backend;
+#endif
+
+#ifdef STOPWATCH_HAVE_PERF_EVENT
+extern const struct CounterBackend perf_event_backend;
+#endif
+
+extern const struct CounterBackend timer_backend;
+
+// Backend named `name`, or the default backend of the build if `name` is NULL. Returns NULL if there is no such
+// backend in this build.
+const struct CounterBackend *find_backend(const char *name);
+
+#endif //LIBSTOPWATCH_SRC_BACKEND_H_
@@ -0,0 +1,73 @@
+#include "dump.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+void dump_writer_init(struct DumpWriter *writer, int fd) {
+  writer->fd = fd;
+  writer->size = 0;
+  writer->failed = false;
+}
+
+void dump_write_char(struct DumpWriter *writer, char value) {
+  if (writer->size == DUMP_WRITER_BUFFER_SIZE) {
+    dump_writer_flush(writer);
+  }
+  writer->buffer[writer->size++] = value;
+}
+
+void dump_write_str(struct DumpWriter *writer, const char *str) {
+  for (; *str; str++) {
+    dump_write_char(writer, *str);
+  }
+}
+
+void dump_write_lld(struct DumpWriter *writer, long long value) {
+  // Digits are produced from the least significant one. Negating the most negative value overflows, so the digits of
+  // negative values are taken from the negative value itself.
+  char digits[20];
+  size_t num_digits = 0;
+  const bool negative = value < 0;
+  do {
+    const int digit = (int) (value % 10);
+    digits[num_digits++] = (char) ('0' + (negative ? -digit : digit));
+    value /= 10;
+  } while (value != 0);
+
+  if (negative) {
+    dump_write_char(writer, '-');
+  }
+  while (num_digits > 0) {
+    dump_write_char(writer, digits[--num_digits]);
+  }
+}
+
+void dump_write_zu(struct DumpWriter *writer, size_t value) {
+  char digits[20];
+  size_t num_digits = 0;
+  do {
+    digits[num_digits++] = (char) ('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (num_digits > 0) {
+    dump_write_char(writer, digits[--num_digits]);
+  }
+}
+
+bool dump_writer_flush(struct DumpWriter *writer) {
+  size_t written = 0;
+  while (!writer->failed && written < writer->size) {
+    const ssize_t ret_val = write(writer->fd, writer->buffer + written, writer->size - written);
+    if (ret_val > 0) {
+      written += (size_t) ret_val;
+    } else if (ret_val == 0 || errno != EINTR) {
+      writer->failed = true;
+    }
+  }
+  writer->size = 0;
+  return !writer->failed;
+}
@@ -0,0 +1,31 @@
+#ifndef LIBSTOPWATCH_SRC_DUMP_H_
+#define LIBSTOPWATCH_SRC_DUMP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define DUMP_WRITER_BUFFER_SIZE 4096
+
+// Buffered writer to a file descriptor that only uses async-signal-safe functions, so it may be used from a signal
+// handler. It does not allocate and is meant to live on the stack.
+struct DumpWriter {
+  int fd;
+  size_t size;  // Number of bytes of `buffer` in use
+  bool failed;  // Set once a write fails. Everything written afterwards is discarded
+  char buffer[DUMP_WRITER_BUFFER_SIZE];
+};
+
+void dump_writer_init(struct DumpWriter *writer, int fd);
+
+void dump_write_str(struct DumpWriter *writer, const char *str);
+
+void dump_write_char(struct DumpWriter *writer, char value);
+
+void dump_write_lld(struct DumpWriter *writer, long long value);
+
+void dump_write_zu(struct DumpWriter *writer, size_t value);
+
+// Writes out everything that is buffered. Returns false if any write failed.
+bool dump_writer_flush(struct DumpWriter *writer);
+
+#endif //LIBSTOPWATCH_SRC_DUMP_H_
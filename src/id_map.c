@@ -0,0 +1,65 @@
+#include "id_map.h"
+
+#include <stdlib.h>
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static struct IdMapTable *create_table(size_t num_buckets);
+
+// Stores `id` in the first empty bucket from its home bucket. The entry is written before the ID is published so that
+// a lookup that finds the ID also sees its entry.
+static void place(struct IdMapTable *table, size_t id, size_t entry);
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+bool id_map_insert(struct IdMap *map, size_t id, size_t entry) {
+  struct IdMapTable *table = __atomic_load_n(&map->table, __ATOMIC_RELAXED);
+  if (table == NULL || 2 * (table->num_ids + 1) > table->num_buckets) {
+    struct IdMapTable *grown = create_table(table ? 2 * table->num_buckets : ID_MAP_MIN_BUCKETS);
+    if (grown == NULL) {
+      return false;
+    }
+    for (size_t bucket = 0; table && bucket < table->num_buckets; bucket++) {
+      if (table->ids[bucket] != 0) {
+        place(grown, table->ids[bucket], table->entries[bucket]);
+      }
+    }
+    grown->replaced = table;
+    // Released so that lookups picking up the new table see every ID copied into it
+    __atomic_store_n(&map->table, grown, __ATOMIC_RELEASE);
+    table = grown;
+  }
+  place(table, id, entry);
+  return true;
+}
+
+// =====================================================================================================================
+// Private helper functions implementations
+// =====================================================================================================================
+static struct IdMapTable *create_table(size_t num_buckets) {
+  // The IDs and entries follow the table in the same allocation, the IDs first to keep them aligned
+  struct IdMapTable *table = calloc(1, sizeof(struct IdMapTable) + num_buckets * (sizeof(size_t) + sizeof(uint32_t)));
+  if (table == NULL) {
+    return NULL;
+  }
+  table->num_buckets = num_buckets;
+  table->shift = 64;
+  for (size_t buckets = num_buckets; buckets > 1; buckets >>= 1) {
+    table->shift--;
+  }
+  table->ids = (size_t *) (table + 1);
+  table->entries = (uint32_t *) (table->ids + num_buckets);
+  return table;
+}
+
+static void place(struct IdMapTable *table, size_t id, size_t entry) {
+  size_t bucket = id_map_home_bucket(table, id);
+  while (table->ids[bucket] != 0) {
+    bucket = (bucket + 1) & (table->num_buckets - 1);
+  }
+  table->entries[bucket] = (uint32_t) entry;
+  __atomic_store_n(&table->ids[bucket], id, __ATOMIC_RELEASE);
+  table->num_ids++;
+}
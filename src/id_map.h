@@ -0,0 +1,62 @@
+#ifndef LIBSTOPWATCH_SRC_ID_MAP_H_
+#define LIBSTOPWATCH_SRC_ID_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ID_MAP_NOT_FOUND SIZE_MAX
+#define ID_MAP_MIN_BUCKETS 64
+
+// Open addressing hash table with linear probing mapping arbitrary routine IDs to the dense entries the measurements are
+// stored at. The IDs and the entries are kept in separate arrays so that probing only walks the IDs, eight to a cache
+// line. ID 0 marks an empty bucket, so it is never stored and always maps to entry 0.
+struct IdMapTable {
+  size_t num_buckets;  // Always a power of 2
+  unsigned int shift;  // Bits of the hash dropped to pick the home bucket of an ID
+  size_t num_ids;
+  // Only accessed through atomic builtins as lookups read them while an ID is inserted
+  size_t *ids;
+  uint32_t *entries;
+  // Table this one replaced. Never freed as lookups that started before it was replaced may still be probing it.
+  struct IdMapTable *replaced;
+};
+
+// Lookups never lock and may run at the same time as an insert, while inserts must be serialized by the caller. A table
+// is kept at most half full by replacing it with one twice its size, which is only published once every ID is copied
+// over, so lookups never wait for it to grow. Tables are never freed, so a map lives as long as the process, like the
+// routine entries it maps to.
+struct IdMap {
+  struct IdMapTable *table;  // Only accessed through atomic builtins. NULL until the first insert
+};
+
+// Fibonacci hashing spreads consecutive and hashed IDs alike over the buckets using the top bits of the product
+static inline size_t id_map_home_bucket(const struct IdMapTable *table, size_t id) {
+  return (size_t) (((uint64_t) id * 0x9E3779B97F4A7C15ull) >> table->shift);
+}
+
+// Entry of `id`, or ID_MAP_NOT_FOUND if it was never inserted
+static inline size_t id_map_find(const struct IdMap *map, size_t id) {
+  if (id == 0) {
+    return 0;
+  }
+  const struct IdMapTable *table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+  if (table == NULL) {
+    return ID_MAP_NOT_FOUND;
+  }
+  // Ends as the table always has empty buckets
+  for (size_t bucket = id_map_home_bucket(table, id);; bucket = (bucket + 1) & (table->num_buckets - 1)) {
+    const size_t bucket_id = __atomic_load_n(&table->ids[bucket], __ATOMIC_ACQUIRE);
+    if (bucket_id == id) {
+      return table->entries[bucket];
+    }
+    if (bucket_id == 0) {
+      return ID_MAP_NOT_FOUND;
+    }
+  }
+}
+
+// Maps `id`, which must not be 0 or already inserted, to `entry`. Returns false if the table cannot grow.
+bool id_map_insert(struct IdMap *map, size_t id, size_t entry);
+
+#endif //LIBSTOPWATCH_SRC_ID_MAP_H_
@@ -0,0 +1,313 @@
+// Implementation of the `-finstrument-functions` hooks. Must not be compiled with `-finstrument-functions` itself.
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <link.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_instrument.h"
+
+#define NO_INSTRUMENT __attribute__((no_instrument_function))
+
+#define NO_SLOT STOPWATCH_INSTRUMENT_MAX_FUNCTIONS
+
+// Buffer size of the name given to functions that cannot be found in any symbol table i.e. "0x" followed by the address
+#define ADDRESS_NAME_LEN 32
+
+// State of a slot in the function table
+enum SlotState {
+  SLOT_UNRESOLVED, // Function address claimed but not yet filtered and registered
+  SLOT_MEASURED,
+  SLOT_FILTERED,   // Excluded by the filters or could not be registered
+};
+
+// Open addressing hash table from function address to slot. A slot is claimed by atomically swapping its address from
+// 0 so that threads never have to lock to find or add a function.
+static _Atomic uintptr_t slot_functions[STOPWATCH_INSTRUMENT_MAX_FUNCTIONS];
+static _Atomic unsigned char slot_states[STOPWATCH_INSTRUMENT_MAX_FUNCTIONS];
+// Stopwatch routine ID of each slot. Written by `stopwatch_register_routine` before the slot state is published
+static size_t slot_routine_ids[STOPWATCH_INSTRUMENT_MAX_FUNCTIONS];
+// Function names resolved at report time
+static char *slot_names[STOPWATCH_INSTRUMENT_MAX_FUNCTIONS];
+
+// Shadow stack of the functions currently executing on this thread. Each entry is the slot of the function plus one, or
+// 0 if the function is not measured. Functions deeper than `max_depth` are only counted.
+static __thread size_t shadow_stack[STOPWATCH_INSTRUMENT_MAX_DEPTH];
+static __thread size_t shadow_stack_size = 0;
+
+// Set if the function of a slot is already being measured on this thread. The stopwatch keeps a single start
+// measurement per routine and thread, so only the outermost call of a recursive function is measured.
+static __thread bool slot_active[STOPWATCH_INSTRUMENT_MAX_FUNCTIONS];
+
+// Configuration read from the environment
+static pthread_once_t config_once = PTHREAD_ONCE_INIT;
+static size_t max_depth = STOPWATCH_INSTRUMENT_MAX_DEPTH;
+static char **include_patterns = NULL;
+static char **exclude_patterns = NULL;
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static void read_config() NO_INSTRUMENT;
+
+static char **parse_patterns(const char *env_var) NO_INSTRUMENT;
+
+static bool matches_any(char *const *patterns, const char *name) NO_INSTRUMENT;
+
+static size_t find_slot(uintptr_t function) NO_INSTRUMENT;
+
+static enum SlotState resolve_slot(size_t slot, uintptr_t function) NO_INSTRUMENT;
+
+static char *symbol_name(uintptr_t function) NO_INSTRUMENT;
+
+static char *elf_symbol_name(const char *file_name, uintptr_t function, uintptr_t load_address) NO_INSTRUMENT;
+
+// =====================================================================================================================
+// Compiler instrumentation hooks
+// =====================================================================================================================
+void __cyg_profile_func_enter(void *function, void *call_site) NO_INSTRUMENT;
+
+void __cyg_profile_func_exit(void *function, void *call_site) NO_INSTRUMENT;
+
+void __cyg_profile_func_enter(void *function, void *call_site) {
+  (void) call_site;
+  pthread_once(&config_once, read_config);
+
+  const size_t depth = shadow_stack_size++;
+  if (depth >= max_depth) {
+    return;
+  }
+  shadow_stack[depth] = 0;
+
+  const size_t slot = find_slot((uintptr_t) function);
+  if (slot == NO_SLOT || slot_active[slot]) {
+    return;
+  }
+  // Fails before `stopwatch_init` and after `stopwatch_destroy`, in which case the function is simply not measured
+  if (stopwatch_record_start_registered(slot_routine_ids[slot]) == STOPWATCH_OK) {
+    slot_active[slot] = true;
+    shadow_stack[depth] = slot + 1;
+  }
+}
+
+void __cyg_profile_func_exit(void *function, void *call_site) {
+  (void) function;
+  (void) call_site;
+  // Functions that were entered before this thread started being traced i.e. the thread start routine
+  if (shadow_stack_size == 0) {
+    return;
+  }
+
+  const size_t depth = --shadow_stack_size;
+  if (depth >= max_depth || shadow_stack[depth] == 0) {
+    return;
+  }
+  const size_t slot = shadow_stack[depth] - 1;
+  slot_active[slot] = false;
+  stopwatch_record_end_measurements(slot_routine_ids[slot]);
+}
+
+// =====================================================================================================================
+// Public interface functions implementations
+// =====================================================================================================================
+NO_INSTRUMENT const char *stopwatch_instrument_routine_name(size_t routine_id) {
+  for (size_t slot = 0; slot < STOPWATCH_INSTRUMENT_MAX_FUNCTIONS; slot++) {
+    if (atomic_load(&slot_states[slot]) != SLOT_MEASURED || slot_routine_ids[slot] != routine_id) {
+      continue;
+    }
+    if (slot_names[slot] == NULL) {
+      slot_names[slot] = symbol_name(atomic_load(&slot_functions[slot]));
+    }
+    return slot_names[slot];
+  }
+  return NULL;
+}
+
+// =====================================================================================================================
+// Private helper functions implementation
+// =====================================================================================================================
+static void read_config() {
+  const char *depth_env_val = getenv("STOPWATCH_INSTRUMENT_MAX_DEPTH");
+  if (depth_env_val) {
+    const long depth = strtol(depth_env_val, NULL, 10);
+    if (depth >= 0 && depth <= STOPWATCH_INSTRUMENT_MAX_DEPTH) {
+      max_depth = (size_t) depth;
+    }
+  }
+  include_patterns = parse_patterns("STOPWATCH_INSTRUMENT_INCLUDE");
+  exclude_patterns = parse_patterns("STOPWATCH_INSTRUMENT_EXCLUDE");
+}
+
+// Splits a comma delimited environment variable into a NULL terminated array of patterns. Returns NULL if unset.
+static char **parse_patterns(const char *env_var) {
+  const char *env_val = getenv(env_var);
+  if (env_val == NULL) {
+    return NULL;
+  }
+
+  // Upper bound on the number of patterns plus the NULL terminator
+  size_t max_patterns = 2;
+  for (const char *cursor = env_val; *cursor; cursor++) {
+    if (*cursor == ',') {
+      max_patterns++;
+    }
+  }
+
+  char **patterns = calloc(max_patterns, sizeof(char *));
+  // A copy is made as strtok_r mutates the arguments. It is owned by the patterns for the lifetime of the program.
+  char *env_var_copy = strdup(env_val);
+  char *save_ptr;
+  size_t num_patterns = 0;
+  for (char *token = strtok_r(env_var_copy, ",", &save_ptr); token != NULL; token = strtok_r(NULL, ",", &save_ptr)) {
+    patterns[num_patterns] = token;
+    num_patterns++;
+  }
+  return patterns;
+}
+
+static bool matches_any(char *const *patterns, const char *name) {
+  for (size_t idx = 0; patterns[idx]; idx++) {
+    if (fnmatch(patterns[idx], name, 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the slot of a measured function, or NO_SLOT if the function is filtered out or the table is full.
+static size_t find_slot(uintptr_t function) {
+  // Fibonacci hashing of the address. The low bits are dropped as functions are usually aligned.
+  size_t slot = (size_t) (((function >> 4) * 11400714819323198485llu) >> 32) % STOPWATCH_INSTRUMENT_MAX_FUNCTIONS;
+
+  for (size_t probe = 0; probe < STOPWATCH_INSTRUMENT_MAX_FUNCTIONS; probe++) {
+    uintptr_t slot_function = atomic_load_explicit(&slot_functions[slot], memory_order_acquire);
+    if (slot_function == 0) {
+      // Claim the empty slot. On failure `slot_function` holds whatever another thread claimed it with.
+      atomic_compare_exchange_strong(&slot_functions[slot], &slot_function, function);
+      if (slot_function == 0) {
+        slot_function = function;
+      }
+    }
+
+    if (slot_function == function) {
+      enum SlotState state = atomic_load_explicit(&slot_states[slot], memory_order_acquire);
+      if (state == SLOT_UNRESOLVED) {
+        state = resolve_slot(slot, function);
+      }
+      return state == SLOT_MEASURED ? slot : NO_SLOT;
+    }
+    slot = (slot + 1) % STOPWATCH_INSTRUMENT_MAX_FUNCTIONS;
+  }
+  return NO_SLOT;
+}
+
+// Applies the filters and registers the function of a newly claimed slot. May run concurrently on several threads for
+// the same slot, which is fine as registration only happens once and the outcome is the same.
+static enum SlotState resolve_slot(size_t slot, uintptr_t function) {
+  enum SlotState state = SLOT_MEASURED;
+  if (include_patterns || exclude_patterns) {
+    char *name = symbol_name(function);
+    if ((include_patterns && !matches_any(include_patterns, name)) ||
+        (exclude_patterns && matches_any(exclude_patterns, name))) {
+      state = SLOT_FILTERED;
+    }
+    free(name);
+  }
+
+  if (state == SLOT_MEASURED) {
+    stopwatch_set_name_resolver(stopwatch_instrument_routine_name);
+    if (stopwatch_register_routine(NULL, &slot_routine_ids[slot]) != STOPWATCH_OK) {
+      state = SLOT_FILTERED;
+    }
+  }
+  atomic_store_explicit(&slot_states[slot], state, memory_order_release);
+  return state;
+}
+
+// Looks up the name of the function at an address. Only exported symbols can be found through `dladdr`, so the symbol
+// table of the object containing the function is searched otherwise. Falls back to the address of the function.
+static char *symbol_name(uintptr_t function) {
+  Dl_info info;
+  if (dladdr((void *) function, &info)) {
+    if (info.dli_sname) {
+      return strdup(info.dli_sname);
+    }
+
+    char *name = elf_symbol_name(info.dli_fname, function, (uintptr_t) info.dli_fbase);
+    // `dli_fname` of the main program is not always a path that can be opened
+    if (name == NULL) {
+      name = elf_symbol_name("/proc/self/exe", function, (uintptr_t) info.dli_fbase);
+    }
+    if (name) {
+      return name;
+    }
+  }
+
+  char *name = malloc(ADDRESS_NAME_LEN);
+  snprintf(name, ADDRESS_NAME_LEN, "%#lx", (unsigned long) function);
+  return name;
+}
+
+// Searches the static symbol table of an ELF file loaded at `load_address` for the function containing `function`.
+// Returns NULL if not found.
+static char *elf_symbol_name(const char *file_name, uintptr_t function, uintptr_t load_address) {
+  if (file_name == NULL || file_name[0] == '\0') {
+    return NULL;
+  }
+  const int fd = open(file_name, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || (size_t) file_stat.st_size < sizeof(ElfW(Ehdr))) {
+    close(fd);
+    return NULL;
+  }
+  const size_t file_size = file_stat.st_size;
+  const unsigned char *file = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    return NULL;
+  }
+
+  char *name = NULL;
+  const ElfW(Ehdr) *header = (const ElfW(Ehdr) *) file;
+  if (memcmp(header->e_ident, ELFMAG, SELFMAG) == 0 && header->e_shoff + header->e_shnum * sizeof(ElfW(Shdr)) <= file_size) {
+    // Symbols of shared objects and position independent executables are relative to where they are loaded
+    const uintptr_t offset = header->e_type == ET_DYN ? function - load_address : function;
+    const ElfW(Shdr) *sections = (const ElfW(Shdr) *) (file + header->e_shoff);
+    for (size_t section_idx = 0; section_idx < header->e_shnum && name == NULL; section_idx++) {
+      const ElfW(Shdr) *section = &sections[section_idx];
+      if (section->sh_type != SHT_SYMTAB || section->sh_link >= header->e_shnum ||
+          section->sh_offset + section->sh_size > file_size) {
+        continue;
+      }
+      const ElfW(Shdr) *strings = &sections[section->sh_link];
+      const ElfW(Sym) *symbols = (const ElfW(Sym) *) (file + section->sh_offset);
+      const size_t num_symbols = section->sh_size / sizeof(ElfW(Sym));
+
+      // ELF64_ST_TYPE is identical to ELF32_ST_TYPE
+      for (size_t symbol_idx = 0; symbol_idx < num_symbols; symbol_idx++) {
+        const ElfW(Sym) *symbol = &symbols[symbol_idx];
+        if (ELF64_ST_TYPE(symbol->st_info) == STT_FUNC && symbol->st_value <= offset &&
+            offset < symbol->st_value + symbol->st_size && symbol->st_name < strings->sh_size) {
+          name = strdup((const char *) (file + strings->sh_offset + symbol->st_name));
+          break;
+        }
+      }
+    }
+  }
+  munmap((void *) file, file_size);
+  return name;
+}
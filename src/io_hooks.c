@@ -0,0 +1,108 @@
+// I/O wrappers of the stopwatch_io libraries. Compiled with STOPWATCH_IO_PRELOAD the wrappers replace the functions
+// themselves and forward to the next definition found by the dynamic loader, otherwise they are the `__wrap_` functions
+// of `-Wl,--wrap` and forward to the `__real_` functions.
+#ifdef STOPWATCH_IO_PRELOAD
+// RTLD_NEXT is a GNU extension
+#define _GNU_SOURCE
+#endif
+#include "stopwatch/stopwatch_io.h"
+
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef STOPWATCH_IO_PRELOAD
+#include <dlfcn.h>
+
+#define WRAPPED(function) function
+
+// Looked up on the first call of each function
+static ssize_t (*real_read)(int, void *, size_t) = NULL;
+static ssize_t (*real_write)(int, const void *, size_t) = NULL;
+static ssize_t (*real_pread)(int, void *, size_t, off_t) = NULL;
+static ssize_t (*real_pwrite)(int, const void *, size_t, off_t) = NULL;
+
+#define REAL(function) (real_##function ? real_##function : (*(void **) &real_##function = dlsym(RTLD_NEXT, #function), \
+                                                             real_##function))
+#else
+ssize_t __real_read(int fd, void *buf, size_t count);
+ssize_t __real_write(int fd, const void *buf, size_t count);
+ssize_t __real_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t __real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+#define WRAPPED(function) __wrap_##function
+#define REAL(function) __real_##function
+#endif
+
+// Initial exec so that accessing the counters never calls into the dynamic loader
+static __thread struct StopwatchIoCounters thread_counters __attribute__((tls_model("initial-exec")));
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static long long now_nsec();
+
+static void record_read(ssize_t size, long long start_nsec);
+
+static void record_write(ssize_t size, long long start_nsec);
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+struct StopwatchIoCounters *stopwatch_io_counters() {
+  return &thread_counters;
+}
+
+ssize_t WRAPPED(read)(int fd, void *buf, size_t count) {
+  const long long start_nsec = now_nsec();
+  const ssize_t size = REAL(read)(fd, buf, count);
+  record_read(size, start_nsec);
+  return size;
+}
+
+ssize_t WRAPPED(write)(int fd, const void *buf, size_t count) {
+  const long long start_nsec = now_nsec();
+  const ssize_t size = REAL(write)(fd, buf, count);
+  record_write(size, start_nsec);
+  return size;
+}
+
+ssize_t WRAPPED(pread)(int fd, void *buf, size_t count, off_t offset) {
+  const long long start_nsec = now_nsec();
+  const ssize_t size = REAL(pread)(fd, buf, count, offset);
+  record_read(size, start_nsec);
+  return size;
+}
+
+ssize_t WRAPPED(pwrite)(int fd, const void *buf, size_t count, off_t offset) {
+  const long long start_nsec = now_nsec();
+  const ssize_t size = REAL(pwrite)(fd, buf, count, offset);
+  record_write(size, start_nsec);
+  return size;
+}
+
+// =====================================================================================================================
+// Private helper functions implementations
+// =====================================================================================================================
+static long long now_nsec() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Failed calls are counted but transfer nothing. The errno of the call is left untouched for the caller.
+static void record_read(ssize_t size, long long start_nsec) {
+  thread_counters.blocked_nsec += now_nsec() - start_nsec;
+  thread_counters.read_calls++;
+  if (size > 0) {
+    thread_counters.bytes_read += size;
+  }
+}
+
+static void record_write(ssize_t size, long long start_nsec) {
+  thread_counters.blocked_nsec += now_nsec() - start_nsec;
+  thread_counters.write_calls++;
+  if (size > 0) {
+    thread_counters.bytes_written += size;
+  }
+}
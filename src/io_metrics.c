@@ -0,0 +1,94 @@
+// RTLD_DEFAULT is a GNU extension
+#define _GNU_SOURCE
+#include "io_metrics.h"
+
+#include <dlfcn.h>
+#include <string.h>
+
+// Defined by the stopwatch_io libraries. Weak so that programs without them still link.
+extern struct StopwatchIoCounters *stopwatch_io_counters() __attribute__((weak));
+
+// Codes continue below the allocation metrics
+enum IoMetric {
+  IO_METRIC_READ_CALLS = -21,
+  IO_METRIC_WRITE_CALLS = -22,
+  IO_METRIC_READ_BYTES = -23,
+  IO_METRIC_WRITE_BYTES = -24,
+  IO_METRIC_BLOCKED_USEC = -25,
+};
+
+struct IoMetricDescription {
+  enum IoMetric metric;
+  const char *name;
+  const char *description;
+  const char *units;
+};
+
+static const struct IoMetricDescription io_metrics[] = {
+    {IO_METRIC_READ_CALLS, "read-calls", "Calls of read and pread", ""},
+    {IO_METRIC_WRITE_CALLS, "write-calls", "Calls of write and pwrite", ""},
+    {IO_METRIC_READ_BYTES, "read-bytes", "Bytes read", "bytes"},
+    {IO_METRIC_WRITE_BYTES, "write-bytes", "Bytes written", "bytes"},
+    // Part of the real time of the routine, so the rest of it was spent computing
+    {IO_METRIC_BLOCKED_USEC, "io-blocked-usec", "Time spent blocked in reads and writes", "microseconds"},
+};
+
+#define NUM_IO_METRICS (sizeof(io_metrics) / sizeof(io_metrics[0]))
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+enum StopwatchStatus find_io_metric(const char *metric_name, struct StopwatchEventInfo *info) {
+  for (size_t idx = 0; idx < NUM_IO_METRICS; idx++) {
+    if (strcmp(io_metrics[idx].name, metric_name) == 0) {
+      memset(info, 0, sizeof(struct StopwatchEventInfo));
+      info->code = io_metrics[idx].metric;
+      strncpy(info->name, io_metrics[idx].name, STOPWATCH_EVENT_NAME_LEN - 1);
+      strncpy(info->description, io_metrics[idx].description, STOPWATCH_EVENT_DESCRIPTION_LEN - 1);
+      strncpy(info->units, io_metrics[idx].units, STOPWATCH_EVENT_UNITS_LEN - 1);
+      strncpy(info->component, "io", STOPWATCH_EVENT_COMPONENT_LEN - 1);
+      return STOPWATCH_OK;
+    }
+  }
+  return STOPWATCH_INVALID_EVENT;
+}
+
+const char *io_metric_name(size_t metric_idx) {
+  return metric_idx < NUM_IO_METRICS ? io_metrics[metric_idx].name : NULL;
+}
+
+IoCountersGetter find_io_counters_getter() {
+  // Linked through --wrap
+  if (stopwatch_io_counters) {
+    return stopwatch_io_counters;
+  }
+  // Preloaded, in which case the weak reference was already resolved to nothing when the program was linked
+  IoCountersGetter getter;
+  *(void **) &getter = dlsym(RTLD_DEFAULT, "stopwatch_io_counters");
+  return getter;
+}
+
+void read_io_metrics(const struct StopwatchIoCounters *counters,
+                     const struct StopwatchEventInfo *metrics,
+                     size_t num_metrics,
+                     long long *values) {
+  for (size_t idx = 0; idx < num_metrics; idx++) {
+    switch ((enum IoMetric) metrics[idx].code) {
+      case IO_METRIC_READ_CALLS:
+        values[idx] = counters->read_calls;
+        break;
+      case IO_METRIC_WRITE_CALLS:
+        values[idx] = counters->write_calls;
+        break;
+      case IO_METRIC_READ_BYTES:
+        values[idx] = counters->bytes_read;
+        break;
+      case IO_METRIC_WRITE_BYTES:
+        values[idx] = counters->bytes_written;
+        break;
+      case IO_METRIC_BLOCKED_USEC:
+        values[idx] = counters->blocked_nsec / 1000;
+        break;
+    }
+  }
+}
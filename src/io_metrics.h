@@ -0,0 +1,29 @@
+#ifndef LIBSTOPWATCH_SRC_IO_METRICS_H_
+#define LIBSTOPWATCH_SRC_IO_METRICS_H_
+
+#include <stddef.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_io.h"
+
+// I/O of each thread counted by one of the stopwatch_io libraries, measured alongside the events of the backend.
+
+typedef struct StopwatchIoCounters *(*IoCountersGetter)();
+
+// Describes the metric `metric_name` i.e. `read-bytes`. Returns STOPWATCH_INVALID_EVENT if there is no such metric.
+enum StopwatchStatus find_io_metric(const char *metric_name, struct StopwatchEventInfo *info);
+
+// Name of the metric `metric_idx`, or NULL past the last metric. Used to enable every metric.
+const char *io_metric_name(size_t metric_idx);
+
+// Finds `stopwatch_io_counters` whether it was linked into the program or preloaded. Returns NULL if there is no I/O
+// accounting library.
+IoCountersGetter find_io_counters_getter();
+
+// Reads the current values of `metrics` from the counters of the calling thread
+void read_io_metrics(const struct StopwatchIoCounters *counters,
+                     const struct StopwatchEventInfo *metrics,
+                     size_t num_metrics,
+                     long long *values);
+
+#endif //LIBSTOPWATCH_SRC_IO_METRICS_H_
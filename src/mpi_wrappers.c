@@ -0,0 +1,593 @@
+// PMPI wrappers of the stopwatch_mpi library measuring MPI calls, and the reduction of the totals over the ranks
+#include <mpi.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_mpi.h"
+
+// MPI functions that are measured. Each is a separate routine for every routine it is called in.
+enum MpiCall {
+  MPI_CALL_SEND,
+  MPI_CALL_RECV,
+  MPI_CALL_ISEND,
+  MPI_CALL_IRECV,
+  MPI_CALL_SENDRECV,
+  MPI_CALL_WAIT,
+  MPI_CALL_WAITALL,
+  MPI_CALL_BARRIER,
+  MPI_CALL_BCAST,
+  MPI_CALL_REDUCE,
+  MPI_CALL_ALLREDUCE,
+  MPI_CALL_GATHER,
+  MPI_CALL_SCATTER,
+  MPI_CALL_ALLGATHER,
+  MPI_CALL_ALLTOALL,
+  NUM_MPI_CALLS,
+};
+
+static const char *const call_names[NUM_MPI_CALLS] = {
+    "MPI_Send",
+    "MPI_Recv",
+    "MPI_Isend",
+    "MPI_Irecv",
+    "MPI_Sendrecv",
+    "MPI_Wait",
+    "MPI_Waitall",
+    "MPI_Barrier",
+    "MPI_Bcast",
+    "MPI_Reduce",
+    "MPI_Allreduce",
+    "MPI_Gather",
+    "MPI_Scatter",
+    "MPI_Allgather",
+    "MPI_Alltoall",
+};
+
+// Routine measuring an MPI function called in a routine, along with the bytes of those calls over every thread
+struct RegionEntry {
+  enum MpiCall call;
+  size_t parent_routine_id;
+  size_t routine_id;
+  atomic_llong bytes;
+};
+
+// Every routine registered so far. Only appended to while holding `regions_lock`, and entries never move once added.
+static struct RegionEntry regions[STOPWATCH_MPI_MAX_REGIONS];
+static size_t num_regions = 0;
+static pthread_mutex_t regions_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Last routine looked up for each function on this thread, so that repeated calls do not take the lock
+static __thread size_t cached_parent_ids[NUM_MPI_CALLS];
+static __thread struct RegionEntry *cached_entries[NUM_MPI_CALLS];
+
+// Totals of a routine on a single rank, exchanged as plain bytes when they are reduced
+struct RankTotals {
+  char path[STOPWATCH_MPI_PATH_LEN];
+  int rank;
+  long long times_called;
+  long long real_usec;
+  long long bytes;
+  long long event_values[STOPWATCH_MAX_EVENTS];
+};
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static struct RegionEntry *find_region(enum MpiCall call, size_t parent_routine_id);
+
+static struct RegionEntry *begin_call(enum MpiCall call);
+
+static void end_call(struct RegionEntry *entry, long long bytes);
+
+static long long message_bytes(int count, MPI_Datatype datatype);
+
+static long long region_bytes(size_t routine_id);
+
+static size_t collect_rank_totals(struct RankTotals *totals, int rank);
+
+static void set_path(char *path, size_t routine_id);
+
+static int compare_paths(const void *lhs, const void *rhs);
+
+static void write_summary_row(FILE *output_file, const struct RankTotals *totals, size_t num_totals, size_t num_events);
+
+// =====================================================================================================================
+// Public interface functions implementations
+// =====================================================================================================================
+void stopwatch_mpi_print_summary() {
+  pthread_mutex_lock(&regions_lock);
+  const size_t num_entries = num_regions;
+  pthread_mutex_unlock(&regions_lock);
+
+  long long calls[NUM_MPI_CALLS] = {0};
+  long long real_usec[NUM_MPI_CALLS] = {0};
+  long long bytes[NUM_MPI_CALLS] = {0};
+  struct StopwatchMeasurementResult result;
+  for (size_t entry = 0; entry < num_entries; entry++) {
+    if (stopwatch_get_measurement_results(regions[entry].routine_id, &result) == STOPWATCH_OK) {
+      calls[regions[entry].call] += result.total_times_called;
+      real_usec[regions[entry].call] += result.total_real_usec;
+      bytes[regions[entry].call] += atomic_load_explicit(&regions[entry].bytes, memory_order_relaxed);
+    }
+  }
+
+  bool printed_header = false;
+  for (size_t call = 0; call < NUM_MPI_CALLS; call++) {
+    if (calls[call] == 0) {
+      continue;
+    }
+    if (!printed_header) {
+      printf("MPI calls\n");
+      printf("%-16s %10s %16s %16s %16s\n", "FUNCTION", "CALLS", "REAL USEC", "BYTES", "BYTES PER CALL");
+      printed_header = true;
+    }
+    printf("%-16s %10lld %16lld %16lld %16lld\n",
+           call_names[call],
+           calls[call],
+           real_usec[call],
+           bytes[call],
+           bytes[call] / calls[call]);
+  }
+  if (printed_header) {
+    printf("\n");
+  }
+}
+
+enum StopwatchStatus stopwatch_mpi_summary_to_csv(const char *file_name, MPI_Comm comm) {
+  int rank;
+  int num_ranks;
+  PMPI_Comm_rank(comm, &rank);
+  PMPI_Comm_size(comm, &num_ranks);
+
+  struct RankTotals *local_totals = malloc(sizeof(struct RankTotals) * STOPWATCH_MAX_FUNCTION_CALLS);
+  // Ranks that run out of memory still take part so that the others do not wait forever
+  const int local_size = local_totals ? (int) (collect_rank_totals(local_totals, rank) * sizeof(struct RankTotals)) : 0;
+
+  int *sizes = NULL;
+  int *displacements = NULL;
+  struct RankTotals *all_totals = NULL;
+  if (rank == 0) {
+    sizes = malloc(sizeof(int) * num_ranks);
+    displacements = malloc(sizeof(int) * num_ranks);
+  }
+  PMPI_Gather(&local_size, 1, MPI_INT, sizes, 1, MPI_INT, 0, comm);
+  size_t total_size = 0;
+  if (rank == 0) {
+    for (int idx = 0; idx < num_ranks; idx++) {
+      displacements[idx] = (int) total_size;
+      total_size += sizes[idx];
+    }
+    all_totals = malloc(total_size > 0 ? total_size : 1);
+  }
+  PMPI_Gatherv(local_totals, local_size, MPI_BYTE, all_totals, sizes, displacements, MPI_BYTE, 0, comm);
+  free(local_totals);
+
+  enum StopwatchStatus ret_val = STOPWATCH_OK;
+  if (rank == 0) {
+    ret_val = all_totals ? STOPWATCH_OK : STOPWATCH_ERR;
+    FILE *output_file = all_totals ? fopen(file_name, "w+") : NULL;
+    if (all_totals && output_file == NULL) {
+      ret_val = STOPWATCH_INVALID_FILE;
+    }
+    if (output_file) {
+      const size_t num_events = stopwatch_num_events();
+      fprintf(output_file,
+              "%s,%s,%s,%s,%s,%s,%s,%s,%s",
+              "PATH",
+              "RANKS",
+              "TOTAL_CALLS",
+              "TOTAL_BYTES",
+              "MIN_REAL_MICROSECONDS",
+              "AVG_REAL_MICROSECONDS",
+              "MAX_REAL_MICROSECONDS",
+              "IMBALANCE",
+              "SLOWEST_RANK");
+      for (size_t idx = 0; idx < num_events; idx++) {
+        const char *name = stopwatch_event_name(idx);
+        fprintf(output_file, ",MIN_%s,AVG_%s,MAX_%s", name, name, name);
+      }
+      fprintf(output_file, "\n");
+
+      // Totals of the same routine on every rank end up next to each other
+      const size_t num_totals = total_size / sizeof(struct RankTotals);
+      qsort(all_totals, num_totals, sizeof(struct RankTotals), compare_paths);
+      size_t first = 0;
+      for (size_t idx = 1; idx <= num_totals; idx++) {
+        if (idx == num_totals || strcmp(all_totals[idx].path, all_totals[first].path) != 0) {
+          write_summary_row(output_file, &all_totals[first], idx - first, num_events);
+          first = idx;
+        }
+      }
+      fclose(output_file);
+    }
+  }
+  free(all_totals);
+  free(sizes);
+  free(displacements);
+
+  int status = ret_val;
+  PMPI_Bcast(&status, 1, MPI_INT, 0, comm);
+  return (enum StopwatchStatus) status;
+}
+
+// =====================================================================================================================
+// Measured MPI functions
+// =====================================================================================================================
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_SEND);
+  const int ret_val = PMPI_Send(buf, count, datatype, dest, tag, comm);
+  end_call(entry, message_bytes(count, datatype));
+  return ret_val;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+  // The message may be shorter than the buffer, so its length is read from the status even if the caller ignores it
+  MPI_Status own_status;
+  MPI_Status *used_status = status == MPI_STATUS_IGNORE ? &own_status : status;
+  struct RegionEntry *entry = begin_call(MPI_CALL_RECV);
+  const int ret_val = PMPI_Recv(buf, count, datatype, source, tag, comm, used_status);
+  int received = 0;
+  if (ret_val != MPI_SUCCESS || PMPI_Get_count(used_status, datatype, &received) != MPI_SUCCESS ||
+      received == MPI_UNDEFINED) {
+    received = 0;
+  }
+  end_call(entry, message_bytes(received, datatype));
+  return ret_val;
+}
+
+int MPI_Isend(const void *buf,
+              int count,
+              MPI_Datatype datatype,
+              int dest,
+              int tag,
+              MPI_Comm comm,
+              MPI_Request *request) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_ISEND);
+  const int ret_val = PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+  end_call(entry, message_bytes(count, datatype));
+  return ret_val;
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Request *request) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_IRECV);
+  const int ret_val = PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
+  end_call(entry, message_bytes(count, datatype));
+  return ret_val;
+}
+
+int MPI_Sendrecv(const void *sendbuf,
+                 int sendcount,
+                 MPI_Datatype sendtype,
+                 int dest,
+                 int sendtag,
+                 void *recvbuf,
+                 int recvcount,
+                 MPI_Datatype recvtype,
+                 int source,
+                 int recvtag,
+                 MPI_Comm comm,
+                 MPI_Status *status) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_SENDRECV);
+  const int ret_val = PMPI_Sendrecv(sendbuf,
+                                    sendcount,
+                                    sendtype,
+                                    dest,
+                                    sendtag,
+                                    recvbuf,
+                                    recvcount,
+                                    recvtype,
+                                    source,
+                                    recvtag,
+                                    comm,
+                                    status);
+  end_call(entry, message_bytes(sendcount, sendtype));
+  return ret_val;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_WAIT);
+  const int ret_val = PMPI_Wait(request, status);
+  end_call(entry, 0);
+  return ret_val;
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_WAITALL);
+  const int ret_val = PMPI_Waitall(count, array_of_requests, array_of_statuses);
+  end_call(entry, 0);
+  return ret_val;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_BARRIER);
+  const int ret_val = PMPI_Barrier(comm);
+  end_call(entry, 0);
+  return ret_val;
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_BCAST);
+  const int ret_val = PMPI_Bcast(buffer, count, datatype, root, comm);
+  end_call(entry, message_bytes(count, datatype));
+  return ret_val;
+}
+
+int MPI_Reduce(const void *sendbuf,
+               void *recvbuf,
+               int count,
+               MPI_Datatype datatype,
+               MPI_Op op,
+               int root,
+               MPI_Comm comm) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_REDUCE);
+  const int ret_val = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+  end_call(entry, message_bytes(count, datatype));
+  return ret_val;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_ALLREDUCE);
+  const int ret_val = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+  end_call(entry, message_bytes(count, datatype));
+  return ret_val;
+}
+
+int MPI_Gather(const void *sendbuf,
+               int sendcount,
+               MPI_Datatype sendtype,
+               void *recvbuf,
+               int recvcount,
+               MPI_Datatype recvtype,
+               int root,
+               MPI_Comm comm) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_GATHER);
+  const int ret_val = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  end_call(entry, message_bytes(sendcount, sendtype));
+  return ret_val;
+}
+
+int MPI_Scatter(const void *sendbuf,
+                int sendcount,
+                MPI_Datatype sendtype,
+                void *recvbuf,
+                int recvcount,
+                MPI_Datatype recvtype,
+                int root,
+                MPI_Comm comm) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_SCATTER);
+  const int ret_val = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  end_call(entry, message_bytes(recvcount, recvtype));
+  return ret_val;
+}
+
+int MPI_Allgather(const void *sendbuf,
+                  int sendcount,
+                  MPI_Datatype sendtype,
+                  void *recvbuf,
+                  int recvcount,
+                  MPI_Datatype recvtype,
+                  MPI_Comm comm) {
+  struct RegionEntry *entry = begin_call(MPI_CALL_ALLGATHER);
+  const int ret_val = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+  end_call(entry, message_bytes(sendcount, sendtype));
+  return ret_val;
+}
+
+int MPI_Alltoall(const void *sendbuf,
+                 int sendcount,
+                 MPI_Datatype sendtype,
+                 void *recvbuf,
+                 int recvcount,
+                 MPI_Datatype recvtype,
+                 MPI_Comm comm) {
+  // Every rank is sent its own block
+  int num_ranks = 0;
+  PMPI_Comm_size(comm, &num_ranks);
+  struct RegionEntry *entry = begin_call(MPI_CALL_ALLTOALL);
+  const int ret_val = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+  end_call(entry, message_bytes(sendcount, sendtype) * num_ranks);
+  return ret_val;
+}
+
+int MPI_Finalize() {
+  const char *file_name = getenv("STOPWATCH_MPI_SUMMARY");
+  if (file_name == NULL) {
+    file_name = STOPWATCH_MPI_DEFAULT_SUMMARY;
+  }
+  if (file_name[0] != '\0') {
+    stopwatch_mpi_summary_to_csv(file_name, MPI_COMM_WORLD);
+  }
+  return PMPI_Finalize();
+}
+
+// =====================================================================================================================
+// Private helper functions implementation
+// =====================================================================================================================
+
+// Returns the routine measuring `call` in `parent_routine_id`, registering it the first time. Returns NULL if it cannot
+// be registered.
+static struct RegionEntry *find_region(enum MpiCall call, size_t parent_routine_id) {
+  if (cached_entries[call] != NULL && cached_parent_ids[call] == parent_routine_id) {
+    return cached_entries[call];
+  }
+
+  struct RegionEntry *found = NULL;
+  pthread_mutex_lock(&regions_lock);
+  for (size_t entry = 0; entry < num_regions; entry++) {
+    if (regions[entry].call == call && regions[entry].parent_routine_id == parent_routine_id) {
+      found = &regions[entry];
+      break;
+    }
+  }
+  size_t routine_id = 0;
+  if (found == NULL && num_regions < STOPWATCH_MPI_MAX_REGIONS &&
+      stopwatch_register_routine(call_names[call], &routine_id) == STOPWATCH_OK) {
+    found = &regions[num_regions];
+    found->call = call;
+    found->parent_routine_id = parent_routine_id;
+    found->routine_id = routine_id;
+    atomic_init(&found->bytes, 0);
+    num_regions++;
+  }
+  pthread_mutex_unlock(&regions_lock);
+
+  cached_parent_ids[call] = parent_routine_id;
+  cached_entries[call] = found;
+  return found;
+}
+
+// Starts measuring a call nested in the innermost routine measured on this thread
+static struct RegionEntry *begin_call(enum MpiCall call) {
+  const size_t parent_routine_id = stopwatch_current_routine_id();
+  struct RegionEntry *entry = find_region(call, parent_routine_id);
+  if (entry) {
+    stopwatch_record_start_measurements(entry->routine_id, NULL, parent_routine_id);
+  }
+  return entry;
+}
+
+static void end_call(struct RegionEntry *entry, long long bytes) {
+  if (entry) {
+    stopwatch_record_end_measurements(entry->routine_id);
+    atomic_fetch_add_explicit(&entry->bytes, bytes, memory_order_relaxed);
+  }
+}
+
+static long long message_bytes(int count, MPI_Datatype datatype) {
+  int size = 0;
+  if (count <= 0 || PMPI_Type_size(datatype, &size) != MPI_SUCCESS) {
+    return 0;
+  }
+  return (long long) count * size;
+}
+
+// Bytes of the calls measured by a routine, which is 0 for routines that are not MPI functions
+static long long region_bytes(size_t routine_id) {
+  pthread_mutex_lock(&regions_lock);
+  long long bytes = 0;
+  for (size_t entry = 0; entry < num_regions; entry++) {
+    if (regions[entry].routine_id == routine_id) {
+      bytes = atomic_load_explicit(&regions[entry].bytes, memory_order_relaxed);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&regions_lock);
+  return bytes;
+}
+
+// Fills `totals` with the totals of every routine measured on this rank. Returns the number of routines filled in.
+static size_t collect_rank_totals(struct RankTotals *totals, int rank) {
+  size_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  const size_t num_routines = stopwatch_get_routine_ids(routine_ids, STOPWATCH_MAX_FUNCTION_CALLS);
+  size_t num_totals = 0;
+  struct StopwatchMeasurementResult result;
+  for (size_t idx = 0; idx < num_routines; idx++) {
+    const size_t routine_id = routine_ids[idx];
+    if (stopwatch_get_measurement_results(routine_id, &result) != STOPWATCH_OK || result.total_times_called == 0) {
+      continue;
+    }
+    struct RankTotals *routine_totals = &totals[num_totals++];
+    memset(routine_totals, 0, sizeof(struct RankTotals));
+    set_path(routine_totals->path, routine_id);
+    routine_totals->rank = rank;
+    routine_totals->times_called = result.total_times_called;
+    routine_totals->real_usec = result.total_real_usec;
+    routine_totals->bytes = region_bytes(routine_id);
+    memcpy(routine_totals->event_values, result.total_event_values, sizeof(long long) * result.num_of_events);
+  }
+  return num_totals;
+}
+
+// Joins the names of the routine and the routines enclosing it, outermost first. Paths that do not fit are cut short.
+static void set_path(char *path, size_t routine_id) {
+  size_t chain[STOPWATCH_MAX_FUNCTION_CALLS];
+  size_t depth = 0;
+  struct StopwatchMeasurementResult result;
+  // Bounded by the number of routines in case the recorded callers form a cycle
+  for (size_t id = routine_id; id != 0 && depth < STOPWATCH_MAX_FUNCTION_CALLS; depth++) {
+    chain[depth] = id;
+    if (stopwatch_get_measurement_results(id, &result) != STOPWATCH_OK) {
+      depth++;
+      break;
+    }
+    id = result.caller_routine_id;
+  }
+
+  size_t length = 0;
+  path[0] = '\0';
+  while (depth > 0 && length < STOPWATCH_MPI_PATH_LEN - 1) {
+    depth--;
+    stopwatch_get_measurement_results(chain[depth], &result);
+    const int written = snprintf(path + length,
+                                 STOPWATCH_MPI_PATH_LEN - length,
+                                 "%s%s",
+                                 length > 0 ? "/" : "",
+                                 result.routine_name);
+    length += written > 0 ? (size_t) written : 0;
+  }
+}
+
+static int compare_paths(const void *lhs, const void *rhs) {
+  return strcmp(((const struct RankTotals *) lhs)->path, ((const struct RankTotals *) rhs)->path);
+}
+
+// Writes the row of a routine from its totals on each of the ranks that measured it
+static void write_summary_row(FILE *output_file, const struct RankTotals *totals, size_t num_totals, size_t num_events) {
+  long long times_called = 0;
+  long long bytes = 0;
+  long long min_real_usec = totals[0].real_usec;
+  long long max_real_usec = totals[0].real_usec;
+  double sum_real_usec = 0;
+  int slowest_rank = totals[0].rank;
+  long long min_event_values[STOPWATCH_MAX_EVENTS];
+  long long max_event_values[STOPWATCH_MAX_EVENTS];
+  double sum_event_values[STOPWATCH_MAX_EVENTS] = {0};
+  memcpy(min_event_values, totals[0].event_values, sizeof(min_event_values));
+  memcpy(max_event_values, totals[0].event_values, sizeof(max_event_values));
+  for (size_t idx = 0; idx < num_totals; idx++) {
+    const struct RankTotals *rank_totals = &totals[idx];
+    times_called += rank_totals->times_called;
+    bytes += rank_totals->bytes;
+    sum_real_usec += (double) rank_totals->real_usec;
+    if (rank_totals->real_usec < min_real_usec) {
+      min_real_usec = rank_totals->real_usec;
+    }
+    if (rank_totals->real_usec > max_real_usec) {
+      max_real_usec = rank_totals->real_usec;
+      slowest_rank = rank_totals->rank;
+    }
+    for (size_t event = 0; event < num_events; event++) {
+      const long long value = rank_totals->event_values[event];
+      min_event_values[event] = value < min_event_values[event] ? value : min_event_values[event];
+      max_event_values[event] = value > max_event_values[event] ? value : max_event_values[event];
+      sum_event_values[event] += (double) value;
+    }
+  }
+
+  const double avg_real_usec = sum_real_usec / (double) num_totals;
+  const double imbalance = max_real_usec > 0 ? ((double) max_real_usec - avg_real_usec) / (double) max_real_usec : 0;
+  fprintf(output_file,
+          "%s,%zu,%lld,%lld,%lld,%.1f,%lld,%g,%d",
+          totals[0].path,
+          num_totals,
+          times_called,
+          bytes,
+          min_real_usec,
+          avg_real_usec,
+          max_real_usec,
+          imbalance,
+          slowest_rank);
+  for (size_t event = 0; event < num_events; event++) {
+    fprintf(output_file,
+            ",%lld,%.1f,%lld",
+            min_event_values[event],
+            sum_event_values[event] / (double) num_totals,
+            max_event_values[event]);
+  }
+  fprintf(output_file, "\n");
+}
@@ -0,0 +1,428 @@
+// OpenMP tool measuring parallel regions, implicit tasks, worksharing constructs and waits through OMPT callbacks
+#include <omp-tools.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_ompt.h"
+
+// Constructs that can be open at once on a single thread for each kind, i.e. loops of nested parallel regions
+#define MAX_NESTING 16
+
+// Kinds of construct that are measured. Each is a separate routine for every routine it is nested in.
+enum OmptRegion {
+  OMPT_REGION_PARALLEL,
+  OMPT_REGION_THREAD,
+  OMPT_REGION_LOOP,
+  OMPT_REGION_WORKSHARE,
+  OMPT_REGION_BARRIER,
+  OMPT_REGION_TASKWAIT,
+  OMPT_REGION_LOCK_WAIT,
+  NUM_OMPT_REGIONS,
+};
+
+static const char *const region_names[NUM_OMPT_REGIONS] = {
+    "omp parallel",
+    "omp thread",
+    "omp loop",
+    "omp workshare",
+    "omp barrier",
+    "omp taskwait",
+    "omp lock wait",
+};
+
+// Routine measuring a kind of construct nested in a routine
+struct RegionEntry {
+  enum OmptRegion kind;
+  size_t parent_routine_id;
+  size_t routine_id;
+};
+
+// Every routine registered so far. Only appended to while holding `regions_lock`, and entries never change once added.
+static struct RegionEntry regions[STOPWATCH_OMPT_MAX_REGIONS];
+static size_t num_regions = 0;
+static pthread_mutex_t regions_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Last routine looked up for each kind on this thread, so that repeated constructs do not take the lock
+static __thread size_t cached_parent_ids[NUM_OMPT_REGIONS];
+static __thread size_t cached_routine_ids[NUM_OMPT_REGIONS];
+
+// Routines of the constructs currently open on this thread for each kind, innermost last. Parallel regions and implicit
+// tasks keep theirs in the data the runtime hands back instead.
+static __thread size_t open_routine_ids[NUM_OMPT_REGIONS][MAX_NESTING];
+static __thread size_t num_open_routines[NUM_OMPT_REGIONS];
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static int initialize_tool(ompt_function_lookup_t lookup, int initial_device_num, ompt_data_t *tool_data);
+
+static void finalize_tool(ompt_data_t *tool_data);
+
+static void on_parallel_begin(ompt_data_t *encountering_task_data,
+                              const ompt_frame_t *encountering_task_frame,
+                              ompt_data_t *parallel_data,
+                              unsigned int requested_parallelism,
+                              int flags,
+                              const void *codeptr_ra);
+
+static void on_parallel_end(ompt_data_t *parallel_data,
+                            ompt_data_t *encountering_task_data,
+                            int flags,
+                            const void *codeptr_ra);
+
+static void on_implicit_task(ompt_scope_endpoint_t endpoint,
+                             ompt_data_t *parallel_data,
+                             ompt_data_t *task_data,
+                             unsigned int actual_parallelism,
+                             unsigned int index,
+                             int flags);
+
+static void on_work(ompt_work_t wstype,
+                    ompt_scope_endpoint_t endpoint,
+                    ompt_data_t *parallel_data,
+                    ompt_data_t *task_data,
+                    uint64_t count,
+                    const void *codeptr_ra);
+
+static void on_sync_region_wait(ompt_sync_region_t kind,
+                                ompt_scope_endpoint_t endpoint,
+                                ompt_data_t *parallel_data,
+                                ompt_data_t *task_data,
+                                const void *codeptr_ra);
+
+static void on_mutex_acquire(ompt_mutex_t kind,
+                             unsigned int hint,
+                             unsigned int impl,
+                             ompt_wait_id_t wait_id,
+                             const void *codeptr_ra);
+
+static void on_mutex_acquired(ompt_mutex_t kind, ompt_wait_id_t wait_id, const void *codeptr_ra);
+
+static size_t find_region(enum OmptRegion kind, size_t parent_routine_id);
+
+static void begin_region(enum OmptRegion kind);
+
+static void end_region(enum OmptRegion kind);
+
+static const struct RegionEntry *find_entry(size_t routine_id);
+
+// =====================================================================================================================
+// OMPT entry point
+// =====================================================================================================================
+ompt_start_tool_result_t *ompt_start_tool(unsigned int omp_version, const char *runtime_version) {
+  (void) omp_version;
+  (void) runtime_version;
+  static ompt_start_tool_result_t result = {initialize_tool, finalize_tool, {0}};
+  return &result;
+}
+
+// =====================================================================================================================
+// Public interface functions implementations
+// =====================================================================================================================
+void stopwatch_ompt_print_summary() {
+  pthread_mutex_lock(&regions_lock);
+  const size_t num_entries = num_regions;
+  pthread_mutex_unlock(&regions_lock);
+
+  bool printed_header = false;
+  for (size_t parallel = 0; parallel < num_entries; parallel++) {
+    if (regions[parallel].kind != OMPT_REGION_PARALLEL) {
+      continue;
+    }
+
+    // Waits are attributed to the implicit task they happened in by following their callers, as they may be nested in
+    // the routines of the program
+    long long thread_usec = 0;
+    long long waits_usec[NUM_OMPT_REGIONS] = {0};
+    struct StopwatchMeasurementResult result;
+    for (size_t entry = 0; entry < num_entries; entry++) {
+      const enum OmptRegion kind = regions[entry].kind;
+      if (kind == OMPT_REGION_THREAD && regions[entry].parent_routine_id == regions[parallel].routine_id &&
+          stopwatch_get_measurement_results(regions[entry].routine_id, &result) == STOPWATCH_OK) {
+        thread_usec += result.total_real_usec;
+      }
+      if (kind != OMPT_REGION_BARRIER && kind != OMPT_REGION_TASKWAIT && kind != OMPT_REGION_LOCK_WAIT) {
+        continue;
+      }
+      if (stopwatch_get_measurement_results(regions[entry].routine_id, &result) != STOPWATCH_OK) {
+        continue;
+      }
+      const long long wait_usec = result.total_real_usec;
+      // Bounded by the number of routines in case the recorded callers form a cycle
+      for (size_t depth = 0; depth < STOPWATCH_MAX_FUNCTION_CALLS && result.caller_routine_id != 0; depth++) {
+        const struct RegionEntry *caller = find_entry(result.caller_routine_id);
+        if (caller && caller->kind == OMPT_REGION_THREAD) {
+          if (caller->parent_routine_id == regions[parallel].routine_id) {
+            waits_usec[kind] += wait_usec;
+          }
+          break;
+        }
+        if (stopwatch_get_measurement_results(result.caller_routine_id, &result) != STOPWATCH_OK) {
+          break;
+        }
+      }
+    }
+
+    if (stopwatch_get_measurement_results(regions[parallel].routine_id, &result) != STOPWATCH_OK ||
+        result.total_times_called == 0) {
+      continue;
+    }
+    if (!printed_header) {
+      printf("OpenMP parallel regions\n");
+      printf("%5s %-16s %10s %16s %16s %16s %16s %16s %8s\n",
+             "ID",
+             "CALLER",
+             "CALLS",
+             "THREAD USEC",
+             "WORKING USEC",
+             "BARRIER USEC",
+             "TASKWAIT USEC",
+             "LOCK WAIT USEC",
+             "WAITING");
+      printed_header = true;
+    }
+
+    long long waiting_usec =
+        waits_usec[OMPT_REGION_BARRIER] + waits_usec[OMPT_REGION_TASKWAIT] + waits_usec[OMPT_REGION_LOCK_WAIT];
+    // The runtime may end the implicit task of a waiting thread only after its last barrier, so the waits can add up to
+    // slightly more than the time of the threads
+    if (waiting_usec > thread_usec) {
+      waiting_usec = thread_usec;
+    }
+    const size_t caller_id = regions[parallel].parent_routine_id;
+    struct StopwatchMeasurementResult caller;
+    const char *caller_name = "main";
+    if (caller_id != 0 && stopwatch_get_measurement_results(caller_id, &caller) == STOPWATCH_OK) {
+      caller_name = caller.routine_name;
+    }
+    printf("%5zu %-16s %10lld %16lld %16lld %16lld %16lld %16lld %7.1f%%\n",
+           regions[parallel].routine_id,
+           caller_name,
+           result.total_times_called,
+           thread_usec,
+           thread_usec - waiting_usec,
+           waits_usec[OMPT_REGION_BARRIER],
+           waits_usec[OMPT_REGION_TASKWAIT],
+           waits_usec[OMPT_REGION_LOCK_WAIT],
+           thread_usec > 0 ? 100.0 * (double) waiting_usec / (double) thread_usec : 0.0);
+  }
+  if (printed_header) {
+    printf("\n");
+  }
+}
+
+// =====================================================================================================================
+// Private helper functions implementation
+// =====================================================================================================================
+static int initialize_tool(ompt_function_lookup_t lookup, int initial_device_num, ompt_data_t *tool_data) {
+  (void) initial_device_num;
+  (void) tool_data;
+  ompt_set_callback_t set_callback = (ompt_set_callback_t) lookup("ompt_set_callback");
+  if (set_callback == NULL) {
+    return 0;
+  }
+  set_callback(ompt_callback_parallel_begin, (ompt_callback_t) on_parallel_begin);
+  set_callback(ompt_callback_parallel_end, (ompt_callback_t) on_parallel_end);
+  set_callback(ompt_callback_implicit_task, (ompt_callback_t) on_implicit_task);
+  set_callback(ompt_callback_work, (ompt_callback_t) on_work);
+  set_callback(ompt_callback_sync_region_wait, (ompt_callback_t) on_sync_region_wait);
+  set_callback(ompt_callback_mutex_acquire, (ompt_callback_t) on_mutex_acquire);
+  set_callback(ompt_callback_mutex_acquired, (ompt_callback_t) on_mutex_acquired);
+  // Keeps the tool active
+  return 1;
+}
+
+static void finalize_tool(ompt_data_t *tool_data) {
+  (void) tool_data;
+}
+
+static void on_parallel_begin(ompt_data_t *encountering_task_data,
+                              const ompt_frame_t *encountering_task_frame,
+                              ompt_data_t *parallel_data,
+                              unsigned int requested_parallelism,
+                              int flags,
+                              const void *codeptr_ra) {
+  (void) encountering_task_data;
+  (void) encountering_task_frame;
+  (void) requested_parallelism;
+  (void) flags;
+  (void) codeptr_ra;
+  const size_t parent_routine_id = stopwatch_current_routine_id();
+  const size_t routine_id = find_region(OMPT_REGION_PARALLEL, parent_routine_id);
+  // Handed to the implicit tasks, which are nested in the parallel region wherever they run
+  parallel_data->value = routine_id;
+  if (routine_id != 0) {
+    stopwatch_record_start_measurements(routine_id, NULL, parent_routine_id);
+  }
+}
+
+static void on_parallel_end(ompt_data_t *parallel_data,
+                            ompt_data_t *encountering_task_data,
+                            int flags,
+                            const void *codeptr_ra) {
+  (void) encountering_task_data;
+  (void) flags;
+  (void) codeptr_ra;
+  if (parallel_data->value != 0) {
+    stopwatch_record_end_measurements((size_t) parallel_data->value);
+  }
+}
+
+static void on_implicit_task(ompt_scope_endpoint_t endpoint,
+                             ompt_data_t *parallel_data,
+                             ompt_data_t *task_data,
+                             unsigned int actual_parallelism,
+                             unsigned int index,
+                             int flags) {
+  (void) actual_parallelism;
+  (void) index;
+  // The initial task of each thread is the program itself
+  if (flags & ompt_task_initial) {
+    return;
+  }
+
+  if (endpoint == ompt_scope_begin) {
+    const size_t parent_routine_id = parallel_data ? (size_t) parallel_data->value : 0;
+    const size_t routine_id = find_region(OMPT_REGION_THREAD, parent_routine_id);
+    task_data->value = routine_id;
+    if (routine_id != 0) {
+      stopwatch_record_start_measurements(routine_id, NULL, parent_routine_id);
+    }
+  } else if (task_data->value != 0) {
+    // The parallel data is no longer available at the end
+    stopwatch_record_end_measurements((size_t) task_data->value);
+  }
+}
+
+static void on_work(ompt_work_t wstype,
+                    ompt_scope_endpoint_t endpoint,
+                    ompt_data_t *parallel_data,
+                    ompt_data_t *task_data,
+                    uint64_t count,
+                    const void *codeptr_ra) {
+  (void) parallel_data;
+  (void) task_data;
+  (void) count;
+  (void) codeptr_ra;
+  const enum OmptRegion kind = wstype == ompt_work_loop ? OMPT_REGION_LOOP : OMPT_REGION_WORKSHARE;
+  if (endpoint == ompt_scope_begin) {
+    begin_region(kind);
+  } else {
+    end_region(kind);
+  }
+}
+
+static void on_sync_region_wait(ompt_sync_region_t kind,
+                                ompt_scope_endpoint_t endpoint,
+                                ompt_data_t *parallel_data,
+                                ompt_data_t *task_data,
+                                const void *codeptr_ra) {
+  (void) parallel_data;
+  (void) task_data;
+  (void) codeptr_ra;
+  enum OmptRegion region;
+  if (kind == ompt_sync_region_taskwait || kind == ompt_sync_region_taskgroup) {
+    region = OMPT_REGION_TASKWAIT;
+  } else if (kind == ompt_sync_region_reduction) {
+    return;
+  } else {
+    region = OMPT_REGION_BARRIER;
+  }
+  if (endpoint == ompt_scope_begin) {
+    begin_region(region);
+  } else {
+    end_region(region);
+  }
+}
+
+static void on_mutex_acquire(ompt_mutex_t kind,
+                             unsigned int hint,
+                             unsigned int impl,
+                             ompt_wait_id_t wait_id,
+                             const void *codeptr_ra) {
+  (void) hint;
+  (void) impl;
+  (void) wait_id;
+  (void) codeptr_ra;
+  // Atomics and ordered constructs are reported as mutexes as well, but they are part of the work
+  if (kind == ompt_mutex_lock || kind == ompt_mutex_nest_lock || kind == ompt_mutex_critical) {
+    begin_region(OMPT_REGION_LOCK_WAIT);
+  }
+}
+
+static void on_mutex_acquired(ompt_mutex_t kind, ompt_wait_id_t wait_id, const void *codeptr_ra) {
+  (void) wait_id;
+  (void) codeptr_ra;
+  if (kind == ompt_mutex_lock || kind == ompt_mutex_nest_lock || kind == ompt_mutex_critical) {
+    end_region(OMPT_REGION_LOCK_WAIT);
+  }
+}
+
+// Returns the routine measuring `kind` nested in `parent_routine_id`, registering it the first time. Returns 0 if it
+// cannot be registered.
+static size_t find_region(enum OmptRegion kind, size_t parent_routine_id) {
+  if (cached_routine_ids[kind] != 0 && cached_parent_ids[kind] == parent_routine_id) {
+    return cached_routine_ids[kind];
+  }
+
+  size_t routine_id = 0;
+  pthread_mutex_lock(&regions_lock);
+  for (size_t entry = 0; entry < num_regions; entry++) {
+    if (regions[entry].kind == kind && regions[entry].parent_routine_id == parent_routine_id) {
+      routine_id = regions[entry].routine_id;
+      break;
+    }
+  }
+  if (routine_id == 0 && num_regions < STOPWATCH_OMPT_MAX_REGIONS &&
+      stopwatch_register_routine(region_names[kind], &routine_id) == STOPWATCH_OK) {
+    regions[num_regions].kind = kind;
+    regions[num_regions].parent_routine_id = parent_routine_id;
+    regions[num_regions].routine_id = routine_id;
+    num_regions++;
+  }
+  pthread_mutex_unlock(&regions_lock);
+
+  cached_parent_ids[kind] = parent_routine_id;
+  cached_routine_ids[kind] = routine_id;
+  return routine_id;
+}
+
+// Starts measuring a construct nested in the innermost routine measured on this thread
+static void begin_region(enum OmptRegion kind) {
+  const size_t parent_routine_id = stopwatch_current_routine_id();
+  const size_t routine_id = find_region(kind, parent_routine_id);
+  const size_t depth = num_open_routines[kind]++;
+  if (depth >= MAX_NESTING) {
+    return;
+  }
+  open_routine_ids[kind][depth] = routine_id;
+  if (routine_id != 0) {
+    stopwatch_record_start_measurements(routine_id, NULL, parent_routine_id);
+  }
+}
+
+static void end_region(enum OmptRegion kind) {
+  // Constructs that began before the tool started
+  if (num_open_routines[kind] == 0) {
+    return;
+  }
+  const size_t depth = --num_open_routines[kind];
+  if (depth < MAX_NESTING && open_routine_ids[kind][depth] != 0) {
+    stopwatch_record_end_measurements(open_routine_ids[kind][depth]);
+  }
+}
+
+static const struct RegionEntry *find_entry(size_t routine_id) {
+  pthread_mutex_lock(&regions_lock);
+  const struct RegionEntry *found = NULL;
+  for (size_t entry = 0; entry < num_regions; entry++) {
+    if (regions[entry].routine_id == routine_id) {
+      found = &regions[entry];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&regions_lock);
+  return found;
+}
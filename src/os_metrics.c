@@ -0,0 +1,84 @@
+// RUSAGE_THREAD is Linux specific
+#define _GNU_SOURCE
+#include "os_metrics.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+// Codes of the metrics are negative so that they are told apart from the events of the backend in the results. PAPI
+// presets are negative as well, but far below these.
+enum OsMetric {
+  OS_METRIC_MINOR_FAULTS = -1,
+  OS_METRIC_MAJOR_FAULTS = -2,
+  OS_METRIC_VOLUNTARY_SWITCHES = -3,
+  OS_METRIC_INVOLUNTARY_SWITCHES = -4,
+  OS_METRIC_MAX_RSS_GROWTH = -5,
+};
+
+struct OsMetricDescription {
+  enum OsMetric metric;
+  const char *name;
+  const char *description;
+  const char *units;
+};
+
+static const struct OsMetricDescription os_metrics[] = {
+    {OS_METRIC_MINOR_FAULTS, "minor-faults", "Page faults served without I/O", ""},
+    {OS_METRIC_MAJOR_FAULTS, "major-faults", "Page faults that needed I/O", ""},
+    {OS_METRIC_VOLUNTARY_SWITCHES, "voluntary-switches", "Context switches while waiting for a resource", ""},
+    {OS_METRIC_INVOLUNTARY_SWITCHES, "involuntary-switches", "Context switches from being preempted", ""},
+    // The high water mark is kept per process, so growth caused by other threads is included
+    {OS_METRIC_MAX_RSS_GROWTH, "max-rss-growth", "Growth of the largest resident set size of the process", "kilobytes"},
+};
+
+#define NUM_OS_METRICS (sizeof(os_metrics) / sizeof(os_metrics[0]))
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+enum StopwatchStatus find_os_metric(const char *metric_name, struct StopwatchEventInfo *info) {
+  for (size_t idx = 0; idx < NUM_OS_METRICS; idx++) {
+    if (strcmp(os_metrics[idx].name, metric_name) == 0) {
+      memset(info, 0, sizeof(struct StopwatchEventInfo));
+      info->code = os_metrics[idx].metric;
+      strncpy(info->name, os_metrics[idx].name, STOPWATCH_EVENT_NAME_LEN - 1);
+      strncpy(info->description, os_metrics[idx].description, STOPWATCH_EVENT_DESCRIPTION_LEN - 1);
+      strncpy(info->units, os_metrics[idx].units, STOPWATCH_EVENT_UNITS_LEN - 1);
+      strncpy(info->component, "rusage", STOPWATCH_EVENT_COMPONENT_LEN - 1);
+      return STOPWATCH_OK;
+    }
+  }
+  return STOPWATCH_INVALID_EVENT;
+}
+
+const char *os_metric_name(size_t metric_idx) {
+  return metric_idx < NUM_OS_METRICS ? os_metrics[metric_idx].name : NULL;
+}
+
+bool read_os_metrics(const struct StopwatchEventInfo *metrics, size_t num_metrics, long long *values) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+    return false;
+  }
+
+  for (size_t idx = 0; idx < num_metrics; idx++) {
+    switch ((enum OsMetric) metrics[idx].code) {
+      case OS_METRIC_MINOR_FAULTS:
+        values[idx] = usage.ru_minflt;
+        break;
+      case OS_METRIC_MAJOR_FAULTS:
+        values[idx] = usage.ru_majflt;
+        break;
+      case OS_METRIC_VOLUNTARY_SWITCHES:
+        values[idx] = usage.ru_nvcsw;
+        break;
+      case OS_METRIC_INVOLUNTARY_SWITCHES:
+        values[idx] = usage.ru_nivcsw;
+        break;
+      case OS_METRIC_MAX_RSS_GROWTH:
+        values[idx] = usage.ru_maxrss;
+        break;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,21 @@
+#ifndef LIBSTOPWATCH_SRC_OS_METRICS_H_
+#define LIBSTOPWATCH_SRC_OS_METRICS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "stopwatch/stopwatch.h"
+
+// Resource usage the operating system keeps per thread, measured alongside the events of the backend. Each metric is
+// read with getrusage(RUSAGE_THREAD), a system call per start and end measurement, so none are measured by default.
+
+// Describes the metric `metric_name` i.e. `minor-faults`. Returns STOPWATCH_INVALID_EVENT if there is no such metric.
+enum StopwatchStatus find_os_metric(const char *metric_name, struct StopwatchEventInfo *info);
+
+// Name of the metric `metric_idx`, or NULL past the last metric. Used to enable every metric.
+const char *os_metric_name(size_t metric_idx);
+
+// Reads the current values of `metrics` of the calling thread. Returns false if they cannot be read.
+bool read_os_metrics(const struct StopwatchEventInfo *metrics, size_t num_metrics, long long *values);
+
+#endif //LIBSTOPWATCH_SRC_OS_METRICS_H_
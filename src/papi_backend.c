@@ -0,0 +1,133 @@
+#include "backend.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <papi.h>
+
+// Counters of a thread are a PAPI event set, which is bound to the thread that created it
+struct PapiCounters {
+  int event_set;
+};
+
+static const char *const papi_default_events[] = {"PAPI_TOT_CYC", "PAPI_TOT_INS", NULL};
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static bool papi_init();
+
+static void papi_shutdown();
+
+static enum StopwatchStatus papi_find_event(const char *event_name, struct StopwatchEventInfo *info);
+
+static enum StopwatchStatus papi_create_counters(const struct StopwatchEventInfo *events,
+                                                 size_t num_events,
+                                                 void **counters);
+
+static bool papi_read_counters(void *counters, long long *values);
+
+static void papi_destroy_counters(void *counters);
+
+const struct CounterBackend papi_backend = {
+    "papi",
+    papi_default_events,
+    papi_init,
+    papi_shutdown,
+    papi_find_event,
+    papi_create_counters,
+    papi_read_counters,
+    papi_destroy_counters,
+};
+
+// =====================================================================================================================
+// Private helper functions implementations
+// =====================================================================================================================
+static bool papi_init() {
+  if (PAPI_library_init(PAPI_VER_CURRENT) != PAPI_VER_CURRENT) {
+    return false;
+  }
+  // Each thread measures with its own event set so PAPI must be able to tell threads apart
+  return PAPI_thread_init((unsigned long (*)(void)) pthread_self) == PAPI_OK;
+}
+
+static void papi_shutdown() {
+  PAPI_shutdown();
+}
+
+static enum StopwatchStatus papi_find_event(const char *event_name, struct StopwatchEventInfo *info) {
+  int event_code = PAPI_NULL;
+  if (PAPI_event_name_to_code(event_name, &event_code) != PAPI_OK) {
+    return STOPWATCH_INVALID_EVENT;
+  }
+
+  memset(info, 0, sizeof(struct StopwatchEventInfo));
+  info->code = event_code;
+
+  PAPI_event_info_t papi_info;
+  if (PAPI_get_event_info(event_code, &papi_info) != PAPI_OK) {
+    strncpy(info->name, event_name, STOPWATCH_EVENT_NAME_LEN - 1);
+    return STOPWATCH_OK;
+  }
+  // PAPI strings may be longer than the fields, so copy at most one less than their length
+  strncpy(info->name, papi_info.symbol, STOPWATCH_EVENT_NAME_LEN - 1);
+  strncpy(info->description,
+          papi_info.long_descr[0] != '\0' ? papi_info.long_descr : papi_info.short_descr,
+          STOPWATCH_EVENT_DESCRIPTION_LEN - 1);
+  strncpy(info->units, papi_info.units, STOPWATCH_EVENT_UNITS_LEN - 1);
+  const PAPI_component_info_t *component = PAPI_get_component_info(papi_info.component_index);
+  if (component) {
+    strncpy(info->component, component->name, STOPWATCH_EVENT_COMPONENT_LEN - 1);
+  }
+  return STOPWATCH_OK;
+}
+
+static enum StopwatchStatus papi_create_counters(const struct StopwatchEventInfo *events,
+                                                 size_t num_events,
+                                                 void **counters) {
+  struct PapiCounters *papi_counters = malloc(sizeof(struct PapiCounters));
+  if (papi_counters == NULL) {
+    return STOPWATCH_ERR;
+  }
+  papi_counters->event_set = PAPI_NULL;
+  if (PAPI_create_eventset(&papi_counters->event_set) != PAPI_OK) {
+    free(papi_counters);
+    return STOPWATCH_ERR;
+  }
+
+  enum StopwatchStatus ret_val = STOPWATCH_OK;
+  for (size_t idx = 0; ret_val == STOPWATCH_OK && idx < num_events; idx++) {
+    if (PAPI_add_event(papi_counters->event_set, events[idx].code) != PAPI_OK) {
+      ret_val = STOPWATCH_INVALID_EVENT_COMB;
+    }
+  }
+  if (ret_val == STOPWATCH_OK && PAPI_start(papi_counters->event_set) != PAPI_OK) {
+    ret_val = STOPWATCH_ERR;
+  }
+  if (ret_val != STOPWATCH_OK) {
+    papi_destroy_counters(papi_counters);
+    return ret_val;
+  }
+
+  *counters = papi_counters;
+  return STOPWATCH_OK;
+}
+
+static bool papi_read_counters(void *counters, long long *values) {
+  return PAPI_read(((struct PapiCounters *) counters)->event_set, values) == PAPI_OK;
+}
+
+static void papi_destroy_counters(void *counters) {
+  struct PapiCounters *papi_counters = counters;
+  // Regardless if the event set is running or not, calling stop should not produce side effects to state hence
+  // return value is not checked.
+  PAPI_stop(papi_counters->event_set, NULL);
+
+  // Will remove all events from event set if there are any and should do nothing if there is not. Return value is
+  // not checked as its return value does not effect execution
+  PAPI_cleanup_eventset(papi_counters->event_set);
+
+  PAPI_destroy_eventset(&papi_counters->event_set);
+  free(papi_counters);
+}
@@ -0,0 +1,199 @@
+#include "backend.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Event that can be opened through perf_event_open. The event code handed out is the index into `perf_events`.
+struct PerfEvent {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+  const char *description;
+  const char *units;
+};
+
+// Named the same as by the perf tool
+static const struct PerfEvent perf_events[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "Total cycles", ""},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "Instructions retired", ""},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, "Last level cache accesses", ""},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "Last level cache misses", ""},
+    {"branch-instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, "Branch instructions retired", ""},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "Mispredicted branch instructions", ""},
+    {"bus-cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES, "Bus cycles", ""},
+    {"ref-cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES, "Cycles not affected by frequency scaling", ""},
+    {"stalled-cycles-frontend",
+     PERF_TYPE_HARDWARE,
+     PERF_COUNT_HW_STALLED_CYCLES_FRONTEND,
+     "Cycles stalled issuing instructions",
+     ""},
+    {"stalled-cycles-backend",
+     PERF_TYPE_HARDWARE,
+     PERF_COUNT_HW_STALLED_CYCLES_BACKEND,
+     "Cycles stalled retiring instructions",
+     ""},
+    {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "Time the thread was running", "nanoseconds"},
+    {"cpu-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK, "Time of the CPU clock", "nanoseconds"},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "Page faults", ""},
+    {"minor-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN, "Page faults served without I/O", ""},
+    {"major-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ, "Page faults that needed I/O", ""},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "Context switches", ""},
+    {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "Migrations to another CPU", ""},
+    {"alignment-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_ALIGNMENT_FAULTS, "Unaligned accesses fixed up", ""},
+    {"emulation-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_EMULATION_FAULTS, "Instructions emulated", ""},
+};
+
+#define NUM_PERF_EVENTS (sizeof(perf_events) / sizeof(perf_events[0]))
+
+// Counters of a thread are a single group, so every event is read with one system call on the leader
+struct PerfEventCounters {
+  size_t num_events;
+  int fds[STOPWATCH_MAX_EVENTS];  // The leader is the first
+};
+
+// Layout of a read of a group with PERF_FORMAT_GROUP
+struct PerfEventGroupRead {
+  uint64_t num_events;
+  uint64_t values[STOPWATCH_MAX_EVENTS];
+};
+
+static const char *const perf_event_default_events[] = {"cycles", "instructions", NULL};
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static bool perf_event_init();
+
+static void perf_event_shutdown();
+
+static enum StopwatchStatus perf_event_find_event(const char *event_name, struct StopwatchEventInfo *info);
+
+static enum StopwatchStatus perf_event_create_counters(const struct StopwatchEventInfo *events,
+                                                       size_t num_events,
+                                                       void **counters);
+
+static bool perf_event_read_counters(void *counters, long long *values);
+
+static void perf_event_destroy_counters(void *counters);
+
+// Opens `event` on the calling thread as part of the group of `group_fd`, or as a new group if it is -1
+static int open_event(const struct PerfEvent *event, int group_fd);
+
+const struct CounterBackend perf_event_backend = {
+    "perf_event",
+    perf_event_default_events,
+    perf_event_init,
+    perf_event_shutdown,
+    perf_event_find_event,
+    perf_event_create_counters,
+    perf_event_read_counters,
+    perf_event_destroy_counters,
+};
+
+// =====================================================================================================================
+// Private helper functions implementations
+// =====================================================================================================================
+static bool perf_event_init() {
+  return true;
+}
+
+static void perf_event_shutdown() {
+}
+
+static enum StopwatchStatus perf_event_find_event(const char *event_name, struct StopwatchEventInfo *info) {
+  for (size_t idx = 0; idx < NUM_PERF_EVENTS; idx++) {
+    if (strcmp(perf_events[idx].name, event_name) == 0) {
+      memset(info, 0, sizeof(struct StopwatchEventInfo));
+      info->code = (int) idx;
+      strncpy(info->name, perf_events[idx].name, STOPWATCH_EVENT_NAME_LEN - 1);
+      strncpy(info->description, perf_events[idx].description, STOPWATCH_EVENT_DESCRIPTION_LEN - 1);
+      strncpy(info->units, perf_events[idx].units, STOPWATCH_EVENT_UNITS_LEN - 1);
+      strncpy(info->component, "perf_event", STOPWATCH_EVENT_COMPONENT_LEN - 1);
+      return STOPWATCH_OK;
+    }
+  }
+  return STOPWATCH_INVALID_EVENT;
+}
+
+static enum StopwatchStatus perf_event_create_counters(const struct StopwatchEventInfo *events,
+                                                       size_t num_events,
+                                                       void **counters) {
+  struct PerfEventCounters *perf_counters = calloc(1, sizeof(struct PerfEventCounters));
+  if (perf_counters == NULL) {
+    return STOPWATCH_ERR;
+  }
+
+  for (size_t idx = 0; idx < num_events; idx++) {
+    const int group_fd = idx == 0 ? -1 : perf_counters->fds[0];
+    const int fd = open_event(&perf_events[events[idx].code], group_fd);
+    if (fd < 0) {
+      perf_event_destroy_counters(perf_counters);
+      return STOPWATCH_INVALID_EVENT_COMB;
+    }
+    perf_counters->fds[perf_counters->num_events++] = fd;
+  }
+
+  // Members follow their leader, so the whole group starts counting at once
+  if (num_events > 0 && ioctl(perf_counters->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+    perf_event_destroy_counters(perf_counters);
+    return STOPWATCH_ERR;
+  }
+
+  *counters = perf_counters;
+  return STOPWATCH_OK;
+}
+
+static bool perf_event_read_counters(void *counters, long long *values) {
+  const struct PerfEventCounters *perf_counters = counters;
+  if (perf_counters->num_events == 0) {
+    return true;
+  }
+
+  struct PerfEventGroupRead group_read;
+  // Bypasses `read` so that the stopwatch_io libraries do not count reading the counters as I/O of the routine
+  const ssize_t size = syscall(SYS_read, perf_counters->fds[0], &group_read, sizeof(group_read));
+  if (size < (ssize_t) sizeof(uint64_t) || group_read.num_events != perf_counters->num_events) {
+    return false;
+  }
+  for (size_t idx = 0; idx < perf_counters->num_events; idx++) {
+    values[idx] = (long long) group_read.values[idx];
+  }
+  return true;
+}
+
+static void perf_event_destroy_counters(void *counters) {
+  struct PerfEventCounters *perf_counters = counters;
+  // Members are closed before their leader
+  for (size_t idx = perf_counters->num_events; idx > 0; idx--) {
+    close(perf_counters->fds[idx - 1]);
+  }
+  free(perf_counters);
+}
+
+static int open_event(const struct PerfEvent *event, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event->type;
+  attr.config = event->config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  // Only the leader is enabled explicitly once the whole group is open
+  attr.disabled = group_fd == -1;
+  attr.exclude_hv = 1;
+  // Software events such as context switches happen in the kernel on behalf of the thread, so they are counted there as
+  // well if allowed. Hardware events only count user code, the same as the default PAPI domain.
+  attr.exclude_kernel = event->type == PERF_TYPE_HARDWARE;
+
+  int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+  if (fd < 0 && (errno == EACCES || errno == EPERM) && !attr.exclude_kernel) {
+    attr.exclude_kernel = 1;
+    fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+  }
+  return fd;
+}
@@ -0,0 +1,132 @@
+#include "series.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_VARINT_LEN 10 // 64 bits in groups of 7 bits
+
+// =====================================================================================================================
+// Private helper methods definitions
+// =====================================================================================================================
+static uint64_t zigzag_encode(long long value);
+
+static long long zigzag_decode(uint64_t value);
+
+// Writes `value` into `dest` 7 bits at a time, least significant first. Returns the number of bytes written.
+static size_t write_varint(unsigned char *dest, uint64_t value);
+
+// Reads a value written by `write_varint`. Returns the number of bytes read.
+static size_t read_varint(const unsigned char *src, uint64_t *value);
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+struct Series *create_series(size_t capacity, size_t decimation, size_t num_values) {
+  if (num_values > SERIES_MAX_VALUES || decimation == 0) {
+    return NULL;
+  }
+
+  struct Series *series = calloc(1, sizeof(struct Series));
+  if (series == NULL) {
+    return NULL;
+  }
+  series->buffer = malloc(capacity);
+  if (series->buffer == NULL && capacity > 0) {
+    free(series);
+    return NULL;
+  }
+  series->capacity = capacity;
+  series->num_values = num_values;
+  series->decimation = decimation;
+  return series;
+}
+
+void destroy_series(struct Series *series) {
+  if (series) {
+    free(series->buffer);
+    free(series);
+  }
+}
+
+void series_record(struct Series *series, const long long *values) {
+  const long long invocation = series->num_invocations++;
+  if (invocation % (long long) series->decimation != 0) {
+    return;
+  }
+
+  // Encoded separately first so that a sample is either stored whole or dropped
+  unsigned char encoded[SERIES_MAX_VALUES * MAX_VARINT_LEN];
+  size_t encoded_len = 0;
+  for (size_t idx = 0; idx < series->num_values; idx++) {
+    // Differences are taken as unsigned to wrap around instead of overflowing
+    const long long delta = (long long) ((uint64_t) values[idx] - (uint64_t) series->last_values[idx]);
+    encoded_len += write_varint(encoded + encoded_len, zigzag_encode(delta));
+  }
+
+  if (series->capacity - series->size < encoded_len) {
+    series->num_dropped++;
+    return;
+  }
+  memcpy(series->buffer + series->size, encoded, encoded_len);
+  series->size += encoded_len;
+  memcpy(series->last_values, values, sizeof(long long) * series->num_values);
+  series->num_samples++;
+}
+
+long long series_sample_invocation(const struct Series *series, size_t sample) {
+  return (long long) (sample * series->decimation) + 1;
+}
+
+void series_iter_init(struct SeriesIter *iter, const struct Series *series) {
+  memset(iter, 0, sizeof(struct SeriesIter));
+  iter->series = series;
+}
+
+bool series_iter_has_next(const struct SeriesIter *iter) {
+  return iter->sample < iter->series->num_samples;
+}
+
+const long long *series_iter_next(struct SeriesIter *iter) {
+  for (size_t idx = 0; idx < iter->series->num_values; idx++) {
+    uint64_t encoded;
+    iter->offset += read_varint(iter->series->buffer + iter->offset, &encoded);
+    iter->values[idx] = (long long) ((uint64_t) iter->values[idx] + (uint64_t) zigzag_decode(encoded));
+  }
+  iter->sample++;
+  return iter->values;
+}
+
+// =====================================================================================================================
+// Private helper methods implementations
+// =====================================================================================================================
+static uint64_t zigzag_encode(long long value) {
+  // Maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ... so that small negative values also take few bytes
+  return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static long long zigzag_decode(uint64_t value) {
+  return (long long) ((value >> 1) ^ (~(value & 1) + 1));
+}
+
+static size_t write_varint(unsigned char *dest, uint64_t value) {
+  size_t len = 0;
+  while (value >= 0x80) {
+    dest[len++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  dest[len++] = (unsigned char) value;
+  return len;
+}
+
+static size_t read_varint(const unsigned char *src, uint64_t *value) {
+  size_t len = 0;
+  unsigned int shift = 0;
+  *value = 0;
+  while (src[len] & 0x80) {
+    *value |= (uint64_t) (src[len++] & 0x7f) << shift;
+    shift += 7;
+  }
+  *value |= (uint64_t) src[len++] << shift;
+  return len;
+}
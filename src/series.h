@@ -0,0 +1,52 @@
+#ifndef LIBSTOPWATCH_SRC_SERIES_H_
+#define LIBSTOPWATCH_SRC_SERIES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "stopwatch/stopwatch.h"
+
+#define SERIES_MAX_VALUES (STOPWATCH_MAX_EVENTS + 1) // Real microseconds followed by each event
+
+// Values of every recorded invocation of a routine on a single thread. Each value is stored as the zigzag encoded
+// difference to the same value of the previous sample, written as a variable length integer, so the small differences
+// between similar invocations mostly take a single byte. The buffer never grows. Samples that do not fit are dropped.
+struct Series {
+  unsigned char *buffer;
+  size_t capacity;                          // Size of `buffer` in bytes
+  size_t size;                              // Number of bytes of `buffer` in use
+  size_t num_values;                        // Number of values in each sample
+  size_t decimation;                        // Only every `decimation`th invocation is recorded, starting with the first
+  long long num_invocations;                // Number of invocations seen, including those not recorded
+  size_t num_samples;                       // Number of samples in `buffer`
+  long long num_dropped;                    // Number of samples that did not fit in `buffer`
+  long long last_values[SERIES_MAX_VALUES]; // Values of the last sample in `buffer`
+};
+
+// Sequential decoder of the samples of a series. Is non-owning of the series.
+struct SeriesIter {
+  const struct Series *series;
+  size_t offset;                       // Offset in bytes of the next sample
+  size_t sample;                       // Index of the next sample
+  long long values[SERIES_MAX_VALUES]; // Values of the last decoded sample
+};
+
+// Returns NULL if `num_values` is greater than SERIES_MAX_VALUES, `decimation` is 0 or the buffer cannot be allocated
+struct Series *create_series(size_t capacity, size_t decimation, size_t num_values);
+
+void destroy_series(struct Series *series);
+
+// Counts an invocation and records its `num_values` values if it is not skipped by the decimation
+void series_record(struct Series *series, const long long *values);
+
+// Invocation number of a sample where the first invocation is 1
+long long series_sample_invocation(const struct Series *series, size_t sample);
+
+void series_iter_init(struct SeriesIter *iter, const struct Series *series);
+
+bool series_iter_has_next(const struct SeriesIter *iter);
+
+// Decodes the next sample. The returned values are owned by the iterator and are overwritten by the next call.
+const long long *series_iter_next(struct SeriesIter *iter);
+
+#endif //LIBSTOPWATCH_SRC_SERIES_H_
@@ -0,0 +1,102 @@
+#include "shm.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// =====================================================================================================================
+// Private helper methods definitions
+// =====================================================================================================================
+
+// Makes the sequence odd before its data is modified. Only one writer may modify the data at a time.
+static void begin_write(uint64_t *sequence);
+
+// Makes the sequence even again once its data is modified
+static void end_write(uint64_t *sequence);
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+struct StopwatchShmSegment *create_shm_segment(const char *name) {
+  // Readers only need to read the segment
+  const int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (ftruncate(fd, sizeof(struct StopwatchShmSegment)) != 0) {
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+  struct StopwatchShmSegment *segment =
+      mmap(NULL, sizeof(struct StopwatchShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+  if (segment == MAP_FAILED) {
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // Freshly truncated so every other field is already zero
+  segment->version = STOPWATCH_SHM_VERSION;
+  segment->size = sizeof(struct StopwatchShmSegment);
+  segment->pid = getpid();
+  // Written last so that readers checking the magic see a complete header
+  __atomic_store_n(&segment->magic, STOPWATCH_SHM_MAGIC, __ATOMIC_RELEASE);
+  return segment;
+}
+
+void destroy_shm_segment(struct StopwatchShmSegment *segment, const char *name) {
+  munmap(segment, sizeof(struct StopwatchShmSegment));
+  shm_unlink(name);
+}
+
+struct StopwatchShmThread *shm_segment_add_thread(struct StopwatchShmSegment *segment) {
+  const uint64_t num_threads = __atomic_load_n(&segment->num_threads, __ATOMIC_RELAXED);
+  if (num_threads >= STOPWATCH_SHM_MAX_THREADS) {
+    return NULL;
+  }
+  __atomic_store_n(&segment->num_threads, num_threads + 1, __ATOMIC_RELEASE);
+  return &segment->threads[num_threads];
+}
+
+void shm_segment_set_routine(struct StopwatchShmSegment *segment,
+                             size_t entry,
+                             size_t routine_id,
+                             const char *routine_name,
+                             size_t caller_routine_id) {
+  begin_write(&segment->routines_sequence);
+  segment->routine_ids[entry] = routine_id;
+  strncpy(segment->routine_names[entry], routine_name, NULL_TERM_MAX_ROUTINE_NAME_LEN);
+  segment->routine_names[entry][NULL_TERM_MAX_ROUTINE_NAME_LEN - 1] = '\0';
+  segment->caller_routine_ids[entry] = caller_routine_id;
+  end_write(&segment->routines_sequence);
+}
+
+void shm_thread_set_routine(struct StopwatchShmThread *thread,
+                            size_t entry,
+                            const struct StopwatchShmRoutine *totals) {
+  begin_write(&thread->sequence);
+  thread->routines[entry] = *totals;
+  end_write(&thread->sequence);
+}
+
+void shm_thread_clear(struct StopwatchShmThread *thread) {
+  begin_write(&thread->sequence);
+  memset(thread->routines, 0, sizeof(thread->routines));
+  end_write(&thread->sequence);
+}
+
+// =====================================================================================================================
+// Private helper methods implementations
+// =====================================================================================================================
+static void begin_write(uint64_t *sequence) {
+  __atomic_store_n(sequence, __atomic_load_n(sequence, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+  // Keeps the data stores from being reordered before the sequence becomes odd
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void end_write(uint64_t *sequence) {
+  __atomic_store_n(sequence, __atomic_load_n(sequence, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+}
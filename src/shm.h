@@ -0,0 +1,32 @@
+#ifndef LIBSTOPWATCH_SRC_SHM_H_
+#define LIBSTOPWATCH_SRC_SHM_H_
+
+#include <stddef.h>
+
+#include "stopwatch/stopwatch_shm.h"
+
+// Creates, or replaces, the shared memory segment `name` and maps it. Returns NULL if it cannot be created.
+struct StopwatchShmSegment *create_shm_segment(const char *name);
+
+// Unmaps and unlinks the segment. Processes that still have it mapped keep their mapping.
+void destroy_shm_segment(struct StopwatchShmSegment *segment, const char *name);
+
+// Hands out the next unused thread of the segment. Returns NULL if all are in use. Not thread safe.
+struct StopwatchShmThread *shm_segment_add_thread(struct StopwatchShmSegment *segment);
+
+// Updates the ID, name and caller of the routine at `entry`. Not thread safe.
+void shm_segment_set_routine(struct StopwatchShmSegment *segment,
+                             size_t entry,
+                             size_t routine_id,
+                             const char *routine_name,
+                             size_t caller_routine_id);
+
+// Updates the totals of the routine at `entry`. Must only be called by the thread owning `thread`.
+void shm_thread_set_routine(struct StopwatchShmThread *thread,
+                            size_t entry,
+                            const struct StopwatchShmRoutine *totals);
+
+// Clears the totals of every routine. Must only be called by the thread owning `thread` or while it is not measuring.
+void shm_thread_clear(struct StopwatchShmThread *thread);
+
+#endif //LIBSTOPWATCH_SRC_SHM_H_
@@ -0,0 +1,107 @@
+#include "slowest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// =====================================================================================================================
+// Private helper functions definitions
+// =====================================================================================================================
+static void sift_down(struct SlowestInvocations *slowest, size_t idx);
+
+static void sift_up(struct SlowestInvocations *slowest, size_t idx);
+
+static void swap_invocations(struct StopwatchInvocation *lhs, struct StopwatchInvocation *rhs);
+
+static int compare_slowest_first(const void *lhs, const void *rhs);
+
+// =====================================================================================================================
+// Public functions implementations
+// =====================================================================================================================
+struct SlowestInvocations *create_slowest(size_t capacity) {
+  if (capacity == 0) {
+    return NULL;
+  }
+  struct SlowestInvocations *slowest =
+      malloc(sizeof(struct SlowestInvocations) + sizeof(struct StopwatchInvocation) * capacity);
+  if (slowest == NULL) {
+    return NULL;
+  }
+  slowest->capacity = capacity;
+  slowest->size = 0;
+  return slowest;
+}
+
+void destroy_slowest(struct SlowestInvocations *slowest) {
+  free(slowest);
+}
+
+void slowest_record(struct SlowestInvocations *slowest, const struct StopwatchInvocation *invocation) {
+  if (!slowest_qualifies(slowest, invocation->real_usec)) {
+    return;
+  }
+  if (slowest->size < slowest->capacity) {
+    slowest->invocations[slowest->size] = *invocation;
+    sift_up(slowest, slowest->size);
+    slowest->size++;
+  } else {
+    slowest->invocations[0] = *invocation;
+    sift_down(slowest, 0);
+  }
+}
+
+size_t slowest_sorted(const struct SlowestInvocations *slowest, struct StopwatchInvocation *invocations) {
+  memcpy(invocations, slowest->invocations, sizeof(struct StopwatchInvocation) * slowest->size);
+  qsort(invocations, slowest->size, sizeof(struct StopwatchInvocation), compare_slowest_first);
+  return slowest->size;
+}
+
+// =====================================================================================================================
+// Private helper functions implementations
+// =====================================================================================================================
+static void sift_down(struct SlowestInvocations *slowest, size_t idx) {
+  while (true) {
+    const size_t left = 2 * idx + 1;
+    const size_t right = left + 1;
+    size_t smallest = idx;
+    if (left < slowest->size && slowest->invocations[left].real_usec < slowest->invocations[smallest].real_usec) {
+      smallest = left;
+    }
+    if (right < slowest->size && slowest->invocations[right].real_usec < slowest->invocations[smallest].real_usec) {
+      smallest = right;
+    }
+    if (smallest == idx) {
+      return;
+    }
+    swap_invocations(&slowest->invocations[idx], &slowest->invocations[smallest]);
+    idx = smallest;
+  }
+}
+
+static void sift_up(struct SlowestInvocations *slowest, size_t idx) {
+  while (idx > 0) {
+    const size_t parent = (idx - 1) / 2;
+    if (slowest->invocations[parent].real_usec <= slowest->invocations[idx].real_usec) {
+      return;
+    }
+    swap_invocations(&slowest->invocations[idx], &slowest->invocations[parent]);
+    idx = parent;
+  }
+}
+
+static void swap_invocations(struct StopwatchInvocation *lhs, struct StopwatchInvocation *rhs) {
+  const struct StopwatchInvocation tmp = *lhs;
+  *lhs = *rhs;
+  *rhs = tmp;
+}
+
+// Ties are ordered by start so that the output does not depend on the order of the heap
+static int compare_slowest_first(const void *lhs, const void *rhs) {
+  const struct StopwatchInvocation *lhs_invocation = lhs;
+  const struct StopwatchInvocation *rhs_invocation = rhs;
+  if (lhs_invocation->real_usec != rhs_invocation->real_usec) {
+    return lhs_invocation->real_usec < rhs_invocation->real_usec ? 1 : -1;
+  }
+  const long long lhs_start = lhs_invocation->start_usec;
+  const long long rhs_start = rhs_invocation->start_usec;
+  return (lhs_start > rhs_start) - (lhs_start < rhs_start);
+}
@@ -0,0 +1,33 @@
+#ifndef LIBSTOPWATCH_SRC_SLOWEST_H_
+#define LIBSTOPWATCH_SRC_SLOWEST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "stopwatch/stopwatch.h"
+
+// The slowest invocations of a routine seen so far, kept as a min-heap on the real microseconds so that the fastest of
+// them is always first. An invocation that is not slower than it is rejected with a single comparison.
+struct SlowestInvocations {
+  size_t capacity;
+  size_t size;
+  struct StopwatchInvocation invocations[];
+};
+
+// Returns NULL if `capacity` is 0 or the heap cannot be allocated
+struct SlowestInvocations *create_slowest(size_t capacity);
+
+void destroy_slowest(struct SlowestInvocations *slowest);
+
+// Whether an invocation of `real_usec` would be kept
+static inline bool slowest_qualifies(const struct SlowestInvocations *slowest, long long real_usec) {
+  return slowest->size < slowest->capacity || real_usec > slowest->invocations[0].real_usec;
+}
+
+// Keeps `invocation` if it qualifies, replacing the fastest invocation kept when full
+void slowest_record(struct SlowestInvocations *slowest, const struct StopwatchInvocation *invocation);
+
+// Copies the invocations kept into `invocations`, slowest first. Returns the number of invocations copied.
+size_t slowest_sorted(const struct SlowestInvocations *slowest, struct StopwatchInvocation *invocations);
+
+#endif //LIBSTOPWATCH_SRC_SLOWEST_H_
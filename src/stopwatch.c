@@ -1,246 +1,1366 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "stopwatch/stopwatch.h"
 #include "str_table.h"
 #include "call_tree.h"
-#include <papi.h>
+#include "series.h"
+#include "slowest.h"
+#include "shm.h"
+#include "dump.h"
+#include "backend.h"
+#include "os_metrics.h"
+#include "alloc_metrics.h"
+#include "io_metrics.h"
+#include "id_map.h"
+#include "accumulate.h"
+
+// Defined by the stopwatch_ompt and stopwatch_mpi libraries if they are linked
+extern void stopwatch_ompt_print_summary() __attribute__((weak));
+extern void stopwatch_mpi_print_summary() __attribute__((weak));
 
 #define INDENT_SPACING 4
-#define STOPWATCH_MAX_FUNCTION_CALLS 500  // Maximum number of measurement entries
+#define STOPWATCH_MAX_STACK_DEPTH 128  // Maximum nesting depth of routines tracked per thread
+#define STOPWATCH_DUMP_SIGNAL SIGUSR1  // Signal that dumps the totals to `STOPWATCH_DUMP_FILE`
+#define CALIBRATION_PAIRS 64           // Start and end measurement pairs timed to calibrate their overhead
+#define CALIBRATION_ROUNDS 8           // Rounds of pairs timed, of which the fastest is kept
+#define AUTO_SAMPLING_WARMUP 64        // Invocations measured before an automatic sampling interval is chosen
+#define AUTO_SAMPLING_MAX_OVERHEAD 0.01 // Fraction of the real time of a routine that measuring may add when sampled
+#define THROTTLE_WINDOW 64             // Invocations of a routine on a thread between estimates of its overhead
+#define MAX_THROTTLE_DECISIONS (3 * STOPWATCH_MAX_FUNCTION_CALLS) // Each routine is throttled at most three times
+#define CACHE_LINE_SIZE 64             // Alignment of the readings, so that each starts on a line of its own
+
+// Values that the end measurement of a routine on a thread needs from its start. Read and written by every start and
+// end measurement, so they are kept apart from the totals and start on a cache line of their own, with the events last
+// so that a start reading up to 4 events touches a single line.
+struct __attribute__((aligned(CACHE_LINE_SIZE))) StartReadings {
+  // Set between a start and an end measurement. End measurements of routines that were not started i.e. filtered out
+  // or started while paused, are ignored.
+  bool measuring;
+  // Whether the current invocation is measured rather than only counted. Only meaningful while `measuring`
+  bool sampled;
+  // Invocations started again while the routine was already being measured on this thread i.e. by recursion, that have
+  // not ended yet. Their time and events are part of the outermost invocation, which alone keeps start values.
+  unsigned int recursion_depth;
+  // Invocations left to skip before the next one that is measured if the routine is sampled
+  size_t sampling_countdown;
+  // Start values of real microseconds
+  long long start_real_us;
+  // Peak live heap bytes of the thread before the routine started. Restored when it ends, as starting lowers the peak
+  // to measure the growth within the routine, so that enclosing routines keep their peak.
+  long long start_peak_live_bytes;
+  // Start measurements of each event. Each index corresponds to one event
+  long long start_events_measurements[STOPWATCH_MAX_EVENTS];
+};
 
-// Structure used to hold readings for the measurement clock.
-struct MeasurementReadings {
-  // Name of the routine being measured
-  char routine_name[NULL_TERM_MAX_ROUTINE_NAME_LEN];
+// Totals of a routine on a thread, also used for the totals of snapshots. The totals every measured end measurement
+// updates come first so that they share the first cache line with the sums of the first block of up to 4 events. The
+// minimums and maximums of the block take the second line and its sums of squares the third, so an end measurement of
+// up to 4 events writes 3 lines. The 16 statistics of 4 events take 128 bytes, so they cannot fit in fewer.
+struct __attribute__((aligned(CACHE_LINE_SIZE))) MeasurementReadings {
   // Number of times the routine has been called
   long long total_times_called;
-  // ID of the procedure that called the current measured procedure
-  size_t caller_routine_id;
-  // Accumulated measurements of each event. Each index corresponds to one event
-  long long total_events_measurements[STOPWATCH_MAX_EVENTS];
-  // Start measurements of each event. Each index corresponds to one event
-  long long start_events_measurements[STOPWATCH_MAX_EVENTS];
+  // Number of invocations whose real time and events were measured, which is every invocation unless the routine is
+  // sampled. The totals are scaled up to all invocations when reported.
+  long long sampled_times_called;
   // Accumulated values of total real microseconds elapsed
   long long total_real_us;
-  // Start values of real microseconds
-  long long start_real_us;
+  // Sum of the squared real microseconds of the measured invocations, for the confidence of the scaled totals
+  double sum_squared_real_us;
+  // Accumulated measurements of each event over the invocations whose events were measured, which excludes migrated
+  // ones. Each index corresponds to one event
+  struct EventTotals events;
+  // Asynchronous invocations that ended on this thread after starting on another, whose events were not measured
+  long long migrated_times_called;
+  // Accumulated units of work added through `stopwatch_add_work`. Each index corresponds to one work counter
+  long long total_work[STOPWATCH_MAX_WORK_COUNTERS];
+};
+_Static_assert(offsetof(struct MeasurementReadings, events) + sizeof(struct EventTotalsBlock) <= 3 * CACHE_LINE_SIZE,
+               "the totals of an end measurement of up to 4 events must take 3 cache lines");
+
+// State of a routine on a thread that measurements rarely touch
+struct ReadingsMetadata {
+  // Interval chosen for this thread if the routine is sampled automatically, or 0 while it is still being chosen
+  size_t auto_sampling_interval;
+  // Values of each invocation if a series is kept for the routine. Created by the first end measurement on the thread
+  struct Series *series;
+  // Slowest invocations of the routine on the thread if they are kept. Created by the first end measurement on the
+  // thread
+  struct SlowestInvocations *slowest;
+};
+
+// Whether a routine is measured. Decided the first time the routine is measured.
+enum RoutineState {
+  ROUTINE_UNRECORDED,
+  ROUTINE_MEASURED,
+  ROUTINE_FILTERED, // Excluded by the filters of the environment
+  ROUTINE_THROTTLED, // Switched off by the overhead budget
+};
+
+// Information about a routine that is shared between all threads. Only written the first time the routine is measured
+// or when it is registered.
+struct RoutineInfo {
+  // Name of the routine being measured
+  char routine_name[NULL_TERM_MAX_ROUTINE_NAME_LEN];
+  // ID of the procedure that called the current measured procedure
+  size_t caller_routine_id;
+  // Nesting depth of the routine where routines called by main have a depth of 1
+  size_t depth;
+  // Holds an `enum RoutineState`. Read without holding the lock on every start measurement
+  atomic_uchar state;
+  // Registered routines keep their name across re-initialization as they are registered once per process
+  bool registered;
+  // Buffer size in bytes and decimation of the series kept for the routine on each thread. No series is kept if the
+  // decimation is 0.
+  size_t series_size;
+  size_t series_decimation;
+  // Whether only some invocations of the routine are measured, and every how many. The interval is chosen on each
+  // thread from the measured overhead if it is 0.
+  bool sampled;
+  size_t sampling_interval;
+  // Holds an `enum StopwatchThrottling` set by the overhead budget. Read without holding the lock on every start
+  // measurement, after which `throttled_interval` is valid.
+  atomic_uchar throttling;
+  // Invocations per measured invocation while the overhead budget samples the routine, otherwise 0
+  size_t throttled_interval;
+};
+
+// Measurement state of a single thread. Counters are bound to the thread that created them, so each thread that
+// records a measurement gets its own counters and its own copy of the readings. Totals are summed over all threads
+// when results are reported. Allocated on a cache line boundary and padded to a whole number of lines, so the state of
+// one thread never shares a line with another's.
+struct ThreadMeasurements {
+  // Counters of the events created by this thread through the backend
+  void *counters;
+  // Allocations of this thread if allocation metrics are measured, otherwise NULL
+  struct StopwatchAllocCounters *alloc_counters;
+  // I/O of this thread if I/O metrics are measured, otherwise NULL
+  struct StopwatchIoCounters *io_counters;
+  // Holds the intermediate results from the backend. Mainly used as an intermediate to accumulate measurements. PAPI
+  // itself does have an accumulation feature but it resets the timers which is undesirable when it comes to nesting
+  // measurements.
+  long long tmp_event_results[STOPWATCH_MAX_EVENTS];
+  // Entries of the routines currently being measured on this thread, innermost last
+  size_t open_routines[STOPWATCH_MAX_STACK_DEPTH];
+  size_t num_open_routines;
+  // Each entry corresponds to a separate routine, see `routine_entries`. The start values, totals and rarely touched
+  // state are kept in separate arrays so that nested measurements touch as few cache lines as possible.
+  struct StartReadings starts[STOPWATCH_MAX_FUNCTION_CALLS];
+  struct MeasurementReadings readings[STOPWATCH_MAX_FUNCTION_CALLS];
+  struct ReadingsMetadata metadata[STOPWATCH_MAX_FUNCTION_CALLS];
+  // Number of threads that started measuring before this one since initialization
+  size_t thread_index;
+  // State of the generator picking the invocations of sampled routines at random
+  uint64_t sampling_random_state;
+  // Bit of each work counter this thread has added to, so that unnamed counters are reported once used
+  unsigned int work_counters_used;
+  // Where the totals of this thread are published, or NULL if they are not
+  struct StopwatchShmThread *shm_thread;
+  // Next thread in the list of all threads that have measured something
+  struct ThreadMeasurements *next;
+};
+
+// Copy of the totals of every routine summed over all threads, along with everything needed to report them. Indexed by
+// the entries of the routines.
+struct StopwatchSnapshot {
+  struct MeasurementReadings totals[STOPWATCH_MAX_FUNCTION_CALLS];
+  size_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  size_t caller_routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  char routine_names[STOPWATCH_MAX_FUNCTION_CALLS][NULL_TERM_MAX_ROUTINE_NAME_LEN];
+  size_t num_events;
+  int events[STOPWATCH_MAX_EVENTS];
+  char event_names[STOPWATCH_MAX_EVENTS][STOPWATCH_EVENT_NAME_LEN];
+  // Work counters that are reported, which are the first ones up to the last one that is named or was added to
+  size_t num_work_counters;
+  char work_names[STOPWATCH_MAX_WORK_COUNTERS][STOPWATCH_WORK_NAME_LEN];
+  // Whether the smallest and largest event values of the totals are known, which they are not in a difference
+  bool extremes_known;
+};
+
+// Rates of a routine derived from one of its work counters
+struct WorkRates {
+  double per_second;
+  double nsec_per_unit;
+  double events_per_unit[STOPWATCH_MAX_EVENTS];
 };
 
 // Flag to signal initialization
 static bool initialized_stopwatch = false;
 
-// Each entry corresponds to a separate entry measurement
-static struct MeasurementReadings readings[STOPWATCH_MAX_FUNCTION_CALLS];
+// Each entry corresponds to a separate routine
+static struct RoutineInfo routines[STOPWATCH_MAX_FUNCTION_CALLS];
+
+// Routine IDs may be any value, so the routine information and readings of each routine are stored at a dense entry
+// that is looked up in `routine_entries` on every measurement. Entry 0 is main. Entries are handed out in the order the
+// IDs are first seen and are kept for the life of the process, like registered IDs, so snapshots never go stale. Only
+// inserted into while holding `stopwatch_lock`.
+static struct IdMap routine_entries = {NULL};
+static size_t entry_routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+static size_t num_routine_entries = 1;
+
+// List of the measurement state of every thread. Only modified while holding `stopwatch_lock`
+static struct ThreadMeasurements *thread_list = NULL;
+
+// Measurement state of the calling thread. Only valid if `thread_generation` matches `generation`, which is bumped on
+// every initialization so that state belonging to a previous initialization is never used.
+static __thread struct ThreadMeasurements *thread_measurements = NULL;
+static __thread unsigned int thread_generation = 0;
+static unsigned int generation = 0;
+
+// Guards everything that is not on the measurement fast path i.e. the thread list, routine information and ID
+// registration
+static pthread_mutex_t stopwatch_lock = PTHREAD_MUTEX_INITIALIZER;
 
-// Holds each measurement event. Not all indices will be simultaneously used and hence the variable
-// `num_registered_events`acts as a separator between the indices that represent actual registered events and garbage
-// values.
-static int events[STOPWATCH_MAX_EVENTS];
+// Next ID handed out by `stopwatch_register_routine`. IDs are reserved from the top of the ID space downwards, far from
+// small hand picked IDs
+static size_t next_registered_id = SIZE_MAX;
 
-// Holds the intermediate results from PAPI. Mainly used as an intermediate to accumulate measurements. PAPI itself does
-// have an accumulation feature but it resets the timers which is undesirable when it comes to nesting measurements.
-static long long tmp_event_results[STOPWATCH_MAX_EVENTS];
+static StopwatchNameResolver name_resolver = NULL;
 
-// Number of events that are currently stored in the `events` variable.
+// Set by `stopwatch_init` if the environment disables measuring altogether, in which case no backend is initialized
+static bool stopwatch_disabled = false;
+
+// Set while no new measurements are started
+static atomic_bool paused = false;
+
+// Routine filters read from the environment. NULL terminated arrays of globs, or NULL if unset
+static char **include_patterns = NULL;
+static char **exclude_patterns = NULL;
+static size_t max_depth = STOPWATCH_MAX_FUNCTION_CALLS;
+
+// Routines whose names match one of these globs keep a series with the default size and decimation
+static char **series_patterns = NULL;
+static size_t default_series_size = STOPWATCH_DEFAULT_SERIES_SIZE;
+static size_t default_series_decimation = 1;
+
+// Routines whose names match one of these globs are sampled with the default interval, at random if requested
+static char **sampled_patterns = NULL;
+static size_t default_sampling_interval = 0;
+static bool random_sampling = false;
+
+// Nanoseconds that a start and end measurement pair adds to a routine, measured by `stopwatch_init`, and that a pair
+// adds when the invocation is only counted
+static long long pair_overhead_nsec = 0;
+static long long count_overhead_nsec = 0;
+
+// Fraction of the real time of a routine that measuring may add before it is throttled, or 0 if there is no budget
+static double overhead_budget = 0;
+
+// Every throttling decision in the order they were made. Only accessed while holding `stopwatch_lock`
+static struct StopwatchThrottleDecision throttle_decisions[MAX_THROTTLE_DECISIONS];
+static size_t num_throttle_decisions = 0;
+
+// Names of the work counters, from `STOPWATCH_WORK_COUNTERS` or their defaults, and how many were named there
+static char work_names[STOPWATCH_MAX_WORK_COUNTERS][STOPWATCH_WORK_NAME_LEN];
+static size_t num_named_work_counters = 0;
+
+// Number of slowest invocations of every routine each thread keeps, or 0 if they are not kept
+static size_t num_slowest_kept = 0;
+
+// Real microseconds when the stopwatch was initialized. Start times of the slowest invocations are relative to it.
+static long long init_real_us = 0;
+
+// Shared memory segment the totals are published to if `STOPWATCH_SHM` is set, along with its name
+static struct StopwatchShmSegment *shm_segment = NULL;
+static char *shm_name = NULL;
+
+// Backend counting the events, selected by `stopwatch_init`
+static const struct CounterBackend *backend = NULL;
+
+// Number of events that are currently stored in the `event_infos` variable.
 static size_t num_registered_events = 0;
 
-// Event set used by
-static int event_set = PAPI_NULL;
+// Accumulates the events of every end measurement. Specialized for `num_registered_events` and the processor, so it is
+// selected once the events are registered.
+static AccumulateKernel accumulate_events = NULL;
+
+// Number of events in `event_infos` counted by the backend. The operating system metrics selected in
+// `STOPWATCH_OS_METRICS` follow them, then the allocation metrics selected in `STOPWATCH_ALLOC_METRICS` and last the
+// I/O metrics selected in `STOPWATCH_IO_METRICS`.
+static size_t num_counter_events = 0;
+static size_t num_os_metric_events = 0;
+static size_t num_alloc_metric_events = 0;
+
+// Find the allocation and I/O counters of a thread if allocation or I/O metrics are measured
+static AllocCountersGetter alloc_counters_getter = NULL;
+static IoCountersGetter io_counters_getter = NULL;
+
+// Description of each measured event. Not all indices will be simultaneously used and hence the variable
+// `num_registered_events` acts as a separator between the indices that represent actual registered events and garbage
+// values. Looked up once when the event is added so that results are reported without calling the backend.
+static struct StopwatchEventInfo event_infos[STOPWATCH_MAX_EVENTS];
+
+// File the totals are dumped to on STOPWATCH_DUMP_SIGNAL if `STOPWATCH_DUMP_FILE` is set, along with the action that
+// the handler replaced
+static char *dump_path = NULL;
+static struct sigaction previous_dump_action;
+static atomic_bool dump_handler_installed = false;
+// Number of signal handlers currently dumping. `stopwatch_destroy` waits for them before freeing anything they read.
+static atomic_int dumps_in_progress = 0;
 
 // =====================================================================================================================
 // Private helper functions definitions
 // =====================================================================================================================
+static enum StopwatchStatus start_backend(const struct CounterBackend *candidate, void **counters);
+
 static enum StopwatchStatus set_events();
 
 static enum StopwatchStatus add_event(const char *event_to_add);
 
-static size_t find_num_entries();
+static enum StopwatchStatus set_metrics(const char *env_var,
+                                        enum StopwatchStatus (*find_metric)(const char *, struct StopwatchEventInfo *),
+                                        const char *(*metric_name)(size_t));
+
+static enum StopwatchStatus add_metric(const char *metric_to_add,
+                                       enum StopwatchStatus (*find_metric)(const char *, struct StopwatchEventInfo *));
+
+static enum StopwatchStatus set_alloc_metrics();
+
+static enum StopwatchStatus set_io_metrics();
+
+static void begin_alloc_region(struct ThreadMeasurements *state, struct StartReadings *start);
+
+static void end_alloc_region(struct ThreadMeasurements *state, const struct StartReadings *start);
+
+static bool read_events(const struct ThreadMeasurements *state, long long *values);
+
+static const char *registered_event_name(int event_code);
+
+static struct ThreadMeasurements *create_thread_measurements();
+
+static struct ThreadMeasurements *get_thread_measurements();
+
+static size_t find_or_add_entry(size_t routine_id);
+
+static size_t add_entry(size_t routine_id);
+
+static size_t entry_or_main(size_t routine_id);
+
+static enum RoutineState record_routine_info(size_t entry, const char *function_name, size_t caller_routine_id);
+
+static void set_filters();
+
+static void destroy_filters();
+
+static char **parse_patterns(const char *patterns);
+
+static bool matches_any(char *const *patterns, const char *name);
+
+static bool passes_filters(size_t entry);
 
-static void set_header(const struct StringTable *table);
+static void record_series_sample(struct ThreadMeasurements *state, size_t entry, long long real_us);
+
+static void record_slowest_invocation(struct ThreadMeasurements *state, size_t entry, long long real_us);
+
+static void print_slowest_invocation_row(const struct StringTable *table,
+                                         size_t row_num,
+                                         const struct StopwatchInvocation *invocation);
+
+static void calibrate_overhead(const struct ThreadMeasurements *state);
+
+static enum StopwatchStatus start_unmeasured_invocation(size_t entry);
+
+static void start_recursive_invocation(struct ThreadMeasurements *state, size_t entry);
+
+static void push_open_routine(struct ThreadMeasurements *state, size_t entry);
+
+static void pop_open_routine(struct ThreadMeasurements *state, size_t entry);
+
+static bool skip_invocation(struct ThreadMeasurements *state, size_t entry);
+
+static void choose_auto_sampling_interval(const struct MeasurementReadings *reading, struct ReadingsMetadata *metadata);
+
+static size_t sampling_interval(const struct ReadingsMetadata *metadata, size_t entry);
+
+static double estimate_overhead(enum StopwatchThrottling throttling, size_t interval, double mean_nsec);
+
+static void evaluate_throttling(const struct ThreadMeasurements *state,
+                                const struct MeasurementReadings *reading,
+                                size_t entry);
+
+static const char *throttling_name(enum StopwatchThrottling throttling);
+
+static void report_totals(const struct MeasurementReadings *total,
+                          size_t num_events,
+                          long long *real_us,
+                          long long *events_measurements,
+                          double *real_us_error);
+
+static bool report_event_spread(const struct MeasurementReadings *total,
+                                size_t num_events,
+                                bool extremes_known,
+                                long long *min_events_measurements,
+                                long long *max_events_measurements,
+                                double *sum_squared_events_measurements);
+
+static double event_stddev(const struct MeasurementReadings *total, size_t event_idx);
+
+static void add_to_imbalance(struct StopwatchImbalance *imbalance,
+                             size_t thread_index,
+                             long long real_us,
+                             const long long *events_measurements);
+
+static size_t find_imbalances(struct StopwatchImbalance *imbalances);
+
+static int compare_most_imbalanced_first(const void *lhs, const void *rhs);
+
+static bool any_routine_sampled(const struct StopwatchSnapshot *snapshot);
+
+static void set_work_names();
+
+static size_t num_reported_work_counters(unsigned int work_counters_used);
+
+static size_t num_work_columns(const struct StopwatchSnapshot *snapshot);
+
+static bool work_rates(long long work,
+                       long long real_us,
+                       const long long *events_measurements,
+                       size_t num_events,
+                       struct WorkRates *rates);
+
+static struct ThreadMeasurements *alloc_thread_measurements();
+
+static void add_thread_measurements(struct ThreadMeasurements *state);
+
+static enum StopwatchStatus create_shm();
+
+static void publish_routine_totals(struct StopwatchShmThread *shm_thread,
+                                   size_t entry,
+                                   const struct MeasurementReadings *reading);
+
+static const char *routine_name(size_t entry);
+
+static long long real_usec();
+
+static enum StopwatchStatus install_dump_handler();
+
+static void uninstall_dump_handler();
+
+static void dump_signal_handler(int signal_number);
+
+static struct StopwatchSnapshot *create_snapshot();
+
+static void *calloc_cache_aligned(size_t size);
+
+static size_t find_num_entries(const struct StopwatchSnapshot *snapshot);
+
+static size_t reported_caller(const struct StopwatchSnapshot *snapshot, size_t entry);
+
+static void set_header(const struct StringTable *table, const struct StopwatchSnapshot *snapshot, bool sampled);
 
 static void set_body_row(const struct StringTable *table,
+                         bool sampled,
                          size_t row_num,
-                         size_t routine_id,
-                         size_t stack_depth,
-                         struct MeasurementReadings reading);
+                         const struct StopwatchSnapshot *snapshot,
+                         size_t entry,
+                         size_t stack_depth);
 
 // =====================================================================================================================
 // Public interface functions implementations
 // =====================================================================================================================
 
-// Initializes PAPI library. Should only be called once.
+// Initializes the counter backend. Should only be called once.
 // Will return STOPWATCH_OK if successful
 // Will return STOPWATCH_ERR if fail
 enum StopwatchStatus stopwatch_init() {
   // Check if stopwatch is not already initialized
   if (!initialized_stopwatch) {
-    // Reset the function names and times called to default values values
+    // Reset the routine information of routines that were not registered. Registered routines keep their names as they
+    // are only registered once per process.
     for (unsigned int idx = 0; idx < STOPWATCH_MAX_FUNCTION_CALLS; idx++) {
-      readings[idx].total_times_called = 0;
-      memset(readings[idx].total_events_measurements, 0, sizeof(readings[idx].total_events_measurements));
-      readings[idx].total_real_us = 0;
-      memset(readings[idx].routine_name, 0, sizeof(readings[idx].routine_name));
+      if (!routines[idx].registered) {
+        memset(routines[idx].routine_name, 0, sizeof(routines[idx].routine_name));
+      }
+      routines[idx].caller_routine_id = 0;
+      routines[idx].depth = 0;
+      routines[idx].series_size = 0;
+      routines[idx].series_decimation = 0;
+      routines[idx].sampled = false;
+      routines[idx].sampling_interval = 0;
+      routines[idx].throttled_interval = 0;
+      atomic_store(&routines[idx].throttling, STOPWATCH_THROTTLE_NONE);
+      atomic_store(&routines[idx].state, ROUTINE_UNRECORDED);
     }
 
     // Reset number of registered events
     num_registered_events = 0;
+    num_counter_events = 0;
+    num_os_metric_events = 0;
+    num_alloc_metric_events = 0;
+    alloc_counters_getter = NULL;
+    io_counters_getter = NULL;
+    num_throttle_decisions = 0;
+
+    atomic_store(&paused, false);
+    set_filters();
+
+    // Nothing is measured so no backend is needed at all
+    const char *enable_env_val = getenv("STOPWATCH_ENABLE");
+    if (enable_env_val && (strcmp(enable_env_val, "0") == 0 || strcasecmp(enable_env_val, "false") == 0 ||
+                           strcasecmp(enable_env_val, "off") == 0)) {
+      stopwatch_disabled = true;
+      initialized_stopwatch = true;
+      return STOPWATCH_OK;
+    }
 
-    // Initialize PAPI
-    int init_ret_val = PAPI_library_init(PAPI_VER_CURRENT);
-    if (init_ret_val != PAPI_VER_CURRENT) {
+    // Invalidate the measurement state of every thread from a previous initialization
+    generation++;
+
+    // Select and initialize the backend. When neither a backend nor events were asked for, a default backend that
+    // cannot count (no PAPI component for the processor, perf_event closed off by perf_event_paranoid) falls back to the
+    // timer so that the real time and calls are still measured.
+    const char *backend_env_val = getenv("STOPWATCH_BACKEND");
+    const bool backend_selected = backend_env_val && backend_env_val[0] != '\0';
+    const struct CounterBackend *selected_backend = find_backend(backend_selected ? backend_env_val : NULL);
+    if (selected_backend == NULL) {
       stopwatch_destroy();
       return STOPWATCH_ERR;
     }
-
-    int create_ret_val = PAPI_create_eventset(&event_set);
-    if (create_ret_val != PAPI_OK) {
+    void *counters = NULL;
+    enum StopwatchStatus ret_val = start_backend(selected_backend, &counters);
+    if (ret_val != STOPWATCH_OK && !backend_selected && getenv("STOPWATCH_EVENTS") == NULL &&
+        selected_backend != &timer_backend) {
+      ret_val = start_backend(&timer_backend, &counters);
+    }
+    if (ret_val != STOPWATCH_OK) {
       stopwatch_destroy();
-      return STOPWATCH_ERR;
+      return ret_val;
     }
 
-    // Attempt to add each event selected in the environment variable to the event set. If not all can be added
-    // STOPWATCH_ERR will be returned
-    enum StopwatchStatus ret_val = set_events();
+    // Metrics are registered after the counter events, which the counters only ever read
+    ret_val = set_metrics("STOPWATCH_OS_METRICS", find_os_metric, os_metric_name);
+    num_os_metric_events = num_registered_events - num_counter_events;
+    if (ret_val == STOPWATCH_OK) {
+      ret_val = set_alloc_metrics();
+    }
+    num_alloc_metric_events = num_registered_events - num_counter_events - num_os_metric_events;
+    if (ret_val == STOPWATCH_OK) {
+      ret_val = set_io_metrics();
+    }
     if (ret_val != STOPWATCH_OK) {
+      backend->destroy_counters(counters);
       stopwatch_destroy();
       return ret_val;
     }
 
-    // Start the monotonic clock
-    int start_ret_val = PAPI_start(event_set);
-    if (start_ret_val != PAPI_OK) {
+    // Created before any thread measures so that every thread is published
+    if (create_shm() != STOPWATCH_OK) {
+      backend->destroy_counters(counters);
       stopwatch_destroy();
       return STOPWATCH_ERR;
     }
 
+    struct ThreadMeasurements *state = alloc_thread_measurements();
+    if (state == NULL) {
+      backend->destroy_counters(counters);
+      stopwatch_destroy();
+      return STOPWATCH_ERR;
+    }
+    state->counters = counters;
+    state->alloc_counters = alloc_counters_getter ? alloc_counters_getter() : NULL;
+    state->io_counters = io_counters_getter ? io_counters_getter() : NULL;
+    add_thread_measurements(state);
+
+    if (shm_segment) {
+      shm_segment->num_events = num_registered_events;
+      for (size_t idx = 0; idx < num_registered_events; idx++) {
+        strncpy(shm_segment->event_names[idx], event_infos[idx].name, STOPWATCH_SHM_EVENT_NAME_LEN - 1);
+      }
+    }
+
+    accumulate_events = select_accumulate_kernel(num_registered_events);
+    thread_measurements = state;
+    thread_generation = generation;
+    calibrate_overhead(state);
+    init_real_us = real_usec();
     initialized_stopwatch = true;
 
+    // Installed last as the handler reads everything set up above
+    if (install_dump_handler() != STOPWATCH_OK) {
+      stopwatch_destroy();
+      return STOPWATCH_ERR;
+    }
+
     return STOPWATCH_OK;
   }
   return STOPWATCH_ERR;
 }
 
-// CLean up resources used by PAPI and resets measurements regardless of the stage of execution. Should clean up the
+// CLean up resources used by the backend and resets measurements regardless of the stage of execution. Should clean up the
 // necessary elements on a failed or successfully initialization
 void stopwatch_destroy() {
-  // Regardless if the event set is running or not, calling stop should not produce side effects to state hence return
-  // value is not checked.
-  PAPI_stop(event_set, NULL);
+  uninstall_dump_handler();
+
+  pthread_mutex_lock(&stopwatch_lock);
+  struct ThreadMeasurements *state = thread_list;
+  while (state) {
+    // The initializing thread has no counters yet if initializing failed
+    if (state->counters) {
+      backend->destroy_counters(state->counters);
+    }
+
+    for (size_t idx = 0; idx < STOPWATCH_MAX_FUNCTION_CALLS; idx++) {
+      destroy_series(state->metadata[idx].series);
+      destroy_slowest(state->metadata[idx].slowest);
+    }
+
+    struct ThreadMeasurements *next = state->next;
+    free(state);
+    state = next;
+  }
+  thread_list = NULL;
 
-  // Will remove all events from event set if there are any and should do nothing if there is not. Return value is not
-  // checked as its return value does not effect execution
-  PAPI_cleanup_eventset(event_set);
+  if (shm_segment) {
+    destroy_shm_segment(shm_segment, shm_name);
+    shm_segment = NULL;
+  }
+  free(shm_name);
+  shm_name = NULL;
+  pthread_mutex_unlock(&stopwatch_lock);
 
-  PAPI_destroy_eventset(&event_set);
+  if (backend) {
+    backend->shutdown();
+    backend = NULL;
+  }
 
-  PAPI_shutdown();
+  // Threads still holding a pointer to their freed state will create a new one if re-initialized
+  generation++;
+  thread_measurements = NULL;
 
+  destroy_filters();
+  stopwatch_disabled = false;
   initialized_stopwatch = false;
 }
 
+// =====================================================================================================================
+// Measured events
+// =====================================================================================================================
+
+size_t stopwatch_num_events() {
+  return num_registered_events;
+}
+
+enum StopwatchStatus stopwatch_get_event_info(size_t event_idx, struct StopwatchEventInfo *info) {
+  if (event_idx >= num_registered_events) {
+    return STOPWATCH_ERR;
+  }
+  memcpy(info, &event_infos[event_idx], sizeof(struct StopwatchEventInfo));
+  return STOPWATCH_OK;
+}
+
+const char *stopwatch_event_name(size_t event_idx) {
+  return event_idx < num_registered_events ? event_infos[event_idx].name : NULL;
+}
+
 enum StopwatchStatus stopwatch_record_start_measurements(size_t routine_id,
                                                          const char *function_name,
                                                          size_t caller_routine_id) {
-  int PAPI_ret = PAPI_read(event_set, readings[routine_id].start_events_measurements);
-  if (PAPI_ret != PAPI_OK) {
+  if (stopwatch_disabled) {
+    return STOPWATCH_OK;
+  }
+  if (atomic_load_explicit(&paused, memory_order_relaxed)) {
+    // Routines that were never seen cannot be open
+    const size_t entry = id_map_find(&routine_entries, routine_id);
+    return entry != ID_MAP_NOT_FOUND ? start_unmeasured_invocation(entry) : STOPWATCH_OK;
+  }
+
+  const size_t entry = find_or_add_entry(routine_id);
+  if (entry == ID_MAP_NOT_FOUND) {
     return STOPWATCH_ERR;
   }
 
-  readings[routine_id].start_real_us = PAPI_get_real_usec();
+  // Only log these values the first time it is called as there is a possibility of nesting. This is also when the
+  // filters are applied. The state of the routine is checked before the state of the thread is looked up, so from then
+  // on a filtered out routine costs the lookup of its entry in `routine_entries` and a branch. Filtered out routines are
+  // never open, while a switched off routine may still be open from before it was switched off.
+  enum RoutineState routine_state = atomic_load_explicit(&routines[entry].state, memory_order_acquire);
+  if (routine_state == ROUTINE_UNRECORDED) {
+    routine_state = record_routine_info(entry, function_name, caller_routine_id);
+  }
+  if (routine_state == ROUTINE_THROTTLED) {
+    return start_unmeasured_invocation(entry);
+  }
+  if (routine_state != ROUTINE_MEASURED) {
+    return STOPWATCH_OK;
+  }
+
+  struct ThreadMeasurements *state = get_thread_measurements();
+  if (state == NULL) {
+    return STOPWATCH_ERR;
+  }
 
-  // Only log these values the first time it is called as there is a possibility of nesting.
-  if (readings[routine_id].total_times_called == 0) {
-    readings[routine_id].caller_routine_id = caller_routine_id;
+  struct StartReadings *start = &state->starts[entry];
+  if (start->measuring) {
+    start_recursive_invocation(state, entry);
+    return STOPWATCH_OK;
+  }
 
-    // Copy in the routine name and ensure the string is null terminated
-    strncpy(readings[routine_id].routine_name, function_name, NULL_TERM_MAX_ROUTINE_NAME_LEN);
-    readings[routine_id].routine_name[NULL_TERM_MAX_ROUTINE_NAME_LEN - 1] = '\0';
+  // Invocations of sampled routines that are skipped, and of routines the overhead budget only lets count, are only
+  // counted
+  const enum StopwatchThrottling throttling =
+      atomic_load_explicit(&routines[entry].throttling, memory_order_acquire);
+  if (throttling == STOPWATCH_THROTTLE_COUNT_ONLY) {
+    start->sampled = false;
+  } else if (routines[entry].sampled || throttling == STOPWATCH_THROTTLE_SAMPLED) {
+    start->sampled = !skip_invocation(state, entry);
+  } else {
+    start->sampled = true;
+  }
+  if (start->sampled) {
+    if (state->alloc_counters) {
+      begin_alloc_region(state, start);
+    }
+    if (!read_events(state, start->start_events_measurements)) {
+      return STOPWATCH_ERR;
+    }
+    start->start_real_us = real_usec();
   }
+  start->measuring = true;
+  push_open_routine(state, entry);
 
   return STOPWATCH_OK;
 }
 
+enum StopwatchStatus stopwatch_record_start_registered(size_t routine_id) {
+  return stopwatch_record_start_measurements(routine_id, NULL, stopwatch_current_routine_id());
+}
+
+size_t stopwatch_current_routine_id() {
+  const struct ThreadMeasurements *state = get_thread_measurements();
+  if (state == NULL || state->num_open_routines == 0 || state->num_open_routines > STOPWATCH_MAX_STACK_DEPTH) {
+    return 0;
+  }
+  return entry_routine_ids[state->open_routines[state->num_open_routines - 1]];
+}
+
 enum StopwatchStatus stopwatch_record_end_measurements(size_t routine_id) {
-  int PAPI_ret = PAPI_read(event_set, tmp_event_results);
-  if (PAPI_ret != PAPI_OK) {
+  if (stopwatch_disabled) {
+    return STOPWATCH_OK;
+  }
+
+  struct ThreadMeasurements *state = get_thread_measurements();
+  if (state == NULL) {
+    return STOPWATCH_ERR;
+  }
+
+  // Routines that were never started have no entry
+  const size_t entry = id_map_find(&routine_entries, routine_id);
+  if (entry == ID_MAP_NOT_FOUND) {
+    return STOPWATCH_OK;
+  }
+  struct StartReadings *start = &state->starts[entry];
+  if (!start->measuring) {
+    return STOPWATCH_OK;
+  }
+
+  struct MeasurementReadings *reading = &state->readings[entry];
+  if (start->recursion_depth > 0) {
+    // Counted as measured along with the outermost invocation, which holds its time and events, so that the totals of
+    // a sampled routine are still scaled by the share of invocations that were measured
+    start->recursion_depth--;
+    reading->total_times_called++;
+    if (start->sampled) {
+      reading->sampled_times_called++;
+    }
+    if (state->shm_thread) {
+      publish_routine_totals(state->shm_thread, entry, reading);
+    }
+    pop_open_routine(state, entry);
+    return STOPWATCH_OK;
+  }
+
+  if (!start->sampled) {
+    start->measuring = false;
+    reading->total_times_called++;
+    if (overhead_budget > 0 && reading->total_times_called % THROTTLE_WINDOW == 0 &&
+        atomic_load_explicit(&routines[entry].throttling, memory_order_relaxed) == STOPWATCH_THROTTLE_COUNT_ONLY) {
+      evaluate_throttling(state, reading, entry);
+    }
+    // Published so that viewers see the calls of routines that are mostly skipped
+    if (state->shm_thread) {
+      publish_routine_totals(state->shm_thread, entry, reading);
+    }
+    pop_open_routine(state, entry);
+    return STOPWATCH_OK;
+  }
+
+  if (!read_events(state, state->tmp_event_results)) {
+    // Still ended, so that the routine is not left open
+    start->measuring = false;
+    pop_open_routine(state, entry);
     return STOPWATCH_ERR;
   }
+  if (state->alloc_counters) {
+    end_alloc_region(state, start);
+  }
 
-  readings[routine_id].total_times_called++;
+  start->measuring = false;
+  reading->total_times_called++;
+  reading->sampled_times_called++;
 
   // Accumulate the timer results
-  readings[routine_id].total_real_us +=
-      (PAPI_get_real_usec() - readings[routine_id].start_real_us);
+  const long long real_us = real_usec() - start->start_real_us;
+  reading->total_real_us += real_us;
+  reading->sum_squared_real_us += (double) real_us * (double) real_us;
 
-  // Accumulate the event(s) results
-  for (unsigned int idx = 0; idx < num_registered_events; idx++) {
-    readings[routine_id].total_events_measurements[idx] +=
-        (tmp_event_results[idx] - readings[routine_id].start_events_measurements[idx]);
+  // Accumulate the event(s) results. The intermediate results are left holding the values of this invocation.
+  accumulate_events(state->tmp_event_results, start->start_events_measurements, &reading->events);
+
+  if (routines[entry].series_decimation != 0) {
+    record_series_sample(state, entry, real_us);
+  }
+
+  if (num_slowest_kept != 0) {
+    record_slowest_invocation(state, entry, real_us);
+  }
+
+  if (routines[entry].sampled && routines[entry].sampling_interval == 0 &&
+      reading->sampled_times_called == AUTO_SAMPLING_WARMUP) {
+    choose_auto_sampling_interval(reading, &state->metadata[entry]);
   }
 
+  if (overhead_budget > 0 && reading->sampled_times_called % THROTTLE_WINDOW == 0) {
+    evaluate_throttling(state, reading, entry);
+  }
+
+  if (state->shm_thread) {
+    publish_routine_totals(state->shm_thread, entry, reading);
+  }
+
+  pop_open_routine(state, entry);
+
+  return STOPWATCH_OK;
+}
+
+size_t stopwatch_get_routine_ids(size_t *routine_ids, size_t max_routine_ids) {
+  // Entry 0 is main
+  const size_t num_entries = __atomic_load_n(&num_routine_entries, __ATOMIC_ACQUIRE);
+  size_t num_ids = 0;
+  for (size_t entry = 1; entry < num_entries && num_ids < max_routine_ids; entry++) {
+    routine_ids[num_ids++] = entry_routine_ids[entry];
+  }
+  return num_ids;
+}
+
+enum StopwatchStatus stopwatch_register_routine(const char *routine_name, size_t *routine_id) {
+  enum StopwatchStatus ret_val = STOPWATCH_OK;
+
+  pthread_mutex_lock(&stopwatch_lock);
+  // Another thread may have registered the same variable while waiting for the lock
+  if (*routine_id == 0) {
+    // IDs that were already used by hand are skipped
+    while (next_registered_id != 0 && id_map_find(&routine_entries, next_registered_id) != ID_MAP_NOT_FOUND) {
+      next_registered_id--;
+    }
+    // ID 0 is reserved for main
+    const size_t entry = next_registered_id != 0 ? add_entry(next_registered_id) : ID_MAP_NOT_FOUND;
+    if (entry == ID_MAP_NOT_FOUND) {
+      ret_val = STOPWATCH_ERR;
+    } else {
+      const size_t id = next_registered_id--;
+      routines[entry].registered = true;
+      if (routine_name) {
+        strncpy(routines[entry].routine_name, routine_name, NULL_TERM_MAX_ROUTINE_NAME_LEN);
+        routines[entry].routine_name[NULL_TERM_MAX_ROUTINE_NAME_LEN - 1] = '\0';
+      }
+      // Released so that threads reading the ID without the lock i.e. lazily registered static variables, see it whole
+      __atomic_store_n(routine_id, id, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_mutex_unlock(&stopwatch_lock);
+
+  return ret_val;
+}
+
+void stopwatch_set_name_resolver(StopwatchNameResolver resolver) {
+  name_resolver = resolver;
+}
+
+void stopwatch_pause() {
+  atomic_store(&paused, true);
+}
+
+void stopwatch_resume() {
+  atomic_store(&paused, false);
+}
+
+enum StopwatchStatus stopwatch_enable_series(size_t routine_id, size_t buffer_size, size_t decimation) {
+  const size_t entry = decimation != 0 ? find_or_add_entry(routine_id) : ID_MAP_NOT_FOUND;
+  if (entry == ID_MAP_NOT_FOUND) {
+    return STOPWATCH_ERR;
+  }
+  pthread_mutex_lock(&stopwatch_lock);
+  routines[entry].series_size = buffer_size;
+  routines[entry].series_decimation = decimation;
+  pthread_mutex_unlock(&stopwatch_lock);
+  return STOPWATCH_OK;
+}
+
+enum StopwatchStatus stopwatch_enable_sampling(size_t routine_id, size_t interval) {
+  const size_t entry = interval <= STOPWATCH_MAX_SAMPLING_INTERVAL ? find_or_add_entry(routine_id) : ID_MAP_NOT_FOUND;
+  if (entry == ID_MAP_NOT_FOUND) {
+    return STOPWATCH_ERR;
+  }
+  pthread_mutex_lock(&stopwatch_lock);
+  routines[entry].sampled = true;
+  routines[entry].sampling_interval = interval;
+  pthread_mutex_unlock(&stopwatch_lock);
   return STOPWATCH_OK;
 }
 
+size_t stopwatch_get_series(size_t routine_id, struct StopwatchSeriesSample *samples, size_t max_samples) {
+  const struct ThreadMeasurements *state = get_thread_measurements();
+  const size_t entry = id_map_find(&routine_entries, routine_id);
+  if (state == NULL || entry == ID_MAP_NOT_FOUND || state->metadata[entry].series == NULL) {
+    return 0;
+  }
+
+  const struct Series *series = state->metadata[entry].series;
+  struct SeriesIter iter;
+  series_iter_init(&iter, series);
+  size_t num_samples = 0;
+  while (num_samples < max_samples && series_iter_has_next(&iter)) {
+    const long long *values = series_iter_next(&iter);
+    samples[num_samples].invocation = series_sample_invocation(series, num_samples);
+    samples[num_samples].real_usec = values[0];
+    memcpy(samples[num_samples].event_values, values + 1, sizeof(long long) * (series->num_values - 1));
+    num_samples++;
+  }
+  return num_samples;
+}
+
+size_t stopwatch_measurement_result_size() {
+  return sizeof(struct StopwatchMeasurementResult);
+}
+
 void stopwatch_print_measurement_results(struct StopwatchMeasurementResult *result) {
   printf("Procedure name: %s\n", result->routine_name);
   printf("Total times run: %lld\n", result->total_times_called);
   printf("Total real microseconds elapsed: %lld\n", result->total_real_usec);
   for (unsigned int idx = 0; idx < result->num_of_events; idx++) {
-    char event_code_string[PAPI_MAX_STR_LEN];
-    PAPI_event_code_to_name(result->event_names[idx], event_code_string);
-    printf("%s: %lld\n", event_code_string, result->total_event_values[idx]);
+    printf("%s: %lld\n", registered_event_name(result->event_names[idx]), result->total_event_values[idx]);
   }
 }
 
 enum StopwatchStatus stopwatch_get_measurement_results(size_t routine_id, struct StopwatchMeasurementResult *result) {
-  if (routine_id >= STOPWATCH_MAX_FUNCTION_CALLS) {
-    return STOPWATCH_ERR;
+  // Routines that were never seen have an empty result, as main does
+  const size_t entry = id_map_find(&routine_entries, routine_id);
+  const bool seen = entry != ID_MAP_NOT_FOUND;
+
+  // Sum the readings of the routine over every thread
+  struct MeasurementReadings reading = {0};
+  clear_event_totals(&reading.events);
+  pthread_mutex_lock(&stopwatch_lock);
+  for (const struct ThreadMeasurements *state = thread_list; seen && state; state = state->next) {
+    reading.total_times_called += state->readings[entry].total_times_called;
+    reading.sampled_times_called += state->readings[entry].sampled_times_called;
+    reading.migrated_times_called += state->readings[entry].migrated_times_called;
+    reading.total_real_us += state->readings[entry].total_real_us;
+    reading.sum_squared_real_us += state->readings[entry].sum_squared_real_us;
+    merge_event_totals(&reading.events, &state->readings[entry].events, num_registered_events);
+    for (size_t idx = 0; idx < STOPWATCH_MAX_WORK_COUNTERS; idx++) {
+      reading.total_work[idx] += state->readings[entry].total_work[idx];
+    }
   }
-
-  result->total_real_usec = readings[routine_id].total_real_us;
+  pthread_mutex_unlock(&stopwatch_lock);
+
+  report_totals(&reading,
+                num_registered_events,
+                &result->total_real_usec,
+                result->total_event_values,
+                &result->real_usec_error);
+  result->event_extremes_known = report_event_spread(&reading,
+                                                     num_registered_events,
+                                                     true,
+                                                     result->min_event_values,
+                                                     result->max_event_values,
+                                                     result->sum_squared_event_values);
   result->num_of_events = num_registered_events;
   for (unsigned int idx = 0; idx < num_registered_events; idx++) {
-    result->total_event_values[idx] = readings[routine_id].total_events_measurements[idx];
-    result->event_names[idx] = events[idx];
+    result->event_names[idx] = event_infos[idx].code;
   }
 
-  result->total_times_called = readings[routine_id].total_times_called;
-  result->caller_routine_id = readings[routine_id].caller_routine_id;
+  result->total_times_called = reading.total_times_called;
+  result->sampled_times_called = reading.sampled_times_called;
+  result->migrated_times_called = reading.migrated_times_called;
+  memcpy(result->total_work, reading.total_work, sizeof(result->total_work));
+  result->caller_routine_id = seen ? routines[entry].caller_routine_id : 0;
 
-  // String already null terminated. Note this also copies the NULL terminator '\0'
-  memcpy(result->routine_name, readings[routine_id].routine_name, NULL_TERM_MAX_ROUTINE_NAME_LEN);
+  // Copy in the routine name and ensure the string is null terminated
+  strncpy(result->routine_name, seen ? routine_name(entry) : "", NULL_TERM_MAX_ROUTINE_NAME_LEN);
+  result->routine_name[NULL_TERM_MAX_ROUTINE_NAME_LEN - 1] = '\0';
 
   return STOPWATCH_OK;
 }
 
 // =====================================================================================================================
-// Print results into a formatted table
+// Asynchronous regions
 // =====================================================================================================================
 
-void stopwatch_print_result_table() {
-  // Generate table
-  const size_t num_static_cols = 4; // Additional 4 for id, name, times called and total usec
-  const size_t num_functions = find_num_entries();
-  const size_t columns = num_registered_events + num_static_cols;
-  const size_t rows = num_functions + 1; // Extra row for header
+enum StopwatchStatus stopwatch_start_async(size_t routine_id,
+                                           const char *function_name,
+                                           size_t caller_routine_id,
+                                           struct StopwatchAsyncRegion *region) {
+  region->generation = 0;
+  if (stopwatch_disabled || atomic_load_explicit(&paused, memory_order_relaxed)) {
+    return STOPWATCH_OK;
+  }
 
-  struct StringTable *table = create_table(columns, rows, true, INDENT_SPACING);
+  struct ThreadMeasurements *state = get_thread_measurements();
+  if (state == NULL) {
+    return STOPWATCH_ERR;
+  }
 
-  set_header(table);
+  const size_t entry = find_or_add_entry(routine_id);
+  if (entry == ID_MAP_NOT_FOUND) {
+    return STOPWATCH_ERR;
+  }
+  enum RoutineState routine_state = atomic_load_explicit(&routines[entry].state, memory_order_acquire);
+  if (routine_state == ROUTINE_UNRECORDED) {
+    routine_state = record_routine_info(entry, function_name, caller_routine_id);
+  }
+  if (routine_state != ROUTINE_MEASURED) {
+    return STOPWATCH_OK;
+  }
 
-  if (num_functions > 0) {
-    struct FunctionNode *function_list = malloc(sizeof(struct FunctionNode) * num_functions);
-    size_t entry_num = 0;
-    for (size_t idx = 0; idx < STOPWATCH_MAX_FUNCTION_CALLS; idx++) {
-      if (readings[idx].total_times_called == 0) {
-        continue;
-      }
-      function_list[entry_num].function_id = idx;
-      function_list[entry_num].caller_id = readings[idx].caller_routine_id;
+  if (!read_events(state, region->start_event_values)) {
+    return STOPWATCH_ERR;
+  }
+  region->start_real_usec = real_usec();
+  region->routine_id = routine_id;
+  region->start_thread_index = state->thread_index;
+  region->generation = generation;
+  return STOPWATCH_OK;
+}
+
+enum StopwatchStatus stopwatch_end_async(struct StopwatchAsyncRegion *region) {
+  if (stopwatch_disabled || region->generation != generation) {
+    return STOPWATCH_OK;
+  }
+
+  struct ThreadMeasurements *state = get_thread_measurements();
+  if (state == NULL) {
+    return STOPWATCH_ERR;
+  }
+
+  // Counters of other threads cannot be read, and their values mean nothing on this thread
+  const bool same_thread = state->thread_index == region->start_thread_index;
+  if (same_thread && !read_events(state, state->tmp_event_results)) {
+    return STOPWATCH_ERR;
+  }
+  const long long real_us = real_usec() - region->start_real_usec;
+  region->generation = 0;
+
+  // Entries are never taken back, so the routine still has the entry it started with
+  const size_t entry = id_map_find(&routine_entries, region->routine_id);
+  struct MeasurementReadings *reading = &state->readings[entry];
+  reading->total_times_called++;
+  reading->sampled_times_called++;
+  reading->total_real_us += real_us;
+  reading->sum_squared_real_us += (double) real_us * (double) real_us;
+  if (same_thread) {
+    accumulate_events(state->tmp_event_results, region->start_event_values, &reading->events);
+  } else {
+    reading->migrated_times_called++;
+  }
+
+  if (state->shm_thread) {
+    publish_routine_totals(state->shm_thread, entry, reading);
+  }
+  return STOPWATCH_OK;
+}
+
+// =====================================================================================================================
+// Work counters
+// =====================================================================================================================
+
+enum StopwatchStatus stopwatch_add_work(size_t routine_id, size_t counter_index, long long amount) {
+  if (stopwatch_disabled) {
+    return STOPWATCH_OK;
+  }
+  const size_t entry = counter_index < STOPWATCH_MAX_WORK_COUNTERS ? find_or_add_entry(routine_id) : ID_MAP_NOT_FOUND;
+  if (entry == ID_MAP_NOT_FOUND) {
+    return STOPWATCH_ERR;
+  }
+
+  struct ThreadMeasurements *state = get_thread_measurements();
+  if (state == NULL) {
+    return STOPWATCH_ERR;
+  }
+  state->readings[entry].total_work[counter_index] += amount;
+  state->work_counters_used |= 1u << counter_index;
+  return STOPWATCH_OK;
+}
+
+const char *stopwatch_work_counter_name(size_t counter_index) {
+  return counter_index < STOPWATCH_MAX_WORK_COUNTERS ? work_names[counter_index] : NULL;
+}
+
+// =====================================================================================================================
+// Print results into a formatted table
+// =====================================================================================================================
+
+void stopwatch_print_result_table() {
+  struct StopwatchSnapshot *snapshot = stopwatch_snapshot();
+  if (snapshot) {
+    stopwatch_print_snapshot_table(snapshot);
+    stopwatch_destroy_snapshot(snapshot);
+  }
+  if (stopwatch_ompt_print_summary) {
+    stopwatch_ompt_print_summary();
+  }
+  if (stopwatch_mpi_print_summary) {
+    stopwatch_mpi_print_summary();
+  }
+  stopwatch_print_imbalance_table();
+  stopwatch_print_slowest_table();
+  stopwatch_print_throttle_table();
+}
+
+enum StopwatchStatus stopwatch_result_to_csv(const char *file_name) {
+  struct StopwatchSnapshot *snapshot = stopwatch_snapshot();
+  if (snapshot == NULL) {
+    return STOPWATCH_ERR;
+  }
+  enum StopwatchStatus ret_val = stopwatch_snapshot_to_csv(snapshot, file_name);
+  stopwatch_destroy_snapshot(snapshot);
+  return ret_val;
+}
+
+// =====================================================================================================================
+// Dumping from a signal handler
+// =====================================================================================================================
+
+enum StopwatchStatus stopwatch_dump(int fd) {
+  struct DumpWriter writer;
+  dump_writer_init(&writer, fd);
+
+  // Work counters are dumped as totals only, as formatting their rates is not async-signal-safe
+  unsigned int work_counters_used = 0;
+  for (const struct ThreadMeasurements *state = __atomic_load_n(&thread_list, __ATOMIC_ACQUIRE); state;
+       state = state->next) {
+    work_counters_used |= state->work_counters_used;
+  }
+  const size_t num_work_counters = num_reported_work_counters(work_counters_used);
+
+  dump_write_str(&writer, "THREAD,ID,NAME,CALLER_ID,TIMES_CALLED,TOTAL_REAL_MICROSECONDS");
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    dump_write_char(&writer, ',');
+    dump_write_str(&writer, event_infos[idx].name);
+  }
+  for (size_t counter = 0; counter < num_work_counters; counter++) {
+    dump_write_char(&writer, ',');
+    dump_write_str(&writer, work_names[counter]);
+  }
+  dump_write_str(&writer, ",OPEN_REAL_MICROSECONDS\n");
+
+  // The lock cannot be taken here as the interrupted thread may hold it. Other threads keep measuring, so their
+  // values may be a measurement apart from each other.
+  const long long now = real_usec();
+  for (const struct ThreadMeasurements *state = __atomic_load_n(&thread_list, __ATOMIC_ACQUIRE); state;
+       state = state->next) {
+    for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+      const struct MeasurementReadings *reading = &state->readings[entry];
+      const struct StartReadings *start = &state->starts[entry];
+      if (reading->total_times_called == 0 && !start->measuring) {
+        continue;
+      }
+
+      dump_write_lld(&writer, (long long) state->thread_index);
+      dump_write_char(&writer, ',');
+      dump_write_zu(&writer, entry_routine_ids[entry]);
+      dump_write_char(&writer, ',');
+      // Names are not looked up through the name resolver as it may not be async-signal-safe
+      dump_write_str(&writer, routines[entry].routine_name);
+      dump_write_char(&writer, ',');
+      dump_write_zu(&writer, routines[entry].caller_routine_id);
+      dump_write_char(&writer, ',');
+      dump_write_lld(&writer, reading->total_times_called);
+      dump_write_char(&writer, ',');
+      dump_write_lld(&writer, reading->total_real_us);
+      for (size_t idx = 0; idx < num_registered_events; idx++) {
+        dump_write_char(&writer, ',');
+        dump_write_lld(&writer, EVENT_TOTAL(&reading->events, sums, idx));
+      }
+      for (size_t counter = 0; counter < num_work_counters; counter++) {
+        dump_write_char(&writer, ',');
+        dump_write_lld(&writer, reading->total_work[counter]);
+      }
+      // Time spent so far in the invocation that has not ended yet. Left empty if the invocation is only counted, as
+      // its start time was not read.
+      dump_write_char(&writer, ',');
+      if (!start->measuring) {
+        dump_write_lld(&writer, 0);
+      } else if (start->sampled) {
+        dump_write_lld(&writer, now - start->start_real_us);
+      }
+      dump_write_char(&writer, '\n');
+    }
+  }
+
+  return dump_writer_flush(&writer) ? STOPWATCH_OK : STOPWATCH_ERR;
+}
+
+// =====================================================================================================================
+// Snapshots
+// =====================================================================================================================
+
+struct StopwatchSnapshot *stopwatch_snapshot() {
+  struct StopwatchSnapshot *snapshot = create_snapshot();
+  if (snapshot == NULL) {
+    return NULL;
+  }
+
+  // Sum the readings of every thread once rather than once per routine
+  pthread_mutex_lock(&stopwatch_lock);
+  unsigned int work_counters_used = 0;
+  for (const struct ThreadMeasurements *state = thread_list; state; state = state->next) {
+    work_counters_used |= state->work_counters_used;
+    for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+      struct MeasurementReadings *total = &snapshot->totals[entry];
+      total->total_times_called += state->readings[entry].total_times_called;
+      total->sampled_times_called += state->readings[entry].sampled_times_called;
+      total->migrated_times_called += state->readings[entry].migrated_times_called;
+      total->total_real_us += state->readings[entry].total_real_us;
+      total->sum_squared_real_us += state->readings[entry].sum_squared_real_us;
+      merge_event_totals(&total->events, &state->readings[entry].events, num_registered_events);
+      for (size_t idx = 0; idx < STOPWATCH_MAX_WORK_COUNTERS; idx++) {
+        total->total_work[idx] += state->readings[entry].total_work[idx];
+      }
+    }
+  }
+  snapshot->num_work_counters = num_reported_work_counters(work_counters_used);
+
+  // Names are only looked up for routines that are reported as looking up names through the resolver may be slow
+  memcpy(snapshot->routine_ids, entry_routine_ids, sizeof(entry_routine_ids));
+  for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+    snapshot->caller_routine_ids[entry] = routines[entry].caller_routine_id;
+    if (snapshot->totals[entry].total_times_called > 0) {
+      strncpy(snapshot->routine_names[entry], routine_name(entry), NULL_TERM_MAX_ROUTINE_NAME_LEN);
+      snapshot->routine_names[entry][NULL_TERM_MAX_ROUTINE_NAME_LEN - 1] = '\0';
+    }
+  }
+  pthread_mutex_unlock(&stopwatch_lock);
+
+  return snapshot;
+}
+
+struct StopwatchSnapshot *stopwatch_snapshot_diff(const struct StopwatchSnapshot *before,
+                                                  const struct StopwatchSnapshot *after) {
+  // Codes are only unique within a backend so the names are compared as well
+  if (before->num_events != after->num_events ||
+      memcmp(before->events, after->events, sizeof(int) * after->num_events) != 0 ||
+      memcmp(before->event_names, after->event_names, STOPWATCH_EVENT_NAME_LEN * after->num_events) != 0) {
+    return NULL;
+  }
+
+  struct StopwatchSnapshot *diff = calloc_cache_aligned(sizeof(struct StopwatchSnapshot));
+  if (diff == NULL) {
+    return NULL;
+  }
+  // Names and callers are taken from `after` as routines first measured in between only have them there
+  memcpy(diff, after, sizeof(struct StopwatchSnapshot));
+  // Smallest and largest values up to `after` may have been taken before `before`
+  diff->extremes_known = false;
+
+  for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+    struct MeasurementReadings *total = &diff->totals[entry];
+    total->total_times_called -= before->totals[entry].total_times_called;
+    total->sampled_times_called -= before->totals[entry].sampled_times_called;
+    total->migrated_times_called -= before->totals[entry].migrated_times_called;
+    total->total_real_us -= before->totals[entry].total_real_us;
+    total->sum_squared_real_us -= before->totals[entry].sum_squared_real_us;
+    subtract_event_totals(&total->events, &before->totals[entry].events, diff->num_events);
+    if (total->sampled_times_called == total->migrated_times_called) {
+      clear_event_totals(&total->events);
+    }
+    for (size_t idx = 0; idx < STOPWATCH_MAX_WORK_COUNTERS; idx++) {
+      total->total_work[idx] -= before->totals[entry].total_work[idx];
+    }
+  }
+  return diff;
+}
+
+void stopwatch_destroy_snapshot(struct StopwatchSnapshot *snapshot) {
+  free(snapshot);
+}
+
+enum StopwatchStatus stopwatch_snapshot_get_results(const struct StopwatchSnapshot *snapshot,
+                                                    size_t routine_id,
+                                                    struct StopwatchMeasurementResult *result) {
+  // Routines first seen after the snapshot was taken have an empty result there, as do routines that were never seen
+  const size_t entry = id_map_find(&routine_entries, routine_id);
+  const bool seen = entry != ID_MAP_NOT_FOUND && snapshot->routine_ids[entry] == routine_id;
+  const struct MeasurementReadings empty = {0};
+  const struct MeasurementReadings *total = seen ? &snapshot->totals[entry] : &empty;
+  report_totals(total,
+                snapshot->num_events,
+                &result->total_real_usec,
+                result->total_event_values,
+                &result->real_usec_error);
+  result->event_extremes_known = report_event_spread(total,
+                                                     snapshot->num_events,
+                                                     snapshot->extremes_known,
+                                                     result->min_event_values,
+                                                     result->max_event_values,
+                                                     result->sum_squared_event_values);
+  result->num_of_events = snapshot->num_events;
+  for (size_t idx = 0; idx < snapshot->num_events; idx++) {
+    result->event_names[idx] = snapshot->events[idx];
+  }
+  result->total_times_called = total->total_times_called;
+  result->sampled_times_called = total->sampled_times_called;
+  result->migrated_times_called = total->migrated_times_called;
+  memcpy(result->total_work, total->total_work, sizeof(result->total_work));
+  result->caller_routine_id = seen ? snapshot->caller_routine_ids[entry] : 0;
+  if (seen) {
+    memcpy(result->routine_name, snapshot->routine_names[entry], NULL_TERM_MAX_ROUTINE_NAME_LEN);
+  } else {
+    memset(result->routine_name, 0, NULL_TERM_MAX_ROUTINE_NAME_LEN);
+  }
+
+  return STOPWATCH_OK;
+}
+
+void stopwatch_print_snapshot_table(const struct StopwatchSnapshot *snapshot) {
+  // Generate table
+  const bool sampled = any_routine_sampled(snapshot);
+  // Additional 4 for id, name, times called and total usec, and 2 for the sampled calls and error if any are sampled
+  const size_t num_static_cols = sampled ? 6 : 4;
+  const size_t num_functions = find_num_entries(snapshot);
+  // Each event has its total followed by its smallest, largest and standard deviation further on
+  const size_t columns = 4 * snapshot->num_events + num_static_cols + num_work_columns(snapshot);
+  const size_t rows = num_functions + 1; // Extra row for header
+
+  struct StringTable *table = create_table(columns, rows, true, INDENT_SPACING);
+
+  set_header(table, snapshot, sampled);
+
+  if (num_functions > 0) {
+    struct FunctionNode *function_list = malloc(sizeof(struct FunctionNode) * num_functions);
+    size_t entry_num = 0;
+    for (size_t idx = 0; idx < STOPWATCH_MAX_FUNCTION_CALLS; idx++) {
+      if (snapshot->totals[idx].total_times_called == 0) {
+        continue;
+      }
+      function_list[entry_num].function_id = idx;
+      function_list[entry_num].caller_id = reported_caller(snapshot, idx);
       entry_num++;
     }
 
@@ -255,7 +1375,7 @@ void stopwatch_print_result_table() {
     while (function_call_tree_DF_iter_has_next(iter)) {
       const struct FunctionCallNode *next = function_call_tree_DF_iter_next(iter);
       // Subtract from stack depth as we want the stack depth relative to the call to main where main has a depth of 0
-      set_body_row(table, row_cursor, next->function_id, next->stack_depth - 1, readings[next->function_id]);
+      set_body_row(table, sampled, row_cursor, snapshot, next->function_id, next->stack_depth - 1);
       row_cursor++;
     }
 
@@ -274,7 +1394,7 @@ void stopwatch_print_result_table() {
   table = NULL;
 }
 
-enum StopwatchStatus stopwatch_result_to_csv(const char *file_name) {
+enum StopwatchStatus stopwatch_snapshot_to_csv(const struct StopwatchSnapshot *snapshot, const char *file_name) {
   FILE *output_file = fopen(file_name, "w+");
   if (output_file == NULL) {
     return STOPWATCH_INVALID_FILE;
@@ -282,27 +1402,80 @@ enum StopwatchStatus stopwatch_result_to_csv(const char *file_name) {
 
   // Write default header values
   fprintf(output_file, "%s,%s,%s,%s,%s", "ID", "NAME", "CALLER_ID", "TIMES_CALLED", "TOTAL_REAL_MICROSECONDS");
-  // Write each selected event
-  for (size_t idx = 0; idx < num_registered_events; idx++) {
-    char event_code_str[PAPI_MAX_STR_LEN];
-    PAPI_event_code_to_name(events[idx], event_code_str);
-    fprintf(output_file, ",%s", event_code_str);
+  // Only files with sampled routines flag them, so that the columns of other files stay the same
+  const bool sampled = any_routine_sampled(snapshot);
+  if (sampled) {
+    fprintf(output_file, ",%s,%s", "SAMPLED_TIMES_CALLED", "REAL_MICROSECONDS_ERROR");
+  }
+  // Write each selected event, followed by the spread of each over single invocations
+  for (size_t idx = 0; idx < snapshot->num_events; idx++) {
+    fprintf(output_file, ",%s", snapshot->event_names[idx]);
+  }
+  for (size_t idx = 0; idx < snapshot->num_events; idx++) {
+    const char *name = snapshot->event_names[idx];
+    fprintf(output_file, ",%s_MIN,%s_MAX,%s_STDDEV", name, name, name);
+  }
+  // Write each reported work counter along with the rates derived from it
+  for (size_t counter = 0; counter < snapshot->num_work_counters; counter++) {
+    const char *name = snapshot->work_names[counter];
+    fprintf(output_file, ",%s,%s_PER_SECOND,NANOSECONDS_PER_%s", name, name, name);
+    for (size_t idx = 0; idx < snapshot->num_events; idx++) {
+      fprintf(output_file, ",%s_PER_%s", snapshot->event_names[idx], name);
+    }
   }
   // New line
   fprintf(output_file, "\n");
 
   // Write contents
   for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
-    if (readings[entry].total_times_called > 0) {
+    const struct MeasurementReadings *total = &snapshot->totals[entry];
+    if (total->total_times_called > 0) {
+      long long real_us;
+      long long events_measurements[STOPWATCH_MAX_EVENTS];
+      double real_us_error;
+      report_totals(total, snapshot->num_events, &real_us, events_measurements, &real_us_error);
       fprintf(output_file,
               "%zu,%s,%zu,%lld,%lld",
-              entry,
-              readings[entry].routine_name,
-              readings[entry].caller_routine_id,
-              readings[entry].total_times_called,
-              readings[entry].total_real_us);
-      for(size_t idx = 0; idx < num_registered_events; idx++) {
-        fprintf(output_file, ",%lld", readings[entry].total_events_measurements[idx]);
+              snapshot->routine_ids[entry],
+              snapshot->routine_names[entry],
+              snapshot->caller_routine_ids[entry],
+              total->total_times_called,
+              real_us);
+      if (sampled) {
+        fprintf(output_file, ",%lld,%.0f", total->sampled_times_called, real_us_error);
+      }
+      for(size_t idx = 0; idx < snapshot->num_events; idx++) {
+        fprintf(output_file, ",%lld", events_measurements[idx]);
+      }
+      // Routines whose events were never measured leave the spread empty, and differences of snapshots the extremes
+      for (size_t idx = 0; idx < snapshot->num_events; idx++) {
+        if (total->sampled_times_called > total->migrated_times_called && snapshot->extremes_known) {
+          fprintf(output_file,
+                  ",%lld,%lld,%.0f",
+                  EVENT_TOTAL(&total->events, mins, idx),
+                  EVENT_TOTAL(&total->events, maxs, idx),
+                  event_stddev(total, idx));
+        } else if (total->sampled_times_called > total->migrated_times_called) {
+          fprintf(output_file, ",,,%.0f", event_stddev(total, idx));
+        } else {
+          fprintf(output_file, ",,,");
+        }
+      }
+      // Rates of routines that did no work are left empty
+      for (size_t counter = 0; counter < snapshot->num_work_counters; counter++) {
+        struct WorkRates rates;
+        fprintf(output_file, ",%lld", total->total_work[counter]);
+        if (work_rates(total->total_work[counter], real_us, events_measurements, snapshot->num_events, &rates)) {
+          fprintf(output_file, ",%g,%g", rates.per_second, rates.nsec_per_unit);
+          for (size_t idx = 0; idx < snapshot->num_events; idx++) {
+            fprintf(output_file, ",%g", rates.events_per_unit[idx]);
+          }
+        } else {
+          fprintf(output_file, ",,");
+          for (size_t idx = 0; idx < snapshot->num_events; idx++) {
+            fprintf(output_file, ",");
+          }
+        }
       }
       fprintf(output_file, "\n");
     }
@@ -311,110 +1484,1660 @@ enum StopwatchStatus stopwatch_result_to_csv(const char *file_name) {
   return STOPWATCH_OK;
 }
 
-// =====================================================================================================================
-// Private helper functions implementation
-// =====================================================================================================================
-static enum StopwatchStatus set_events() {
-  enum StopwatchStatus ret_val;
-  const char *event_env_val = getenv("STOPWATCH_EVENTS");
-  // For if the environment variable exists
-  if (event_env_val) {
-    // A copy is made as strtok_r mutates the arguments
-    char *env_var_copy_elem = strdup(event_env_val); // Copy of the env var for use to parse each element
-    char *delimiter = ",";
-    char *save_ptr;
+void stopwatch_reset() {
+  pthread_mutex_lock(&stopwatch_lock);
+  for (struct ThreadMeasurements *state = thread_list; state; state = state->next) {
+    for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+      struct MeasurementReadings *reading = &state->readings[entry];
+      // Start values are kept so that routines being measured still end normally
+      reading->total_times_called = 0;
+      reading->sampled_times_called = 0;
+      reading->migrated_times_called = 0;
+      reading->total_real_us = 0;
+      reading->sum_squared_real_us = 0;
+      clear_event_totals(&reading->events);
+      memset(reading->total_work, 0, sizeof(reading->total_work));
+      destroy_series(state->metadata[entry].series);
+      state->metadata[entry].series = NULL;
+      destroy_slowest(state->metadata[entry].slowest);
+      state->metadata[entry].slowest = NULL;
+    }
+    if (state->shm_thread) {
+      shm_thread_clear(state->shm_thread);
+    }
+  }
+  pthread_mutex_unlock(&stopwatch_lock);
+}
 
-    for (char *token = strtok_r(env_var_copy_elem, delimiter, &save_ptr); token != NULL;
-         token = strtok_r(NULL, delimiter, &save_ptr)) {
-      ret_val = add_event(token);
-      if (ret_val != STOPWATCH_OK) {
-        break;
+enum StopwatchStatus stopwatch_series_to_csv(const char *file_name) {
+  FILE *output_file = fopen(file_name, "w+");
+  if (output_file == NULL) {
+    return STOPWATCH_INVALID_FILE;
+  }
+
+  fprintf(output_file, "%s,%s,%s,%s,%s", "THREAD", "ID", "NAME", "INVOCATION", "REAL_MICROSECONDS");
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    fprintf(output_file, ",%s", event_infos[idx].name);
+  }
+  fprintf(output_file, "\n");
+
+  pthread_mutex_lock(&stopwatch_lock);
+  for (const struct ThreadMeasurements *state = thread_list; state; state = state->next) {
+    for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+      const struct Series *series = state->metadata[entry].series;
+      if (series == NULL) {
+        continue;
       }
-    }
-    free(env_var_copy_elem);
-    env_var_copy_elem = NULL;
-  } else { // For if the environment variable does not exist
-    const char *default_events[] = {"PAPI_TOT_CYC", "PAPI_TOT_INS"};
-    for (size_t idx = 0; idx < sizeof(default_events) / sizeof(char *); idx++) {
-      ret_val = add_event(default_events[idx]);
-      if (ret_val != STOPWATCH_OK) {
-        break;
+
+      struct SeriesIter iter;
+      series_iter_init(&iter, series);
+      for (size_t sample = 0; series_iter_has_next(&iter); sample++) {
+        const long long *values = series_iter_next(&iter);
+        fprintf(output_file,
+                "%zu,%zu,%s,%lld",
+                state->thread_index,
+                entry_routine_ids[entry],
+                routine_name(entry),
+                series_sample_invocation(series, sample));
+        for (size_t idx = 0; idx < series->num_values; idx++) {
+          fprintf(output_file, ",%lld", values[idx]);
+        }
+        fprintf(output_file, "\n");
       }
     }
   }
-  return ret_val;
+  pthread_mutex_unlock(&stopwatch_lock);
+
+  fclose(output_file);
+  return STOPWATCH_OK;
 }
 
-static enum StopwatchStatus add_event(const char *event_to_add) {
-  // Prevent adding more events than maximum
-  if (num_registered_events >= STOPWATCH_MAX_EVENTS) {
-    return STOPWATCH_TOO_MANY_EVENTS;
+// =====================================================================================================================
+// Slowest invocations
+// =====================================================================================================================
+
+size_t stopwatch_get_slowest(size_t routine_id, struct StopwatchInvocation *invocations, size_t max_invocations) {
+  const size_t entry = id_map_find(&routine_entries, routine_id);
+  if (entry == ID_MAP_NOT_FOUND || num_slowest_kept == 0) {
+    return 0;
   }
-  int event_code = PAPI_NULL;
 
-  // Attempt to convert string to valid event code
-  if (PAPI_event_name_to_code(event_to_add, &event_code) != PAPI_OK) {
-    return STOPWATCH_INVALID_EVENT;
+  // The slowest over all threads are among the slowest of each thread
+  struct SlowestInvocations *merged = create_slowest(num_slowest_kept);
+  if (merged == NULL) {
+    return 0;
+  }
+  pthread_mutex_lock(&stopwatch_lock);
+  for (const struct ThreadMeasurements *state = thread_list; state; state = state->next) {
+    const struct SlowestInvocations *slowest = state->metadata[entry].slowest;
+    for (size_t idx = 0; slowest && idx < slowest->size; idx++) {
+      slowest_record(merged, &slowest->invocations[idx]);
+    }
   }
+  pthread_mutex_unlock(&stopwatch_lock);
 
-  // Attempt to add event code
-  if (PAPI_add_event(event_set, event_code) != PAPI_OK) {
-    return STOPWATCH_INVALID_EVENT_COMB;
+  struct StopwatchInvocation sorted[STOPWATCH_MAX_SLOWEST];
+  size_t num_invocations = slowest_sorted(merged, sorted);
+  destroy_slowest(merged);
+  if (num_invocations > max_invocations) {
+    num_invocations = max_invocations;
   }
-  events[num_registered_events] = event_code;
-  num_registered_events++;
+  memcpy(invocations, sorted, sizeof(struct StopwatchInvocation) * num_invocations);
+  return num_invocations;
+}
 
-  return STOPWATCH_OK;
+void stopwatch_print_slowest_table() {
+  if (num_slowest_kept == 0) {
+    return;
+  }
+
+  struct StopwatchInvocation *invocations =
+      malloc(sizeof(struct StopwatchInvocation) * STOPWATCH_MAX_FUNCTION_CALLS * num_slowest_kept);
+  if (invocations == NULL) {
+    return;
+  }
+  size_t num_invocations = 0;
+  const size_t num_entries = __atomic_load_n(&num_routine_entries, __ATOMIC_ACQUIRE);
+  for (size_t entry = 0; entry < num_entries; entry++) {
+    num_invocations += stopwatch_get_slowest(entry_routine_ids[entry], invocations + num_invocations, num_slowest_kept);
+  }
+
+  // Additional 7 for id, name, thread, start, real usec, caller id and caller start
+  const size_t num_static_cols = 7;
+  struct StringTable *table = create_table(num_registered_events + num_static_cols, num_invocations + 1, true, INDENT_SPACING);
+  add_entry_str(table, "ID", (struct StringTableCellPos) {0, 0});
+  add_entry_str(table, "NAME", (struct StringTableCellPos) {0, 1});
+  add_entry_str(table, "THREAD", (struct StringTableCellPos) {0, 2});
+  add_entry_str(table, "START MICROSECONDS", (struct StringTableCellPos) {0, 3});
+  add_entry_str(table, "REAL MICROSECONDS", (struct StringTableCellPos) {0, 4});
+  add_entry_str(table, "CALLER ID", (struct StringTableCellPos) {0, 5});
+  add_entry_str(table, "CALLER START MICROSECONDS", (struct StringTableCellPos) {0, 6});
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    add_entry_str(table, event_infos[idx].name, (struct StringTableCellPos) {0, num_static_cols + idx});
+  }
+  for (size_t row = 0; row < num_invocations; row++) {
+    print_slowest_invocation_row(table, row + 1, &invocations[row]);
+  }
+
+  char *table_str = make_table_str(table);
+  printf("Slowest invocations\n%s\n", table_str);
+  free(table_str);
+  destroy_table(table);
+  free(invocations);
 }
 
-static size_t find_num_entries() {
-  size_t entries = 0;
-  for (size_t idx = 0; idx < STOPWATCH_MAX_FUNCTION_CALLS; idx++) {
-    if (readings[idx].total_times_called > 0) {
-      entries++;
+enum StopwatchStatus stopwatch_slowest_to_csv(const char *file_name) {
+  FILE *output_file = fopen(file_name, "w+");
+  if (output_file == NULL) {
+    return STOPWATCH_INVALID_FILE;
+  }
+
+  fprintf(output_file,
+          "%s,%s,%s,%s,%s,%s,%s",
+          "ID",
+          "NAME",
+          "THREAD",
+          "START_MICROSECONDS",
+          "REAL_MICROSECONDS",
+          "CALLER_ID",
+          "CALLER_START_MICROSECONDS");
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    fprintf(output_file, ",%s", event_infos[idx].name);
+  }
+  fprintf(output_file, "\n");
+
+  struct StopwatchInvocation invocations[STOPWATCH_MAX_SLOWEST];
+  const size_t num_entries = __atomic_load_n(&num_routine_entries, __ATOMIC_ACQUIRE);
+  for (size_t entry = 0; entry < num_entries; entry++) {
+    const size_t num_invocations = stopwatch_get_slowest(entry_routine_ids[entry], invocations, STOPWATCH_MAX_SLOWEST);
+    for (size_t row = 0; row < num_invocations; row++) {
+      const struct StopwatchInvocation *invocation = &invocations[row];
+      fprintf(output_file,
+              "%zu,%s,%zu,%lld,%lld,%zu,%lld",
+              invocation->routine_id,
+              routine_name(entry_or_main(invocation->routine_id)),
+              invocation->thread_index,
+              invocation->start_usec,
+              invocation->real_usec,
+              invocation->caller_routine_id,
+              invocation->caller_start_usec);
+      for (size_t idx = 0; idx < num_registered_events; idx++) {
+        fprintf(output_file, ",%lld", invocation->event_values[idx]);
+      }
+      fprintf(output_file, "\n");
     }
   }
-  return entries;
+
+  fclose(output_file);
+  return STOPWATCH_OK;
 }
 
-static void set_header(const struct StringTable *table) {
-  // Default table header entries
+// =====================================================================================================================
+// Overhead budget
+// =====================================================================================================================
+
+size_t stopwatch_get_throttle_decisions(struct StopwatchThrottleDecision *decisions, size_t max_decisions) {
+  pthread_mutex_lock(&stopwatch_lock);
+  const size_t num_decisions = num_throttle_decisions < max_decisions ? num_throttle_decisions : max_decisions;
+  memcpy(decisions, throttle_decisions, sizeof(struct StopwatchThrottleDecision) * num_decisions);
+  pthread_mutex_unlock(&stopwatch_lock);
+  return num_decisions;
+}
+
+void stopwatch_print_throttle_table() {
+  struct StopwatchThrottleDecision *decisions = malloc(sizeof(throttle_decisions));
+  if (decisions == NULL) {
+    return;
+  }
+  const size_t num_decisions = stopwatch_get_throttle_decisions(decisions, MAX_THROTTLE_DECISIONS);
+  if (num_decisions == 0) {
+    free(decisions);
+    return;
+  }
+
+  // Additional 8 for id, name, thread, time, throttling, interval, mean nanoseconds and overhead
+  const size_t num_cols = 8;
+  struct StringTable *table = create_table(num_cols, num_decisions + 1, true, INDENT_SPACING);
   add_entry_str(table, "ID", (struct StringTableCellPos) {0, 0});
   add_entry_str(table, "NAME", (struct StringTableCellPos) {0, 1});
-  add_entry_str(table, "TIMES CALLED", (struct StringTableCellPos) {0, 2});
-  add_entry_str(table, "TOTAL REAL MICROSECONDS", (struct StringTableCellPos) {0, 3});
+  add_entry_str(table, "THREAD", (struct StringTableCellPos) {0, 2});
+  add_entry_str(table, "TIME MICROSECONDS", (struct StringTableCellPos) {0, 3});
+  add_entry_str(table, "THROTTLED TO", (struct StringTableCellPos) {0, 4});
+  add_entry_str(table, "SAMPLING INTERVAL", (struct StringTableCellPos) {0, 5});
+  add_entry_str(table, "MEAN REAL NANOSECONDS", (struct StringTableCellPos) {0, 6});
+  add_entry_str(table, "OVERHEAD PERCENT", (struct StringTableCellPos) {0, 7});
+  for (size_t row = 0; row < num_decisions; row++) {
+    const struct StopwatchThrottleDecision *decision = &decisions[row];
+    const size_t row_num = row + 1;
+    char overhead_str[32];
+    snprintf(overhead_str, sizeof(overhead_str), "%.1f", 100 * decision->overhead);
+    add_entry_zu(table, decision->routine_id, (struct StringTableCellPos) {row_num, 0});
+    add_entry_str(table, routine_name(entry_or_main(decision->routine_id)), (struct StringTableCellPos) {row_num, 1});
+    add_entry_lld(table, (long long) decision->thread_index, (struct StringTableCellPos) {row_num, 2});
+    add_entry_lld(table, decision->time_usec, (struct StringTableCellPos) {row_num, 3});
+    add_entry_str(table, throttling_name(decision->throttling), (struct StringTableCellPos) {row_num, 4});
+    if (decision->throttling == STOPWATCH_THROTTLE_SAMPLED) {
+      add_entry_lld(table, (long long) decision->sampling_interval, (struct StringTableCellPos) {row_num, 5});
+    } else {
+      add_entry_str(table, "", (struct StringTableCellPos) {row_num, 5});
+    }
+    add_entry_lld(table, llround(decision->mean_real_nsec), (struct StringTableCellPos) {row_num, 6});
+    add_entry_str(table, overhead_str, (struct StringTableCellPos) {row_num, 7});
+  }
 
-  // Header entries for each measurement event
-  for (unsigned int entry_idx = 0; entry_idx < num_registered_events; entry_idx++) {
-    const size_t num_columns = table->width;
-    const unsigned int effective_col_idx = num_columns - num_registered_events + entry_idx;
+  char *table_str = make_table_str(table);
+  printf("Throttled by the overhead budget of %g%%\n%s\n", 100 * overhead_budget, table_str);
+  free(table_str);
+  destroy_table(table);
+  free(decisions);
+}
+
+enum StopwatchStatus stopwatch_throttle_decisions_to_csv(const char *file_name) {
+  FILE *output_file = fopen(file_name, "w+");
+  if (output_file == NULL) {
+    return STOPWATCH_INVALID_FILE;
+  }
 
-    char event_code_string[PAPI_MAX_STR_LEN];
-    PAPI_event_code_to_name(events[entry_idx], event_code_string);
-    add_entry_str(table, event_code_string, (struct StringTableCellPos) {0, effective_col_idx});
+  fprintf(output_file,
+          "%s,%s,%s,%s,%s,%s,%s,%s\n",
+          "ID",
+          "NAME",
+          "THREAD",
+          "TIME_MICROSECONDS",
+          "THROTTLED_TO",
+          "SAMPLING_INTERVAL",
+          "MEAN_REAL_NANOSECONDS",
+          "OVERHEAD");
+
+  pthread_mutex_lock(&stopwatch_lock);
+  for (size_t row = 0; row < num_throttle_decisions; row++) {
+    const struct StopwatchThrottleDecision *decision = &throttle_decisions[row];
+    fprintf(output_file,
+            "%zu,%s,%zu,%lld,%s,%zu,%.0f,%g\n",
+            decision->routine_id,
+            routine_name(entry_or_main(decision->routine_id)),
+            decision->thread_index,
+            decision->time_usec,
+            throttling_name(decision->throttling),
+            decision->sampling_interval,
+            decision->mean_real_nsec,
+            decision->overhead);
   }
+  pthread_mutex_unlock(&stopwatch_lock);
+
+  fclose(output_file);
+  return STOPWATCH_OK;
 }
 
-static void set_body_row(const struct StringTable *table,
-                         size_t row_num,
-                         size_t routine_id,
-                         size_t stack_depth,
-                         struct MeasurementReadings reading) {
-  // Default table row measurement values
-  // All routine_id should be able to fit in long long without any overflow
-  add_entry_lld(table, (long long) routine_id, (struct StringTableCellPos) {row_num, 0});
-  add_entry_str(table, reading.routine_name, (struct StringTableCellPos) {row_num, 1});
-  set_indent_lvl(table, stack_depth, (struct StringTableCellPos) {row_num, 1});
+// =====================================================================================================================
+// Load imbalance
+// =====================================================================================================================
+
+enum StopwatchStatus stopwatch_get_imbalance(size_t routine_id, struct StopwatchImbalance *imbalance) {
+  memset(imbalance, 0, sizeof(struct StopwatchImbalance));
+  imbalance->routine_id = routine_id;
+  const size_t entry = id_map_find(&routine_entries, routine_id);
+  pthread_mutex_lock(&stopwatch_lock);
+  for (const struct ThreadMeasurements *state = thread_list; entry != ID_MAP_NOT_FOUND && state; state = state->next) {
+    const struct MeasurementReadings *reading = &state->readings[entry];
+    if (reading->total_times_called == 0) {
+      continue;
+    }
+    long long real_us;
+    long long events_measurements[STOPWATCH_MAX_EVENTS];
+    double real_us_error;
+    report_totals(reading, num_registered_events, &real_us, events_measurements, &real_us_error);
+    add_to_imbalance(imbalance, state->thread_index, real_us, events_measurements);
+  }
+  pthread_mutex_unlock(&stopwatch_lock);
+
+  if (imbalance->num_threads > 0) {
+    imbalance->avg_real_usec /= (double) imbalance->num_threads;
+    for (size_t idx = 0; idx < num_registered_events; idx++) {
+      imbalance->avg_event_values[idx] /= (double) imbalance->num_threads;
+    }
+  }
+  if (imbalance->max_real_usec > 0) {
+    imbalance->imbalance =
+        ((double) imbalance->max_real_usec - imbalance->avg_real_usec) / (double) imbalance->max_real_usec;
+  }
+  return STOPWATCH_OK;
+}
 
-  add_entry_lld(table, reading.total_times_called, (struct StringTableCellPos) {row_num, 2});
-  add_entry_lld(table, reading.total_real_us, (struct StringTableCellPos) {row_num, 3});
+void stopwatch_print_imbalance_table() {
+  struct StopwatchImbalance *imbalances = malloc(sizeof(struct StopwatchImbalance) * STOPWATCH_MAX_FUNCTION_CALLS);
+  if (imbalances == NULL) {
+    return;
+  }
+  const size_t num_imbalances = find_imbalances(imbalances);
+  if (num_imbalances == 0) {
+    free(imbalances);
+    return;
+  }
+  qsort(imbalances, num_imbalances, sizeof(struct StopwatchImbalance), compare_most_imbalanced_first);
 
-  // Event specific table row measurement values
-  for (size_t entry_idx = 0; entry_idx < num_registered_events; entry_idx++) {
-    const size_t columns = table->width;
-    const size_t effective_col_idx = columns - num_registered_events + entry_idx;
-    add_entry_lld(table,
-                  reading.total_events_measurements[entry_idx],
-                  (struct StringTableCellPos) {row_num, effective_col_idx});
+  // Additional 8 for id, name, threads, min, avg and max real usec, imbalance and slowest thread, then min, avg and max
+  // of every event
+  const size_t num_static_cols = 8;
+  struct StringTable *table =
+      create_table(num_static_cols + 3 * num_registered_events, num_imbalances + 1, true, INDENT_SPACING);
+  add_entry_str(table, "ID", (struct StringTableCellPos) {0, 0});
+  add_entry_str(table, "NAME", (struct StringTableCellPos) {0, 1});
+  add_entry_str(table, "THREADS", (struct StringTableCellPos) {0, 2});
+  add_entry_str(table, "MIN REAL MICROSECONDS", (struct StringTableCellPos) {0, 3});
+  add_entry_str(table, "AVG REAL MICROSECONDS", (struct StringTableCellPos) {0, 4});
+  add_entry_str(table, "MAX REAL MICROSECONDS", (struct StringTableCellPos) {0, 5});
+  add_entry_str(table, "IMBALANCE PERCENT", (struct StringTableCellPos) {0, 6});
+  add_entry_str(table, "SLOWEST THREAD", (struct StringTableCellPos) {0, 7});
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    char header[STOPWATCH_EVENT_NAME_LEN + 8];
+    snprintf(header, sizeof(header), "MIN %s", event_infos[idx].name);
+    add_entry_str(table, header, (struct StringTableCellPos) {0, num_static_cols + 3 * idx});
+    snprintf(header, sizeof(header), "AVG %s", event_infos[idx].name);
+    add_entry_str(table, header, (struct StringTableCellPos) {0, num_static_cols + 3 * idx + 1});
+    snprintf(header, sizeof(header), "MAX %s", event_infos[idx].name);
+    add_entry_str(table, header, (struct StringTableCellPos) {0, num_static_cols + 3 * idx + 2});
   }
+  for (size_t row = 0; row < num_imbalances; row++) {
+    const struct StopwatchImbalance *imbalance = &imbalances[row];
+    const size_t row_num = row + 1;
+    char imbalance_str[32];
+    snprintf(imbalance_str, sizeof(imbalance_str), "%.1f", 100 * imbalance->imbalance);
+    add_entry_zu(table, imbalance->routine_id, (struct StringTableCellPos) {row_num, 0});
+    add_entry_str(table, routine_name(entry_or_main(imbalance->routine_id)), (struct StringTableCellPos) {row_num, 1});
+    add_entry_lld(table, (long long) imbalance->num_threads, (struct StringTableCellPos) {row_num, 2});
+    add_entry_lld(table, imbalance->min_real_usec, (struct StringTableCellPos) {row_num, 3});
+    add_entry_lld(table, llround(imbalance->avg_real_usec), (struct StringTableCellPos) {row_num, 4});
+    add_entry_lld(table, imbalance->max_real_usec, (struct StringTableCellPos) {row_num, 5});
+    add_entry_str(table, imbalance_str, (struct StringTableCellPos) {row_num, 6});
+    add_entry_lld(table, (long long) imbalance->slowest_thread_index, (struct StringTableCellPos) {row_num, 7});
+    for (size_t idx = 0; idx < num_registered_events; idx++) {
+      const size_t col = num_static_cols + 3 * idx;
+      add_entry_lld(table, imbalance->min_event_values[idx], (struct StringTableCellPos) {row_num, col});
+      add_entry_lld(table, llround(imbalance->avg_event_values[idx]), (struct StringTableCellPos) {row_num, col + 1});
+      add_entry_lld(table, imbalance->max_event_values[idx], (struct StringTableCellPos) {row_num, col + 2});
+    }
+  }
+
+  char *table_str = make_table_str(table);
+  printf("Load imbalance over threads\n%s\n", table_str);
+  free(table_str);
+  destroy_table(table);
+  free(imbalances);
+}
+
+enum StopwatchStatus stopwatch_imbalance_to_csv(const char *file_name) {
+  FILE *output_file = fopen(file_name, "w+");
+  if (output_file == NULL) {
+    return STOPWATCH_INVALID_FILE;
+  }
+  struct StopwatchImbalance *imbalances = malloc(sizeof(struct StopwatchImbalance) * STOPWATCH_MAX_FUNCTION_CALLS);
+  if (imbalances == NULL) {
+    fclose(output_file);
+    return STOPWATCH_ERR;
+  }
+
+  fprintf(output_file,
+          "%s,%s,%s,%s,%s,%s,%s,%s",
+          "ID",
+          "NAME",
+          "THREADS",
+          "MIN_REAL_MICROSECONDS",
+          "AVG_REAL_MICROSECONDS",
+          "MAX_REAL_MICROSECONDS",
+          "IMBALANCE",
+          "SLOWEST_THREAD");
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    fprintf(output_file,
+            ",MIN_%s,AVG_%s,MAX_%s",
+            event_infos[idx].name,
+            event_infos[idx].name,
+            event_infos[idx].name);
+  }
+  fprintf(output_file, "\n");
+
+  const size_t num_imbalances = find_imbalances(imbalances);
+  for (size_t row = 0; row < num_imbalances; row++) {
+    const struct StopwatchImbalance *imbalance = &imbalances[row];
+    fprintf(output_file,
+            "%zu,%s,%zu,%lld,%.1f,%lld,%g,%zu",
+            imbalance->routine_id,
+            routine_name(entry_or_main(imbalance->routine_id)),
+            imbalance->num_threads,
+            imbalance->min_real_usec,
+            imbalance->avg_real_usec,
+            imbalance->max_real_usec,
+            imbalance->imbalance,
+            imbalance->slowest_thread_index);
+    for (size_t idx = 0; idx < num_registered_events; idx++) {
+      fprintf(output_file,
+              ",%lld,%.1f,%lld",
+              imbalance->min_event_values[idx],
+              imbalance->avg_event_values[idx],
+              imbalance->max_event_values[idx]);
+    }
+    fprintf(output_file, "\n");
+  }
+
+  free(imbalances);
+  fclose(output_file);
+  return STOPWATCH_OK;
+}
+
+// =====================================================================================================================
+// Private helper functions implementation
+// =====================================================================================================================
+// Initializes `candidate`, registers its events and creates the counters of the initializing thread, which starts its
+// monotonic clock and checks that the events can be measured together. Other threads create the same counters once they
+// first measure. On failure the backend is shut down again, so that another one can be tried.
+static enum StopwatchStatus start_backend(const struct CounterBackend *candidate, void **counters) {
+  backend = candidate;
+  num_registered_events = 0;
+  enum StopwatchStatus ret_val = backend->init() ? set_events() : STOPWATCH_ERR;
+  num_counter_events = num_registered_events;
+  if (ret_val == STOPWATCH_OK) {
+    ret_val = backend->create_counters(event_infos, num_counter_events, counters);
+  }
+  if (ret_val != STOPWATCH_OK) {
+    backend->shutdown();
+    backend = NULL;
+    *counters = NULL;
+  }
+  return ret_val;
+}
+
+static enum StopwatchStatus set_events() {
+  enum StopwatchStatus ret_val = STOPWATCH_OK;
+  const char *event_env_val = getenv("STOPWATCH_EVENTS");
+  // For if the environment variable exists
+  if (event_env_val) {
+    // A copy is made as strtok_r mutates the arguments
+    char *env_var_copy_elem = strdup(event_env_val); // Copy of the env var for use to parse each element
+    char *delimiter = ",";
+    char *save_ptr;
+
+    for (char *token = strtok_r(env_var_copy_elem, delimiter, &save_ptr); token != NULL;
+         token = strtok_r(NULL, delimiter, &save_ptr)) {
+      ret_val = add_event(token);
+      if (ret_val != STOPWATCH_OK) {
+        break;
+      }
+    }
+    free(env_var_copy_elem);
+    env_var_copy_elem = NULL;
+  } else { // For if the environment variable does not exist
+    for (const char *const *default_event = backend->default_events; *default_event; default_event++) {
+      ret_val = add_event(*default_event);
+      if (ret_val != STOPWATCH_OK) {
+        break;
+      }
+    }
+  }
+  return ret_val;
+}
+
+static enum StopwatchStatus add_event(const char *event_to_add) {
+  // Prevent adding more events than maximum
+  if (num_registered_events >= STOPWATCH_MAX_EVENTS) {
+    return STOPWATCH_TOO_MANY_EVENTS;
+  }
+
+  // Attempt to find the event. Whether it can be measured along with the other events is only known once counters are
+  // created.
+  enum StopwatchStatus ret_val = backend->find_event(event_to_add, &event_infos[num_registered_events]);
+  if (ret_val != STOPWATCH_OK) {
+    return ret_val;
+  }
+  num_registered_events++;
+
+  return STOPWATCH_OK;
+}
+
+// Adds the metrics listed in the environment variable `env_var`, or every metric if it is `all`
+static enum StopwatchStatus set_metrics(const char *env_var,
+                                        enum StopwatchStatus (*find_metric)(const char *, struct StopwatchEventInfo *),
+                                        const char *(*metric_name)(size_t)) {
+  const char *metrics_env_val = getenv(env_var);
+  if (metrics_env_val == NULL) {
+    return STOPWATCH_OK;
+  }
+
+  enum StopwatchStatus ret_val = STOPWATCH_OK;
+  if (strcmp(metrics_env_val, "all") == 0) {
+    for (size_t idx = 0; ret_val == STOPWATCH_OK && metric_name(idx); idx++) {
+      ret_val = add_metric(metric_name(idx), find_metric);
+    }
+    return ret_val;
+  }
+
+  // A copy is made as strtok_r mutates the arguments
+  char *env_var_copy_elem = strdup(metrics_env_val);
+  if (env_var_copy_elem == NULL) {
+    return STOPWATCH_ERR;
+  }
+  char *save_ptr;
+  for (char *token = strtok_r(env_var_copy_elem, ",", &save_ptr); token != NULL && ret_val == STOPWATCH_OK;
+       token = strtok_r(NULL, ",", &save_ptr)) {
+    ret_val = add_metric(token, find_metric);
+  }
+  free(env_var_copy_elem);
+  return ret_val;
+}
+
+// Same as `add_event` for the metrics that are not counted by the backend, which share the slots of the events
+static enum StopwatchStatus add_metric(const char *metric_to_add,
+                                       enum StopwatchStatus (*find_metric)(const char *, struct StopwatchEventInfo *)) {
+  if (num_registered_events >= STOPWATCH_MAX_EVENTS) {
+    return STOPWATCH_TOO_MANY_EVENTS;
+  }
+  enum StopwatchStatus ret_val = find_metric(metric_to_add, &event_infos[num_registered_events]);
+  if (ret_val != STOPWATCH_OK) {
+    return ret_val;
+  }
+  num_registered_events++;
+  return STOPWATCH_OK;
+}
+
+// Allocation metrics can only be measured if one of the stopwatch_alloc libraries counts the allocations
+static enum StopwatchStatus set_alloc_metrics() {
+  const size_t num_events_before = num_registered_events;
+  enum StopwatchStatus ret_val = set_metrics("STOPWATCH_ALLOC_METRICS", find_alloc_metric, alloc_metric_name);
+  if (ret_val != STOPWATCH_OK || num_registered_events == num_events_before) {
+    return ret_val;
+  }
+  alloc_counters_getter = find_alloc_counters_getter();
+  return alloc_counters_getter ? STOPWATCH_OK : STOPWATCH_INVALID_EVENT;
+}
+
+// I/O metrics can only be measured if one of the stopwatch_io libraries counts the I/O
+static enum StopwatchStatus set_io_metrics() {
+  const size_t num_events_before = num_registered_events;
+  enum StopwatchStatus ret_val = set_metrics("STOPWATCH_IO_METRICS", find_io_metric, io_metric_name);
+  if (ret_val != STOPWATCH_OK || num_registered_events == num_events_before) {
+    return ret_val;
+  }
+  io_counters_getter = find_io_counters_getter();
+  return io_counters_getter ? STOPWATCH_OK : STOPWATCH_INVALID_EVENT;
+}
+
+// Lowers the peak live bytes of the thread to its live bytes, so that the peak read at the end is the growth within
+// the routine
+static void begin_alloc_region(struct ThreadMeasurements *state, struct StartReadings *start) {
+  start->start_peak_live_bytes = state->alloc_counters->peak_live_bytes;
+  state->alloc_counters->peak_live_bytes = state->alloc_counters->live_bytes;
+}
+
+static void end_alloc_region(struct ThreadMeasurements *state, const struct StartReadings *start) {
+  if (start->start_peak_live_bytes > state->alloc_counters->peak_live_bytes) {
+    state->alloc_counters->peak_live_bytes = start->start_peak_live_bytes;
+  }
+}
+
+// Reads the events counted by the backend followed by the operating system, allocation and I/O metrics
+static bool read_events(const struct ThreadMeasurements *state, long long *values) {
+  if (!backend->read_counters(state->counters, values)) {
+    return false;
+  }
+  if (num_os_metric_events > 0 &&
+      !read_os_metrics(&event_infos[num_counter_events], num_os_metric_events, values + num_counter_events)) {
+    return false;
+  }
+  const size_t alloc_metrics_idx = num_counter_events + num_os_metric_events;
+  if (state->alloc_counters) {
+    read_alloc_metrics(state->alloc_counters,
+                       &event_infos[alloc_metrics_idx],
+                       num_alloc_metric_events,
+                       values + alloc_metrics_idx);
+  }
+  const size_t io_metrics_idx = alloc_metrics_idx + num_alloc_metric_events;
+  if (state->io_counters) {
+    read_io_metrics(state->io_counters,
+                    &event_infos[io_metrics_idx],
+                    num_registered_events - io_metrics_idx,
+                    values + io_metrics_idx);
+  }
+  return true;
+}
+
+// Name of a measured event from its code. Results may outlive the events they were measured with i.e. across
+// re-initializing, in which case the code is all that is known.
+static const char *registered_event_name(int event_code) {
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    if (event_infos[idx].code == event_code) {
+      return event_infos[idx].name;
+    }
+  }
+  return "UNKNOWN_EVENT";
+}
+
+// Creates the measurement state of a thread measuring for the first time. The thread gets its own counters of the
+// events that were validated by `stopwatch_init`. Returns NULL if the stopwatch is not initialized or the counters
+// cannot be started.
+static struct ThreadMeasurements *create_thread_measurements() {
+  if (!initialized_stopwatch) {
+    return NULL;
+  }
+
+  struct ThreadMeasurements *state = alloc_thread_measurements();
+  if (state == NULL) {
+    return NULL;
+  }
+  if (backend->create_counters(event_infos, num_counter_events, &state->counters) != STOPWATCH_OK) {
+    free(state);
+    return NULL;
+  }
+  state->alloc_counters = alloc_counters_getter ? alloc_counters_getter() : NULL;
+  state->io_counters = io_counters_getter ? io_counters_getter() : NULL;
+
+  add_thread_measurements(state);
+
+  thread_measurements = state;
+  thread_generation = generation;
+  return state;
+}
+
+static struct ThreadMeasurements *get_thread_measurements() {
+  if (thread_measurements && thread_generation == generation) {
+    return thread_measurements;
+  }
+  return create_thread_measurements();
+}
+
+// Entry of a routine, handing out the next one the first time its ID is seen. Only takes the lock then, so looking up a
+// routine that was already seen costs a hash and usually a single probe. Returns ID_MAP_NOT_FOUND if every entry is
+// taken.
+static size_t find_or_add_entry(size_t routine_id) {
+  const size_t entry = id_map_find(&routine_entries, routine_id);
+  if (entry != ID_MAP_NOT_FOUND) {
+    return entry;
+  }
+  pthread_mutex_lock(&stopwatch_lock);
+  const size_t added_entry = add_entry(routine_id);
+  pthread_mutex_unlock(&stopwatch_lock);
+  return added_entry;
+}
+
+// Must hold `stopwatch_lock`. Returns the entry of the routine if another thread added it while waiting for the lock.
+static size_t add_entry(size_t routine_id) {
+  size_t entry = id_map_find(&routine_entries, routine_id);
+  if (entry != ID_MAP_NOT_FOUND || num_routine_entries == STOPWATCH_MAX_FUNCTION_CALLS) {
+    return entry;
+  }
+  entry = num_routine_entries;
+  entry_routine_ids[entry] = routine_id;
+  if (!id_map_insert(&routine_entries, routine_id, entry)) {
+    return ID_MAP_NOT_FOUND;
+  }
+  // Released so that reports walking the entries without the lock see the ID of every entry they reach
+  __atomic_store_n(&num_routine_entries, entry + 1, __ATOMIC_RELEASE);
+  return entry;
+}
+
+// Entry of a routine that is reported or is the caller of another, which is main's if the ID was never seen
+static size_t entry_or_main(size_t routine_id) {
+  const size_t entry = id_map_find(&routine_entries, routine_id);
+  return entry != ID_MAP_NOT_FOUND ? entry : 0;
+}
+
+static enum RoutineState record_routine_info(size_t entry, const char *function_name, size_t caller_routine_id) {
+  pthread_mutex_lock(&stopwatch_lock);
+  // Another thread may have recorded the routine while waiting for the lock
+  enum RoutineState routine_state = atomic_load_explicit(&routines[entry].state, memory_order_relaxed);
+  if (routine_state == ROUTINE_UNRECORDED) {
+    routines[entry].caller_routine_id = caller_routine_id;
+    // Callers that were never seen count as main
+    routines[entry].depth = routines[entry_or_main(caller_routine_id)].depth + 1;
+
+    // Copy in the routine name and ensure the string is null terminated. Registered routines already have their name.
+    if (function_name && !routines[entry].registered) {
+      strncpy(routines[entry].routine_name, function_name, NULL_TERM_MAX_ROUTINE_NAME_LEN);
+      routines[entry].routine_name[NULL_TERM_MAX_ROUTINE_NAME_LEN - 1] = '\0';
+    }
+
+    routine_state = passes_filters(entry) ? ROUTINE_MEASURED : ROUTINE_FILTERED;
+
+    // Series enabled explicitly keep their own settings
+    if (routines[entry].series_decimation == 0 && series_patterns &&
+        matches_any(series_patterns, routine_name(entry))) {
+      routines[entry].series_size = default_series_size;
+      routines[entry].series_decimation = default_series_decimation;
+    }
+
+    // Sampling enabled explicitly keeps its own interval
+    if (!routines[entry].sampled && sampled_patterns && matches_any(sampled_patterns, routine_name(entry))) {
+      routines[entry].sampled = true;
+      routines[entry].sampling_interval = default_sampling_interval;
+    }
+
+    if (shm_segment) {
+      shm_segment_set_routine(shm_segment, entry, entry_routine_ids[entry], routine_name(entry), caller_routine_id);
+    }
+    atomic_store_explicit(&routines[entry].state, routine_state, memory_order_release);
+  }
+  pthread_mutex_unlock(&stopwatch_lock);
+  return routine_state;
+}
+
+// Reads the routine filters, series and sampling settings, number of slowest invocations kept and overhead budget from
+// the environment
+static void set_filters() {
+  include_patterns = parse_patterns(getenv("STOPWATCH_INCLUDE"));
+  exclude_patterns = parse_patterns(getenv("STOPWATCH_EXCLUDE"));
+  series_patterns = parse_patterns(getenv("STOPWATCH_SERIES"));
+
+  default_series_size = STOPWATCH_DEFAULT_SERIES_SIZE;
+  const char *series_size_env_val = getenv("STOPWATCH_SERIES_SIZE");
+  if (series_size_env_val) {
+    const long size = strtol(series_size_env_val, NULL, 10);
+    if (size >= 0) {
+      default_series_size = (size_t) size;
+    }
+  }
+
+  default_series_decimation = 1;
+  const char *decimation_env_val = getenv("STOPWATCH_SERIES_DECIMATION");
+  if (decimation_env_val) {
+    const long decimation = strtol(decimation_env_val, NULL, 10);
+    if (decimation > 0) {
+      default_series_decimation = (size_t) decimation;
+    }
+  }
+
+  sampled_patterns = parse_patterns(getenv("STOPWATCH_SAMPLED"));
+  default_sampling_interval = 0;
+  const char *interval_env_val = getenv("STOPWATCH_SAMPLING_INTERVAL");
+  if (interval_env_val && strcmp(interval_env_val, "auto") != 0) {
+    const long interval = strtol(interval_env_val, NULL, 10);
+    if (interval > 0) {
+      default_sampling_interval = (size_t) interval;
+    }
+  }
+  const char *random_env_val = getenv("STOPWATCH_SAMPLING_RANDOM");
+  random_sampling = random_env_val && (strcmp(random_env_val, "1") == 0 || strcasecmp(random_env_val, "true") == 0 ||
+                                       strcasecmp(random_env_val, "on") == 0);
+
+  num_slowest_kept = 0;
+  const char *slowest_env_val = getenv("STOPWATCH_SLOWEST");
+  if (slowest_env_val) {
+    const long num_slowest = strtol(slowest_env_val, NULL, 10);
+    if (num_slowest > 0) {
+      num_slowest_kept = num_slowest < STOPWATCH_MAX_SLOWEST ? (size_t) num_slowest : STOPWATCH_MAX_SLOWEST;
+    }
+  }
+
+  overhead_budget = 0;
+  const char *budget_env_val = getenv("STOPWATCH_OVERHEAD_BUDGET");
+  if (budget_env_val) {
+    const double budget_percent = strtod(budget_env_val, NULL);
+    if (budget_percent > 0) {
+      overhead_budget = budget_percent / 100;
+    }
+  }
+
+  set_work_names();
+
+  max_depth = STOPWATCH_MAX_FUNCTION_CALLS;
+  const char *depth_env_val = getenv("STOPWATCH_MAX_DEPTH");
+  if (depth_env_val) {
+    const long depth = strtol(depth_env_val, NULL, 10);
+    if (depth >= 0) {
+      max_depth = (size_t) depth;
+    }
+  }
+}
+
+static void destroy_filters() {
+  // The patterns all point into a single copy of the environment variable that starts at the first pattern
+  if (include_patterns) {
+    free(include_patterns[0]);
+    free(include_patterns);
+    include_patterns = NULL;
+  }
+  if (exclude_patterns) {
+    free(exclude_patterns[0]);
+    free(exclude_patterns);
+    exclude_patterns = NULL;
+  }
+  if (series_patterns) {
+    free(series_patterns[0]);
+    free(series_patterns);
+    series_patterns = NULL;
+  }
+  if (sampled_patterns) {
+    free(sampled_patterns[0]);
+    free(sampled_patterns);
+    sampled_patterns = NULL;
+  }
+}
+
+// Splits a comma delimited list into a NULL terminated array of patterns. Returns NULL if there are no patterns.
+static char **parse_patterns(const char *patterns) {
+  if (patterns == NULL) {
+    return NULL;
+  }
+  // Skipped so that the first pattern starts at the beginning of the copy made below, which lets it be freed through it
+  while (*patterns == ',') {
+    patterns++;
+  }
+  if (*patterns == '\0') {
+    return NULL;
+  }
+
+  // Upper bound on the number of patterns plus the NULL terminator
+  size_t max_patterns = 2;
+  for (const char *cursor = patterns; *cursor; cursor++) {
+    if (*cursor == ',') {
+      max_patterns++;
+    }
+  }
+
+  char **pattern_list = calloc(max_patterns, sizeof(char *));
+  // A copy is made as strtok_r mutates the arguments
+  char *patterns_copy = strdup(patterns);
+  char *save_ptr;
+  size_t num_patterns = 0;
+  for (char *token = strtok_r(patterns_copy, ",", &save_ptr); token != NULL; token = strtok_r(NULL, ",", &save_ptr)) {
+    pattern_list[num_patterns] = token;
+    num_patterns++;
+  }
+  return pattern_list;
+}
+
+static bool matches_any(char *const *patterns, const char *name) {
+  for (size_t idx = 0; patterns[idx]; idx++) {
+    if (fnmatch(patterns[idx], name, 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Must hold `stopwatch_lock` as the routine name and depth must already be recorded
+static bool passes_filters(size_t entry) {
+  if (routines[entry].depth > max_depth) {
+    return false;
+  }
+  if (include_patterns == NULL && exclude_patterns == NULL) {
+    return true;
+  }
+  const char *name = routine_name(entry);
+  if (include_patterns && !matches_any(include_patterns, name)) {
+    return false;
+  }
+  return exclude_patterns == NULL || !matches_any(exclude_patterns, name);
+}
+
+// Name used when reporting results. Routines registered without a name are looked up through the name resolver.
+static const char *routine_name(size_t entry) {
+  if (routines[entry].routine_name[0] == '\0' && name_resolver) {
+    const char *resolved_name = name_resolver(entry_routine_ids[entry]);
+    if (resolved_name) {
+      return resolved_name;
+    }
+  }
+  return routines[entry].routine_name;
+}
+
+// Creates an empty snapshot of the events that are currently measured
+static struct StopwatchSnapshot *create_snapshot() {
+  struct StopwatchSnapshot *snapshot = calloc_cache_aligned(sizeof(struct StopwatchSnapshot));
+  if (snapshot) {
+    for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+      clear_event_totals(&snapshot->totals[entry].events);
+    }
+    snapshot->num_events = num_registered_events;
+    for (size_t idx = 0; idx < num_registered_events; idx++) {
+      snapshot->events[idx] = event_infos[idx].code;
+      memcpy(snapshot->event_names[idx], event_infos[idx].name, STOPWATCH_EVENT_NAME_LEN);
+    }
+    memcpy(snapshot->work_names, work_names, sizeof(work_names));
+    snapshot->extremes_known = true;
+  }
+  return snapshot;
+}
+
+// Zeroed memory starting on a cache line boundary, as the readings are aligned to cache lines. Freed with `free`.
+static void *calloc_cache_aligned(size_t size) {
+  void *memory;
+  if (posix_memalign(&memory, CACHE_LINE_SIZE, size) != 0) {
+    return NULL;
+  }
+  memset(memory, 0, size);
+  return memory;
+}
+
+static size_t find_num_entries(const struct StopwatchSnapshot *snapshot) {
+  size_t entries = 0;
+  for (size_t idx = 0; idx < STOPWATCH_MAX_FUNCTION_CALLS; idx++) {
+    if (snapshot->totals[idx].total_times_called > 0) {
+      entries++;
+    }
+  }
+  return entries;
+}
+
+// Entry of the caller of a routine in the call tree. Callers that have not completed a measurement yet i.e. a routine
+// that prints the results from within itself, are not part of the call tree. Their callees are attached to the closest
+// caller that is.
+static size_t reported_caller(const struct StopwatchSnapshot *snapshot, size_t entry) {
+  size_t caller_entry = entry_or_main(snapshot->caller_routine_ids[entry]);
+  // Bounded by the number of routines in case the recorded callers form a cycle
+  for (size_t depth = 0; depth < STOPWATCH_MAX_FUNCTION_CALLS && caller_entry != 0; depth++) {
+    if (snapshot->totals[caller_entry].total_times_called > 0) {
+      return caller_entry;
+    }
+    caller_entry = entry_or_main(snapshot->caller_routine_ids[caller_entry]);
+  }
+  return 0;
+}
+
+static void set_header(const struct StringTable *table, const struct StopwatchSnapshot *snapshot, bool sampled) {
+  // Default table header entries
+  add_entry_str(table, "ID", (struct StringTableCellPos) {0, 0});
+  add_entry_str(table, "NAME", (struct StringTableCellPos) {0, 1});
+  add_entry_str(table, "TIMES CALLED", (struct StringTableCellPos) {0, 2});
+  add_entry_str(table, "TOTAL REAL MICROSECONDS", (struct StringTableCellPos) {0, 3});
+  if (sampled) {
+    add_entry_str(table, "SAMPLED CALLS", (struct StringTableCellPos) {0, 4});
+    add_entry_str(table, "REAL MICROSECONDS ERROR", (struct StringTableCellPos) {0, 5});
+  }
+
+  // Header entries for each measurement event and their spread, followed by those of the work counters
+  const size_t work_col_idx = table->width - num_work_columns(snapshot);
+  const size_t spread_col_idx = work_col_idx - 3 * snapshot->num_events;
+  char header[STOPWATCH_EVENT_NAME_LEN + STOPWATCH_WORK_NAME_LEN + 2];
+  for (unsigned int entry_idx = 0; entry_idx < snapshot->num_events; entry_idx++) {
+    const unsigned int effective_col_idx = spread_col_idx - snapshot->num_events + entry_idx;
+    const char *name = snapshot->event_names[entry_idx];
+
+    add_entry_str(table, name, (struct StringTableCellPos) {0, effective_col_idx});
+    snprintf(header, sizeof(header), "%s MIN", name);
+    add_entry_str(table, header, (struct StringTableCellPos) {0, spread_col_idx + 3 * entry_idx});
+    snprintf(header, sizeof(header), "%s MAX", name);
+    add_entry_str(table, header, (struct StringTableCellPos) {0, spread_col_idx + 3 * entry_idx + 1});
+    snprintf(header, sizeof(header), "%s STDDEV", name);
+    add_entry_str(table, header, (struct StringTableCellPos) {0, spread_col_idx + 3 * entry_idx + 2});
+  }
+
+  size_t col_idx = work_col_idx;
+  for (size_t counter = 0; counter < snapshot->num_work_counters; counter++) {
+    const char *name = snapshot->work_names[counter];
+    add_entry_str(table, name, (struct StringTableCellPos) {0, col_idx++});
+    snprintf(header, sizeof(header), "%s/S", name);
+    add_entry_str(table, header, (struct StringTableCellPos) {0, col_idx++});
+    snprintf(header, sizeof(header), "NS/%s", name);
+    add_entry_str(table, header, (struct StringTableCellPos) {0, col_idx++});
+    for (size_t idx = 0; idx < snapshot->num_events; idx++) {
+      snprintf(header, sizeof(header), "%s/%s", snapshot->event_names[idx], name);
+      add_entry_str(table, header, (struct StringTableCellPos) {0, col_idx++});
+    }
+  }
+}
+
+static void set_body_row(const struct StringTable *table,
+                         bool sampled,
+                         size_t row_num,
+                         const struct StopwatchSnapshot *snapshot,
+                         size_t entry,
+                         size_t stack_depth) {
+  const struct MeasurementReadings *reading = &snapshot->totals[entry];
+  long long real_us;
+  long long events_measurements[STOPWATCH_MAX_EVENTS];
+  double real_us_error;
+  report_totals(reading, snapshot->num_events, &real_us, events_measurements, &real_us_error);
+
+  // Default table row measurement values
+  add_entry_zu(table, snapshot->routine_ids[entry], (struct StringTableCellPos) {row_num, 0});
+  add_entry_str(table, snapshot->routine_names[entry], (struct StringTableCellPos) {row_num, 1});
+  set_indent_lvl(table, stack_depth, (struct StringTableCellPos) {row_num, 1});
+
+  add_entry_lld(table, reading->total_times_called, (struct StringTableCellPos) {row_num, 2});
+  add_entry_lld(table, real_us, (struct StringTableCellPos) {row_num, 3});
+  // Routines that are not sampled leave the columns empty
+  if (sampled && reading->sampled_times_called != reading->total_times_called) {
+    add_entry_lld(table, reading->sampled_times_called, (struct StringTableCellPos) {row_num, 4});
+    add_entry_lld(table, llround(real_us_error), (struct StringTableCellPos) {row_num, 5});
+  } else if (sampled) {
+    add_entry_str(table, "", (struct StringTableCellPos) {row_num, 4});
+    add_entry_str(table, "", (struct StringTableCellPos) {row_num, 5});
+  }
+
+  // Event specific table row measurement values. Routines whose events were never measured leave the spread empty.
+  const size_t work_col_idx = table->width - num_work_columns(snapshot);
+  const size_t spread_col_idx = work_col_idx - 3 * snapshot->num_events;
+  const bool events_measured = reading->sampled_times_called > reading->migrated_times_called;
+  for (size_t entry_idx = 0; entry_idx < snapshot->num_events; entry_idx++) {
+    const size_t effective_col_idx = spread_col_idx - snapshot->num_events + entry_idx;
+    add_entry_lld(table, events_measurements[entry_idx], (struct StringTableCellPos) {row_num, effective_col_idx});
+    const struct StringTableCellPos min_pos = {row_num, spread_col_idx + 3 * entry_idx};
+    const struct StringTableCellPos max_pos = {row_num, spread_col_idx + 3 * entry_idx + 1};
+    const struct StringTableCellPos stddev_pos = {row_num, spread_col_idx + 3 * entry_idx + 2};
+    if (events_measured && snapshot->extremes_known) {
+      add_entry_lld(table, EVENT_TOTAL(&reading->events, mins, entry_idx), min_pos);
+      add_entry_lld(table, EVENT_TOTAL(&reading->events, maxs, entry_idx), max_pos);
+      add_entry_lld(table, llround(event_stddev(reading, entry_idx)), stddev_pos);
+    } else if (events_measured) {
+      // Differences of snapshots do not know the extremes
+      add_entry_str(table, "", min_pos);
+      add_entry_str(table, "", max_pos);
+      add_entry_lld(table, llround(event_stddev(reading, entry_idx)), stddev_pos);
+    } else {
+      add_entry_str(table, "", min_pos);
+      add_entry_str(table, "", max_pos);
+      add_entry_str(table, "", stddev_pos);
+    }
+  }
+
+  // Work counters and their rates. Rates of routines that did no work are left empty
+  char rate_str[32];
+  size_t col_idx = work_col_idx;
+  for (size_t counter = 0; counter < snapshot->num_work_counters; counter++) {
+    struct WorkRates rates;
+    const bool has_rates =
+        work_rates(reading->total_work[counter], real_us, events_measurements, snapshot->num_events, &rates);
+    add_entry_lld(table, reading->total_work[counter], (struct StringTableCellPos) {row_num, col_idx++});
+    for (size_t idx = 0; idx < 2 + snapshot->num_events; idx++) {
+      const double rate = idx == 0 ? rates.per_second : idx == 1 ? rates.nsec_per_unit : rates.events_per_unit[idx - 2];
+      snprintf(rate_str, sizeof(rate_str), "%.4g", rate);
+      add_entry_str(table, has_rates ? rate_str : "", (struct StringTableCellPos) {row_num, col_idx++});
+    }
+  }
+}
+
+// Called from the end measurement of a routine that keeps a series. The intermediate results of `state` must hold the
+// event values of the invocation.
+static void record_series_sample(struct ThreadMeasurements *state, size_t entry, long long real_us) {
+  struct ReadingsMetadata *metadata = &state->metadata[entry];
+  if (metadata->series == NULL) {
+    metadata->series = create_series(routines[entry].series_size,
+                                     routines[entry].series_decimation,
+                                     num_registered_events + 1);
+    if (metadata->series == NULL) {
+      return;
+    }
+  }
+
+  long long values[SERIES_MAX_VALUES];
+  values[0] = real_us;
+  memcpy(values + 1, state->tmp_event_results, sizeof(long long) * num_registered_events);
+  series_record(metadata->series, values);
+}
+
+// Called from every end measurement if slowest invocations are kept. The intermediate results of `state` must hold the
+// event values of the invocation. Invocations that do not qualify return after a single comparison.
+static void record_slowest_invocation(struct ThreadMeasurements *state, size_t entry, long long real_us) {
+  struct ReadingsMetadata *metadata = &state->metadata[entry];
+  if (metadata->slowest == NULL) {
+    metadata->slowest = create_slowest(num_slowest_kept);
+    if (metadata->slowest == NULL) {
+      return;
+    }
+  }
+  if (!slowest_qualifies(metadata->slowest, real_us)) {
+    return;
+  }
+
+  struct StopwatchInvocation invocation;
+  invocation.routine_id = entry_routine_ids[entry];
+  invocation.thread_index = state->thread_index;
+  invocation.start_usec = state->starts[entry].start_real_us - init_real_us;
+  invocation.real_usec = real_us;
+  memcpy(invocation.event_values, state->tmp_event_results, sizeof(long long) * num_registered_events);
+  // The routine is still the innermost open routine, so its caller is the one below it
+  if (state->num_open_routines >= 2 && state->num_open_routines <= STOPWATCH_MAX_STACK_DEPTH) {
+    const size_t caller_entry = state->open_routines[state->num_open_routines - 2];
+    invocation.caller_routine_id = entry_routine_ids[caller_entry];
+    // A caller that is only counted did not read its start time
+    invocation.caller_start_usec =
+        state->starts[caller_entry].sampled ? state->starts[caller_entry].start_real_us - init_real_us : -1;
+  } else {
+    invocation.caller_routine_id = routines[entry].caller_routine_id;
+    invocation.caller_start_usec = -1;
+  }
+  slowest_record(metadata->slowest, &invocation);
+}
+
+static void print_slowest_invocation_row(const struct StringTable *table,
+                                         size_t row_num,
+                                         const struct StopwatchInvocation *invocation) {
+  add_entry_zu(table, invocation->routine_id, (struct StringTableCellPos) {row_num, 0});
+  add_entry_str(table, routine_name(entry_or_main(invocation->routine_id)), (struct StringTableCellPos) {row_num, 1});
+  add_entry_lld(table, (long long) invocation->thread_index, (struct StringTableCellPos) {row_num, 2});
+  add_entry_lld(table, invocation->start_usec, (struct StringTableCellPos) {row_num, 3});
+  add_entry_lld(table, invocation->real_usec, (struct StringTableCellPos) {row_num, 4});
+  add_entry_zu(table, invocation->caller_routine_id, (struct StringTableCellPos) {row_num, 5});
+  add_entry_lld(table, invocation->caller_start_usec, (struct StringTableCellPos) {row_num, 6});
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    add_entry_lld(table, invocation->event_values[idx], (struct StringTableCellPos) {row_num, 7 + idx});
+  }
+}
+
+// Times the reads that a start and end measurement pair makes on the initializing thread without recording anything,
+// and the bookkeeping of a pair that only counts the invocation. The fastest round is kept, as a round in which the
+// thread is preempted would make every routine look more expensive to measure than it is.
+static void calibrate_overhead(const struct ThreadMeasurements *state) {
+  long long values[STOPWATCH_MAX_EVENTS];
+  struct timespec start;
+  struct timespec end;
+  pair_overhead_nsec = LLONG_MAX;
+  count_overhead_nsec = LLONG_MAX;
+  for (size_t round = 0; round < CALIBRATION_ROUNDS; round++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t pair = 0; pair < CALIBRATION_PAIRS; pair++) {
+      read_events(state, values);
+      real_usec();
+      read_events(state, values);
+      real_usec();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long long elapsed_nsec = (long long) (end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+    if (elapsed_nsec / CALIBRATION_PAIRS < pair_overhead_nsec) {
+      pair_overhead_nsec = elapsed_nsec / CALIBRATION_PAIRS;
+    }
+
+    // An invocation that is only counted still looks up the state of the thread and the routine on both ends
+    volatile long long counted = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t pair = 0; pair < CALIBRATION_PAIRS; pair++) {
+      counted += atomic_load_explicit(&routines[0].throttling, memory_order_acquire);
+      counted += get_thread_measurements()->readings[0].total_times_called;
+      counted += get_thread_measurements()->readings[0].total_times_called;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed_nsec = (long long) (end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+    if (elapsed_nsec / CALIBRATION_PAIRS < count_overhead_nsec) {
+      count_overhead_nsec = elapsed_nsec / CALIBRATION_PAIRS;
+    }
+  }
+}
+
+// Start of a routine that is not measured i.e. while paused or once switched off. Nothing is recorded unless the routine
+// is already open on the thread, in which case it is a recursive invocation that its end measurement must not take for
+// the end of the open one.
+static enum StopwatchStatus start_unmeasured_invocation(size_t entry) {
+  struct ThreadMeasurements *state = get_thread_measurements();
+  if (state == NULL) {
+    return STOPWATCH_ERR;
+  }
+  if (state->starts[entry].measuring) {
+    start_recursive_invocation(state, entry);
+  }
+  return STOPWATCH_OK;
+}
+
+// A recursive invocation would overwrite the start values of the outermost one, so it is only counted when it ends
+static void start_recursive_invocation(struct ThreadMeasurements *state, size_t entry) {
+  state->starts[entry].recursion_depth++;
+  push_open_routine(state, entry);
+}
+
+// Every invocation pushed here is popped by the end measurement that ends it, whichever way that end measurement
+// returns. Routines nested deeper than the stack can hold are still measured but cannot be the caller of registered
+// routines.
+static void push_open_routine(struct ThreadMeasurements *state, size_t entry) {
+  if (state->num_open_routines < STOPWATCH_MAX_STACK_DEPTH) {
+    state->open_routines[state->num_open_routines] = entry;
+  }
+  state->num_open_routines++;
+}
+
+// Takes the innermost open invocation of the routine off the stack. That is the top one unless routines are ended out
+// of order, in which case the routines opened after it stay open.
+static void pop_open_routine(struct ThreadMeasurements *state, size_t entry) {
+  if (state->num_open_routines == 0) {
+    return;
+  }
+  if (state->num_open_routines <= STOPWATCH_MAX_STACK_DEPTH) {
+    size_t idx = state->num_open_routines - 1;
+    while (idx > 0 && state->open_routines[idx] != entry) {
+      idx--;
+    }
+    if (state->open_routines[idx] == entry) {
+      memmove(&state->open_routines[idx],
+              &state->open_routines[idx + 1],
+              sizeof(size_t) * (state->num_open_routines - 1 - idx));
+    }
+  }
+  state->num_open_routines--;
+}
+
+// Decides whether an invocation of a sampled routine is only counted. Every `interval`th invocation on the thread is
+// measured starting with the first, or with `STOPWATCH_SAMPLING_RANDOM` the gaps between measured invocations are
+// drawn at random with the same average, so that work which repeats with the same period is not always missed.
+static bool skip_invocation(struct ThreadMeasurements *state, size_t entry) {
+  struct StartReadings *start = &state->starts[entry];
+  if (start->sampling_countdown > 0) {
+    start->sampling_countdown--;
+    return true;
+  }
+
+  const size_t interval = sampling_interval(&state->metadata[entry], entry);
+  if (interval > 1) {
+    if (random_sampling) {
+      // xorshift64
+      uint64_t random = state->sampling_random_state;
+      random ^= random << 13;
+      random ^= random >> 7;
+      random ^= random << 17;
+      state->sampling_random_state = random;
+      start->sampling_countdown = (size_t) (random % (2 * interval - 1));
+    } else {
+      start->sampling_countdown = interval - 1;
+    }
+  }
+  return false;
+}
+
+// Chooses the interval of a routine sampled automatically from the invocations measured on the thread so far, so that
+// measuring adds at most AUTO_SAMPLING_MAX_OVERHEAD to its real time
+static void choose_auto_sampling_interval(const struct MeasurementReadings *reading, struct ReadingsMetadata *metadata) {
+  // Invocations shorter than the clock resolution count as a nanosecond
+  const double mean_nsec = fmax(1000.0 * (double) reading->total_real_us / (double) reading->sampled_times_called, 1.0);
+  const double interval = ceil((double) pair_overhead_nsec / (AUTO_SAMPLING_MAX_OVERHEAD * mean_nsec));
+  if (interval < 1) {
+    metadata->auto_sampling_interval = 1;
+  } else if (interval > STOPWATCH_MAX_SAMPLING_INTERVAL) {
+    metadata->auto_sampling_interval = STOPWATCH_MAX_SAMPLING_INTERVAL;
+  } else {
+    metadata->auto_sampling_interval = (size_t) interval;
+  }
+}
+
+// Totals of a routine as reported. The totals of a sampled routine are scaled from its measured invocations up to all
+// of its invocations, along with the half width of the 95% confidence interval of the real microseconds, which is 0 if
+// every invocation was measured.
+static void report_totals(const struct MeasurementReadings *total,
+                          size_t num_events,
+                          long long *real_us,
+                          long long *events_measurements,
+                          double *real_us_error) {
+  const long long num_calls = total->total_times_called;
+  const long long num_measured = total->sampled_times_called;
+  if (num_measured == num_calls || num_measured == 0) {
+    *real_us = total->total_real_us;
+    for (size_t idx = 0; idx < num_events; idx++) {
+      events_measurements[idx] = EVENT_TOTAL(&total->events, sums, idx);
+    }
+    *real_us_error = 0;
+    return;
+  }
+
+  const double scale = (double) num_calls / (double) num_measured;
+  *real_us = llround((double) total->total_real_us * scale);
+  for (size_t idx = 0; idx < num_events; idx++) {
+    events_measurements[idx] = llround((double) EVENT_TOTAL(&total->events, sums, idx) * scale);
+  }
+
+  // A single measured invocation says nothing about the spread, so it is assumed to be as large as the mean
+  const double mean = (double) total->total_real_us / (double) num_measured;
+  const double variance = num_measured > 1
+      ? fmax(total->sum_squared_real_us - mean * (double) total->total_real_us, 0.0) / (double) (num_measured - 1)
+      : mean * mean;
+  // The measured invocations are drawn from a finite number of calls without replacement
+  const double correction = (double) (num_calls - num_measured) / (double) (num_calls - 1);
+  *real_us_error = 1.96 * (double) num_calls * sqrt(variance / (double) num_measured * correction);
+}
+
+// Smallest and largest values of the events in a single invocation, which are 0 unless `extremes_known` and events were
+// measured, and their sums of squares scaled up like the totals. Returns whether the smallest and largest are known.
+static bool report_event_spread(const struct MeasurementReadings *total,
+                                size_t num_events,
+                                bool extremes_known,
+                                long long *min_events_measurements,
+                                long long *max_events_measurements,
+                                double *sum_squared_events_measurements) {
+  const bool known = extremes_known && total->sampled_times_called > total->migrated_times_called;
+  const double scale = total->sampled_times_called > 0
+      ? (double) total->total_times_called / (double) total->sampled_times_called
+      : 1;
+  for (size_t idx = 0; idx < num_events; idx++) {
+    min_events_measurements[idx] = known ? EVENT_TOTAL(&total->events, mins, idx) : 0;
+    max_events_measurements[idx] = known ? EVENT_TOTAL(&total->events, maxs, idx) : 0;
+    sum_squared_events_measurements[idx] = EVENT_TOTAL(&total->events, sums_of_squares, idx) * scale;
+  }
+  return known;
+}
+
+// Sample standard deviation of an event over the invocations whose events were measured, or 0 with fewer than two
+static double event_stddev(const struct MeasurementReadings *total, size_t event_idx) {
+  const long long num_measured = total->sampled_times_called - total->migrated_times_called;
+  if (num_measured < 2) {
+    return 0;
+  }
+  const double sum = (double) EVENT_TOTAL(&total->events, sums, event_idx);
+  const double mean = sum / (double) num_measured;
+  const double squares = EVENT_TOTAL(&total->events, sums_of_squares, event_idx) - mean * sum;
+  return sqrt(fmax(squares, 0.0) / (double) (num_measured - 1));
+}
+
+// Invocations per measured invocation of a sampled routine on the thread of `metadata`, which is 1 until an automatic
+// interval is chosen. The overhead budget may require a larger one than configured.
+static size_t sampling_interval(const struct ReadingsMetadata *metadata, size_t entry) {
+  size_t interval = 1;
+  if (routines[entry].sampled) {
+    interval = routines[entry].sampling_interval != 0 ? routines[entry].sampling_interval
+                                                      : metadata->auto_sampling_interval;
+  }
+  if (routines[entry].throttled_interval > interval) {
+    interval = routines[entry].throttled_interval;
+  }
+  return interval > 0 ? interval : 1;
+}
+
+// Fraction of the real time of a routine whose invocations take `mean_nsec` that measuring it at `throttling` adds,
+// where one in every `interval` invocations is measured unless it is only counted
+static double estimate_overhead(enum StopwatchThrottling throttling, size_t interval, double mean_nsec) {
+  if (throttling == STOPWATCH_THROTTLE_OFF) {
+    return 0;
+  }
+  if (throttling == STOPWATCH_THROTTLE_COUNT_ONLY) {
+    return (double) count_overhead_nsec / mean_nsec;
+  }
+  const double pair_nsec = (double) pair_overhead_nsec + (double) (interval - 1) * (double) count_overhead_nsec;
+  return pair_nsec / ((double) interval * mean_nsec);
+}
+
+// Moves a routine one step further down from measured to sampled, counted only and off if measuring it at its current
+// level is estimated to exceed the overhead budget, judging by the invocations measured on the thread of `reading`.
+// Every step is kept for the report.
+static void evaluate_throttling(const struct ThreadMeasurements *state,
+                                const struct MeasurementReadings *reading,
+                                size_t entry) {
+  if (reading->sampled_times_called == 0) {
+    return;
+  }
+  // Invocations shorter than the clock resolution count as a nanosecond
+  const double mean_nsec = fmax(1000.0 * (double) reading->total_real_us / (double) reading->sampled_times_called, 1.0);
+
+  // Estimated without the lock first, as routines within the budget are evaluated again after every window. The level
+  // is acquired so that the interval it was throttled to is seen.
+  enum StopwatchThrottling throttling = atomic_load_explicit(&routines[entry].throttling, memory_order_acquire);
+  size_t interval = sampling_interval(&state->metadata[entry], entry);
+  double overhead = estimate_overhead(throttling, interval, mean_nsec);
+  if (throttling == STOPWATCH_THROTTLE_OFF || overhead <= overhead_budget) {
+    return;
+  }
+
+  pthread_mutex_lock(&stopwatch_lock);
+  // Another thread may have moved the routine down while waiting for the lock
+  throttling = atomic_load_explicit(&routines[entry].throttling, memory_order_relaxed);
+  interval = sampling_interval(&state->metadata[entry], entry);
+  overhead = estimate_overhead(throttling, interval, mean_nsec);
+  if (throttling == STOPWATCH_THROTTLE_OFF || overhead <= overhead_budget ||
+      num_throttle_decisions == MAX_THROTTLE_DECISIONS) {
+    pthread_mutex_unlock(&stopwatch_lock);
+    return;
+  }
+
+  struct StopwatchThrottleDecision *decision = &throttle_decisions[num_throttle_decisions++];
+  decision->routine_id = entry_routine_ids[entry];
+  decision->thread_index = state->thread_index;
+  decision->time_usec = real_usec() - init_real_us;
+  decision->throttling = throttling + 1;
+  decision->sampling_interval = 0;
+  decision->mean_real_nsec = mean_nsec;
+  decision->overhead = overhead;
+
+  if (decision->throttling == STOPWATCH_THROTTLE_SAMPLED) {
+    // Smallest interval within the budget, from solving estimate_overhead for it. The next step follows if there is
+    // none, as counting alone already exceeds the budget.
+    const double budget_nsec = overhead_budget * mean_nsec;
+    double new_interval = STOPWATCH_MAX_SAMPLING_INTERVAL;
+    if (budget_nsec > (double) count_overhead_nsec) {
+      new_interval = fmin(ceil(((double) pair_overhead_nsec - (double) count_overhead_nsec) /
+                               (budget_nsec - (double) count_overhead_nsec)),
+                          STOPWATCH_MAX_SAMPLING_INTERVAL);
+    }
+    decision->sampling_interval = new_interval > (double) interval ? (size_t) new_interval : interval + 1;
+    routines[entry].throttled_interval = decision->sampling_interval;
+  } else if (decision->throttling == STOPWATCH_THROTTLE_OFF) {
+    // Neither counted nor measured from then on, like a routine that is filtered out. Its starts still look up the
+    // thread in case an invocation from before is open there.
+    atomic_store_explicit(&routines[entry].state, ROUTINE_THROTTLED, memory_order_release);
+  }
+  // Released so that threads reading the level without the lock see the interval
+  atomic_store_explicit(&routines[entry].throttling, decision->throttling, memory_order_release);
+  pthread_mutex_unlock(&stopwatch_lock);
+}
+
+static const char *throttling_name(enum StopwatchThrottling throttling) {
+  switch (throttling) {
+    case STOPWATCH_THROTTLE_SAMPLED:
+      return "sampled";
+    case STOPWATCH_THROTTLE_COUNT_ONLY:
+      return "count only";
+    case STOPWATCH_THROTTLE_OFF:
+      return "off";
+    default:
+      return "measured";
+  }
+}
+
+// Adds the totals of a routine on one thread to the spread over threads, whose averages hold sums until every thread is
+// added
+static void add_to_imbalance(struct StopwatchImbalance *imbalance,
+                             size_t thread_index,
+                             long long real_us,
+                             const long long *events_measurements) {
+  const bool first = imbalance->num_threads == 0;
+  imbalance->num_threads++;
+  if (first || real_us < imbalance->min_real_usec) {
+    imbalance->min_real_usec = real_us;
+  }
+  if (first || real_us > imbalance->max_real_usec) {
+    imbalance->max_real_usec = real_us;
+    imbalance->slowest_thread_index = thread_index;
+  }
+  imbalance->avg_real_usec += (double) real_us;
+  for (size_t idx = 0; idx < num_registered_events; idx++) {
+    const long long value = events_measurements[idx];
+    if (first || value < imbalance->min_event_values[idx]) {
+      imbalance->min_event_values[idx] = value;
+    }
+    if (first || value > imbalance->max_event_values[idx]) {
+      imbalance->max_event_values[idx] = value;
+    }
+    imbalance->avg_event_values[idx] += (double) value;
+  }
+}
+
+// Fills `imbalances` with the spread of every routine measured on more than one thread, in the order the routines were
+// first seen. Returns the number of routines filled in.
+static size_t find_imbalances(struct StopwatchImbalance *imbalances) {
+  size_t num_imbalances = 0;
+  const size_t num_entries = __atomic_load_n(&num_routine_entries, __ATOMIC_ACQUIRE);
+  for (size_t entry = 0; entry < num_entries; entry++) {
+    if (stopwatch_get_imbalance(entry_routine_ids[entry], &imbalances[num_imbalances]) == STOPWATCH_OK &&
+        imbalances[num_imbalances].num_threads > 1) {
+      num_imbalances++;
+    }
+  }
+  return num_imbalances;
+}
+
+static int compare_most_imbalanced_first(const void *lhs, const void *rhs) {
+  const double lhs_imbalance = ((const struct StopwatchImbalance *) lhs)->imbalance;
+  const double rhs_imbalance = ((const struct StopwatchImbalance *) rhs)->imbalance;
+  return (lhs_imbalance < rhs_imbalance) - (lhs_imbalance > rhs_imbalance);
+}
+
+// Names the work counters from the comma delimited names in `STOPWATCH_WORK_COUNTERS`. Counters that are not named
+// there are called `WORK<index>`.
+static void set_work_names() {
+  for (size_t counter = 0; counter < STOPWATCH_MAX_WORK_COUNTERS; counter++) {
+    snprintf(work_names[counter], STOPWATCH_WORK_NAME_LEN, "WORK%zu", counter);
+  }
+  num_named_work_counters = 0;
+  const char *names = getenv("STOPWATCH_WORK_COUNTERS");
+  while (names && names[0] != '\0' && num_named_work_counters < STOPWATCH_MAX_WORK_COUNTERS) {
+    const size_t length = strcspn(names, ",");
+    if (length > 0) {
+      const size_t copied = length < STOPWATCH_WORK_NAME_LEN - 1 ? length : STOPWATCH_WORK_NAME_LEN - 1;
+      memcpy(work_names[num_named_work_counters], names, copied);
+      work_names[num_named_work_counters][copied] = '\0';
+    }
+    num_named_work_counters++;
+    names += names[length] == ',' ? length + 1 : length;
+  }
+}
+
+// Counters are reported up to the last one that is named or was added to on any thread, so their indices stay the same
+static size_t num_reported_work_counters(unsigned int work_counters_used) {
+  size_t num_counters = num_named_work_counters;
+  for (size_t counter = num_counters; counter < STOPWATCH_MAX_WORK_COUNTERS; counter++) {
+    if (work_counters_used & (1u << counter)) {
+      num_counters = counter + 1;
+    }
+  }
+  return num_counters;
+}
+
+// Each reported work counter has a column for its total, its rate per second, the nanoseconds per unit and the events
+// per unit
+static size_t num_work_columns(const struct StopwatchSnapshot *snapshot) {
+  return snapshot->num_work_counters * (3 + snapshot->num_events);
+}
+
+// Derives the rates of a routine from the units of work it did. Returns false, with the rates zeroed, if it did none.
+static bool work_rates(long long work,
+                       long long real_us,
+                       const long long *events_measurements,
+                       size_t num_events,
+                       struct WorkRates *rates) {
+  memset(rates, 0, sizeof(struct WorkRates));
+  if (work == 0) {
+    return false;
+  }
+  rates->per_second = real_us > 0 ? (double) work * 1e6 / (double) real_us : 0;
+  rates->nsec_per_unit = (double) real_us * 1e3 / (double) work;
+  for (size_t idx = 0; idx < num_events; idx++) {
+    rates->events_per_unit[idx] = (double) events_measurements[idx] / (double) work;
+  }
+  return true;
+}
+
+static bool any_routine_sampled(const struct StopwatchSnapshot *snapshot) {
+  for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+    if (snapshot->totals[entry].sampled_times_called != snapshot->totals[entry].total_times_called) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Measurement state of a thread that has not measured anything. Freed with `free`.
+static struct ThreadMeasurements *alloc_thread_measurements() {
+  struct ThreadMeasurements *state = calloc_cache_aligned(sizeof(struct ThreadMeasurements));
+  if (state) {
+    for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+      clear_event_totals(&state->readings[entry].events);
+    }
+  }
+  return state;
+}
+
+static void add_thread_measurements(struct ThreadMeasurements *state) {
+  pthread_mutex_lock(&stopwatch_lock);
+  state->thread_index = thread_list ? thread_list->thread_index + 1 : 0;
+  // Any non zero seed works, and differing ones keep threads from skipping the same invocations
+  state->sampling_random_state = 0x9E3779B97F4A7C15ull * (state->thread_index + 1);
+  if (shm_segment) {
+    state->shm_thread = shm_segment_add_thread(shm_segment);
+  }
+  state->next = thread_list;
+  // Released as the dump signal handler walks the list without the lock
+  __atomic_store_n(&thread_list, state, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&stopwatch_lock);
+}
+
+// Creates the shared memory segment named by `STOPWATCH_SHM` if it is set
+static enum StopwatchStatus create_shm() {
+  const char *shm_env_val = getenv("STOPWATCH_SHM");
+  if (shm_env_val == NULL || shm_env_val[0] == '\0') {
+    return STOPWATCH_OK;
+  }
+
+  shm_name = strdup(shm_env_val);
+  shm_segment = create_shm_segment(shm_name);
+  return shm_segment ? STOPWATCH_OK : STOPWATCH_ERR;
+}
+
+static void publish_routine_totals(struct StopwatchShmThread *shm_thread,
+                                   size_t entry,
+                                   const struct MeasurementReadings *reading) {
+  struct StopwatchShmRoutine totals;
+  totals.total_times_called = reading->total_times_called;
+  totals.total_real_usec = reading->total_real_us;
+  for (size_t idx = 0; idx < STOPWATCH_MAX_EVENTS; idx++) {
+    totals.total_event_values[idx] = EVENT_TOTAL(&reading->events, sums, idx);
+  }
+  shm_thread_set_routine(shm_thread, entry, &totals);
+}
+
+// Wall clock of the measurements. Unlike PAPI_get_real_usec, clock_gettime is async-signal-safe so the dump signal
+// handler can tell how long open routines have been running.
+static long long real_usec() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Installs the dump signal handler if `STOPWATCH_DUMP_FILE` is set
+static enum StopwatchStatus install_dump_handler() {
+  const char *dump_env_val = getenv("STOPWATCH_DUMP_FILE");
+  if (dump_env_val == NULL || dump_env_val[0] == '\0') {
+    return STOPWATCH_OK;
+  }
+
+  // Copied as the environment may change before the signal arrives
+  dump_path = strdup(dump_env_val);
+  if (dump_path == NULL) {
+    return STOPWATCH_ERR;
+  }
+
+  struct sigaction dump_action;
+  memset(&dump_action, 0, sizeof(dump_action));
+  dump_action.sa_handler = dump_signal_handler;
+  sigemptyset(&dump_action.sa_mask);
+  // Interrupted system calls of the program are restarted rather than failing because of the dump
+  dump_action.sa_flags = SA_RESTART;
+  if (sigaction(STOPWATCH_DUMP_SIGNAL, &dump_action, &previous_dump_action) != 0) {
+    free(dump_path);
+    dump_path = NULL;
+    return STOPWATCH_ERR;
+  }
+  atomic_store(&dump_handler_installed, true);
+  return STOPWATCH_OK;
+}
+
+static void uninstall_dump_handler() {
+  if (!atomic_exchange(&dump_handler_installed, false)) {
+    return;
+  }
+  sigaction(STOPWATCH_DUMP_SIGNAL, &previous_dump_action, NULL);
+
+  // Handlers that started before the flag was cleared may still be reading the measurements
+  while (atomic_load(&dumps_in_progress) > 0) {
+    sched_yield();
+  }
+  free(dump_path);
+  dump_path = NULL;
+}
+
+static void dump_signal_handler(int signal_number) {
+  (void) signal_number;
+  // The interrupted code may check errno right after the handler returns
+  const int saved_errno = errno;
+
+  atomic_fetch_add(&dumps_in_progress, 1);
+  if (atomic_load(&dump_handler_installed)) {
+    const int fd = open(dump_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      stopwatch_dump(fd);
+      close(fd);
+    }
+  }
+  atomic_fetch_sub(&dumps_in_progress, 1);
+
+  errno = saved_errno;
 }
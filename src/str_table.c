@@ -109,6 +109,13 @@ int add_entry_lld(const struct StringTable *table, long long value, struct Strin
   return STR_TABLE_OK;
 }
 
+int add_entry_zu(const struct StringTable *table, size_t value, struct StringTableCellPos pos) {
+  // Enough for the 20 digits of the largest 64 bit value and the null terminator
+  char num_str[21];
+  snprintf(num_str, sizeof(num_str), "%zu", value);
+  return add_entry_str(table, num_str, pos);
+}
+
 int set_indent_lvl(const struct StringTable *table, size_t indent_lvl, struct StringTableCellPos pos) {
   if (table == NULL) {
     return STR_TABLE_ERR;
@@ -34,6 +34,8 @@ int add_entry_str(const struct StringTable *table, const char *value, struct Str
 
 int add_entry_lld(const struct StringTable *table, long long value, struct StringTableCellPos pos);
 
+int add_entry_zu(const struct StringTable *table, size_t value, struct StringTableCellPos pos);
+
 int set_indent_lvl(const struct StringTable *table, size_t indent_lvl, struct StringTableCellPos pos);
 
 char *make_table_str(const struct StringTable *table);
@@ -0,0 +1,170 @@
+// Tests for the kernels accumulating the events of each end measurement
+#include "accumulate.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch.h"
+
+// Past the events, so that kernels touching more events than they are specialized for are caught
+#define GUARD_VALUE 0x5A5A5A5A5A5A5A5All
+
+#define NUM_ROUNDS 3
+
+static const char *isa_names[ACCUMULATE_NUM_ISAS] = {"scalar", "avx2", "avx512"};
+
+// Counters wrap around, so the values are taken apart and added through unsigned arithmetic
+static long long wrapping_sub(long long lhs, long long rhs) {
+  return (long long) ((unsigned long long) lhs - (unsigned long long) rhs);
+}
+
+static long long wrapping_add(long long lhs, long long rhs) {
+  return (long long) ((unsigned long long) lhs + (unsigned long long) rhs);
+}
+
+static void accumulate_expected(long long *values,
+                                const long long *start_values,
+                                struct EventTotals *totals,
+                                size_t num_events) {
+  for (size_t idx = 0; idx < num_events; idx++) {
+    values[idx] = wrapping_sub(values[idx], start_values[idx]);
+    EVENT_TOTAL(totals, sums, idx) = wrapping_add(EVENT_TOTAL(totals, sums, idx), values[idx]);
+    if (values[idx] < EVENT_TOTAL(totals, mins, idx)) {
+      EVENT_TOTAL(totals, mins, idx) = values[idx];
+    }
+    if (values[idx] > EVENT_TOTAL(totals, maxs, idx)) {
+      EVENT_TOTAL(totals, maxs, idx) = values[idx];
+    }
+    EVENT_TOTAL(totals, sums_of_squares, idx) += (double) values[idx] * (double) values[idx];
+  }
+}
+
+// Start and end values of an event in one of the rounds. The first round has small values of either sign, the second
+// counters that wrap around past LLONG_MAX and the third values far beyond the 52 bits a double holds exactly.
+static void set_values(size_t round, size_t idx, long long *start_value, long long *value) {
+  switch (round) {
+    case 0:
+      *start_value = (long long) (idx * 1000003);
+      *value = idx % 3 == 0 ? *start_value - 7 : *start_value + (long long) (idx * idx * 12345);
+      break;
+    case 1:
+      *start_value = LLONG_MAX - (long long) idx;
+      *value = wrapping_add(*start_value, (long long) (idx + 1) * 1000);
+      break;
+    default:
+      *start_value = idx % 2 == 0 ? LLONG_MIN / 2 : 12345;
+      *value = wrapping_add(*start_value, (long long) ((0x3FFFFFFFFFFFFFFFull >> idx) | 1));
+      if (idx % 4 == 1) {
+        *value = wrapping_sub(*start_value, (long long) (0x123456789ABCDEFull << idx));
+      }
+      break;
+  }
+}
+
+// Every kernel that the processor supports matches the scalar subtract, add, minimum, maximum and square on exactly its
+// number of events, including events that wrap around, negative differences and values that doubles round
+void test_kernels() {
+  for (size_t isa = 0; isa < ACCUMULATE_NUM_ISAS; isa++) {
+    if (find_accumulate_kernel(isa, 1) == NULL) {
+      printf("Skipping the %s kernels, which are not supported\n", isa_names[isa]);
+      continue;
+    }
+    for (size_t num_events = 0; num_events <= STOPWATCH_MAX_EVENTS; num_events++) {
+      const AccumulateKernel kernel = find_accumulate_kernel(isa, num_events);
+      assert(kernel != NULL);
+
+      struct EventTotals totals;
+      struct EventTotals expected_totals;
+      clear_event_totals(&totals);
+      // Totals near LLONG_MAX wrap around as well
+      for (size_t idx = 0; idx < STOPWATCH_MAX_EVENTS; idx++) {
+        EVENT_TOTAL(&totals, sums, idx) = idx < num_events ? LLONG_MAX - (long long) idx * 100 : GUARD_VALUE;
+        if (idx >= num_events) {
+          EVENT_TOTAL(&totals, mins, idx) = GUARD_VALUE;
+          EVENT_TOTAL(&totals, maxs, idx) = GUARD_VALUE;
+          EVENT_TOTAL(&totals, sums_of_squares, idx) = (double) GUARD_VALUE;
+        }
+      }
+      memcpy(&expected_totals, &totals, sizeof(totals));
+
+      for (size_t round = 0; round < NUM_ROUNDS; round++) {
+        long long values[STOPWATCH_MAX_EVENTS + 1];
+        long long start_values[STOPWATCH_MAX_EVENTS + 1];
+        long long expected_values[STOPWATCH_MAX_EVENTS + 1];
+        for (size_t idx = 0; idx <= STOPWATCH_MAX_EVENTS; idx++) {
+          values[idx] = GUARD_VALUE;
+          start_values[idx] = GUARD_VALUE;
+        }
+        for (size_t idx = 0; idx < num_events; idx++) {
+          set_values(round, idx, &start_values[idx], &values[idx]);
+        }
+        memcpy(expected_values, values, sizeof(values));
+        accumulate_expected(expected_values, start_values, &expected_totals, num_events);
+
+        kernel(values, start_values, &totals);
+        assert(memcmp(values, expected_values, sizeof(values)) == 0);
+        assert(memcmp(&totals, &expected_totals, sizeof(totals)) == 0);
+        // Counters that wrapped around past LLONG_MAX still count what happened in between
+        for (size_t idx = 0; round == 1 && idx < num_events; idx++) {
+          assert(values[idx] == (long long) (idx + 1) * 1000);
+        }
+      }
+    }
+    assert(find_accumulate_kernel(isa, STOPWATCH_MAX_EVENTS + 1) == NULL);
+  }
+}
+
+// A kernel is selected for every number of events
+void test_selection() {
+  for (size_t num_events = 0; num_events <= STOPWATCH_MAX_EVENTS; num_events++) {
+    assert(select_accumulate_kernel(num_events) != NULL);
+  }
+  assert(select_accumulate_kernel(STOPWATCH_MAX_EVENTS + 1) == NULL);
+  assert(select_accumulate_kernel(1) == find_accumulate_kernel(ACCUMULATE_SCALAR, 1));
+}
+
+// Totals of two threads merge into those of both, and taking the first back out leaves the sums of the second
+void test_merge_and_subtract() {
+  const AccumulateKernel kernel = select_accumulate_kernel(2);
+  struct EventTotals first;
+  struct EventTotals second;
+  clear_event_totals(&first);
+  clear_event_totals(&second);
+  const long long start_values[2] = {0, 0};
+  long long values[2] = {5, -3};
+  kernel(values, start_values, &first);
+  values[0] = 9;
+  values[1] = 4;
+  kernel(values, start_values, &first);
+  values[0] = 2;
+  values[1] = 10;
+  kernel(values, start_values, &second);
+
+  struct EventTotals merged;
+  clear_event_totals(&merged);
+  merge_event_totals(&merged, &first, 2);
+  // Merging empty totals changes nothing
+  struct EventTotals empty;
+  clear_event_totals(&empty);
+  merge_event_totals(&merged, &empty, 2);
+  merge_event_totals(&merged, &second, 2);
+  assert(EVENT_TOTAL(&merged, sums, 0) == 16 && EVENT_TOTAL(&merged, sums, 1) == 11);
+  assert(EVENT_TOTAL(&merged, mins, 0) == 2 && EVENT_TOTAL(&merged, mins, 1) == -3);
+  assert(EVENT_TOTAL(&merged, maxs, 0) == 9 && EVENT_TOTAL(&merged, maxs, 1) == 10);
+  assert(EVENT_TOTAL(&merged, sums_of_squares, 0) == 25 + 81 + 4);
+  assert(EVENT_TOTAL(&merged, sums_of_squares, 1) == 9 + 16 + 100);
+
+  subtract_event_totals(&merged, &first, 2);
+  assert(EVENT_TOTAL(&merged, sums, 0) == 2 && EVENT_TOTAL(&merged, sums, 1) == 10);
+  assert(EVENT_TOTAL(&merged, sums_of_squares, 0) == 4 && EVENT_TOTAL(&merged, sums_of_squares, 1) == 100);
+  // Kept from the merged totals
+  assert(EVENT_TOTAL(&merged, mins, 1) == -3 && EVENT_TOTAL(&merged, maxs, 0) == 9);
+}
+
+int main() {
+  test_kernels();
+  test_selection();
+  test_merge_and_subtract();
+}
@@ -0,0 +1,151 @@
+// Tests for the allocation metrics. Built once linked to the wrapping library and once without it, in which case it is
+// run with and without the preloaded library.
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch.h"
+
+#define NUM_ALLOC_METRICS 3
+
+// Index of the first metric, which follows however many events the backend counts
+static size_t first_metric;
+
+static long long metric_total(size_t routine_id, size_t metric_idx) {
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(routine_id, &result) == STOPWATCH_OK);
+  return result.total_event_values[first_metric + metric_idx];
+}
+
+// Allocations are attributed to the routine open on the thread, and enclosing routines keep their peak
+void test_alloc_metrics() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_num_events() >= NUM_ALLOC_METRICS);
+  first_metric = stopwatch_num_events() - NUM_ALLOC_METRICS;
+  assert(strcmp(stopwatch_event_name(first_metric), "allocations") == 0);
+  assert(strcmp(stopwatch_event_name(first_metric + 1), "allocated-bytes") == 0);
+  assert(strcmp(stopwatch_event_name(first_metric + 2), "peak-live-bytes") == 0);
+
+  void *allocations[10];
+  assert(stopwatch_record_start_measurements(1, "churn", 0) == STOPWATCH_OK);
+  for (size_t idx = 0; idx < 10; idx++) {
+    allocations[idx] = malloc(1000);
+    // Keep the compiler from eliding the allocation
+    memset(allocations[idx], 0, 1000);
+  }
+  for (size_t idx = 0; idx < 10; idx++) {
+    free(allocations[idx]);
+  }
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  assert(metric_total(1, 0) == 10);
+  assert(metric_total(1, 1) == 10000);
+  assert(metric_total(1, 2) >= 10000);
+
+  const size_t large_size = 1024 * 1024;
+  assert(stopwatch_record_start_measurements(2, "outer", 0) == STOPWATCH_OK);
+  char *large = calloc(large_size, 1);
+  assert(stopwatch_record_start_measurements(3, "inner", 2) == STOPWATCH_OK);
+  char *small = malloc(100);
+  small = realloc(small, 200);
+  small[0] = large[0];
+  free(small);
+  assert(stopwatch_record_end_measurements(3) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  free(large);
+
+  assert(metric_total(2, 0) == 3);
+  assert(metric_total(2, 1) == (long long) large_size + 300);
+  assert(metric_total(2, 2) >= (long long) large_size);
+  assert(metric_total(3, 0) == 2);
+  assert(metric_total(3, 2) >= 200);
+  assert(metric_total(3, 2) < (long long) large_size);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+static void allocate(size_t routine_id, size_t num_allocations) {
+  assert(stopwatch_record_start_measurements(routine_id, "spread", 0) == STOPWATCH_OK);
+  for (size_t idx = 0; idx < num_allocations; idx++) {
+    char *allocation = malloc(64);
+    allocation[0] = 1;
+    free(allocation);
+  }
+  assert(stopwatch_record_end_measurements(routine_id) == STOPWATCH_OK);
+}
+
+// The number of allocations is known exactly, so the spread of the invocations is too. Snapshot differences do not
+// know the smallest and largest values of the phase, and resetting empties them.
+void test_alloc_spread() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  first_metric = stopwatch_num_events() - NUM_ALLOC_METRICS;
+  allocate(1, 2);
+  allocate(1, 1);
+  allocate(1, 3);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_event_values[first_metric] == 6);
+  assert(result.min_event_values[first_metric] == 1);
+  assert(result.max_event_values[first_metric] == 3);
+  assert(result.sum_squared_event_values[first_metric] == 1 + 4 + 9);
+  assert(result.event_extremes_known);
+
+  struct StopwatchSnapshot *before = stopwatch_snapshot();
+  allocate(1, 5);
+  allocate(1, 4);
+  struct StopwatchSnapshot *after = stopwatch_snapshot();
+  struct StopwatchSnapshot *diff = stopwatch_snapshot_diff(before, after);
+  assert(stopwatch_snapshot_get_results(diff, 1, &result) == STOPWATCH_OK);
+  assert(result.total_event_values[first_metric] == 9);
+  assert(result.sum_squared_event_values[first_metric] == 25 + 16);
+  // The smallest value up to the later snapshot was taken before the phase
+  assert(!result.event_extremes_known);
+  assert(result.min_event_values[first_metric] == 0 && result.max_event_values[first_metric] == 0);
+  stopwatch_print_snapshot_table(diff);
+  // A routine not called in between has no spread
+  allocate(2, 1);
+  stopwatch_destroy_snapshot(diff);
+  stopwatch_destroy_snapshot(before);
+  before = stopwatch_snapshot();
+  diff = stopwatch_snapshot_diff(after, before);
+  assert(stopwatch_snapshot_get_results(diff, 1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 0);
+  assert(result.min_event_values[first_metric] == 0 && result.max_event_values[first_metric] == 0);
+  stopwatch_destroy_snapshot(diff);
+  stopwatch_destroy_snapshot(after);
+  stopwatch_destroy_snapshot(before);
+
+  stopwatch_reset();
+  allocate(1, 2);
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.min_event_values[first_metric] == 2);
+  assert(result.max_event_values[first_metric] == 2);
+  assert(result.sum_squared_event_values[first_metric] == 4);
+  assert(result.event_extremes_known);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+// Without an allocation accounting library the metrics cannot be measured
+void test_alloc_metrics_missing() {
+  assert(stopwatch_init() == STOPWATCH_INVALID_EVENT);
+}
+
+int main() {
+  setenv("STOPWATCH_ALLOC_METRICS", "all", 1);
+#ifdef ALLOC_TESTS_WRAPPED
+  test_alloc_metrics();
+  test_alloc_spread();
+#else
+  if (getenv("LD_PRELOAD")) {
+    test_alloc_metrics();
+    test_alloc_spread();
+  } else {
+    test_alloc_metrics_missing();
+  }
+#endif
+  unsetenv("STOPWATCH_ALLOC_METRICS");
+}
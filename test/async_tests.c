@@ -0,0 +1,130 @@
+// Tests for asynchronous regions, which may end on another thread than they started on
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "stopwatch/stopwatch.h"
+
+// Busy waits rather than sleeping so that the events keep counting
+static void spin_usec(long usec) {
+  struct timespec start;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < usec);
+}
+
+static void *end_on_thread(void *arg) {
+  spin_usec(1000);
+  assert(stopwatch_end_async(arg) == STOPWATCH_OK);
+  return NULL;
+}
+
+// A region that starts and ends on the same thread is measured like any other routine, without being nested
+void test_same_thread() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  struct StopwatchAsyncRegion region;
+  assert(stopwatch_start_async(1, "task", 0, &region) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 0);
+  spin_usec(500);
+  assert(stopwatch_end_async(&region) == STOPWATCH_OK);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 1);
+  assert(result.migrated_times_called == 0);
+  assert(result.total_real_usec >= 500);
+  assert(result.total_event_values[0] > 0);
+
+  // Ending again does nothing
+  assert(stopwatch_end_async(&region) == STOPWATCH_OK);
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 1);
+
+  stopwatch_destroy();
+}
+
+// The real time of a region ending on another thread spans both threads while its events are left out
+void test_other_thread() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  struct StopwatchAsyncRegion region;
+  assert(stopwatch_start_async(1, "task", 0, &region) == STOPWATCH_OK);
+  spin_usec(1000);
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, end_on_thread, &region) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 1);
+  assert(result.migrated_times_called == 1);
+  assert(result.total_real_usec >= 2000);
+  assert(result.total_event_values[0] == 0);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+// Overlapping invocations of the same routine are each measured from their own start
+void test_overlapping() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  struct StopwatchAsyncRegion regions[4];
+  for (size_t idx = 0; idx < 4; idx++) {
+    assert(stopwatch_start_async(2, "chunk", 0, &regions[idx]) == STOPWATCH_OK);
+    spin_usec(200);
+  }
+  // The first started is in flight the longest
+  for (size_t idx = 0; idx < 4; idx++) {
+    assert(stopwatch_end_async(&regions[idx]) == STOPWATCH_OK);
+  }
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 4);
+  assert(result.migrated_times_called == 0);
+  assert(result.total_real_usec >= 800 + 600 + 400 + 200);
+
+  // Regions started before re-initializing are ignored
+  assert(stopwatch_start_async(2, "chunk", 0, &regions[0]) == STOPWATCH_OK);
+  stopwatch_destroy();
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_end_async(&regions[0]) == STOPWATCH_OK);
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 0);
+  stopwatch_destroy();
+}
+
+// Filtered out routines and regions started while paused are not measured
+void test_not_measured() {
+  setenv("STOPWATCH_EXCLUDE", "skipped", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  struct StopwatchAsyncRegion region;
+  assert(stopwatch_start_async(1, "skipped", 0, &region) == STOPWATCH_OK);
+  assert(stopwatch_end_async(&region) == STOPWATCH_OK);
+  stopwatch_pause();
+  assert(stopwatch_start_async(2, "paused", 0, &region) == STOPWATCH_OK);
+  stopwatch_resume();
+  assert(stopwatch_end_async(&region) == STOPWATCH_OK);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 0);
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 0);
+
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_EXCLUDE");
+}
+
+int main() {
+  test_same_thread();
+  test_other_thread();
+  test_overlapping();
+  test_not_measured();
+}
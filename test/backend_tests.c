@@ -0,0 +1,103 @@
+// Tests for selecting the backend the events are counted with
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch.h"
+
+static void measure(size_t routine_id, const char *name, size_t times) {
+  for (size_t idx = 0; idx < times; idx++) {
+    assert(stopwatch_record_start_measurements(routine_id, name, 0) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(routine_id) == STOPWATCH_OK);
+  }
+}
+
+// The timer backend measures real time and calls without any events
+void test_timer_backend() {
+  setenv("STOPWATCH_BACKEND", "timer", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_num_events() == 0);
+
+  measure(1, "step", 3);
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 3);
+  assert(result.num_of_events == 0);
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+
+  // There are no events to select
+  setenv("STOPWATCH_EVENTS", "PAPI_TOT_CYC", 1);
+  assert(stopwatch_init() == STOPWATCH_INVALID_EVENT);
+  unsetenv("STOPWATCH_EVENTS");
+}
+
+// Software events are counted as a group on every thread. Skipped where perf_event_open is not permitted.
+void test_perf_event_backend() {
+  setenv("STOPWATCH_BACKEND", "perf_event", 1);
+  setenv("STOPWATCH_EVENTS", "task-clock,page-faults,context-switches", 1);
+  const enum StopwatchStatus init_status = stopwatch_init();
+  unsetenv("STOPWATCH_EVENTS");
+  if (init_status == STOPWATCH_ERR) {
+    // Built without perf_event
+    return;
+  }
+  if (init_status == STOPWATCH_INVALID_EVENT_COMB) {
+    printf("perf_event_open is not permitted, skipping\n");
+    return;
+  }
+  assert(init_status == STOPWATCH_OK);
+  assert(stopwatch_num_events() == 3);
+
+  struct StopwatchEventInfo info;
+  assert(stopwatch_get_event_info(0, &info) == STOPWATCH_OK);
+  assert(strcmp(info.name, "task-clock") == 0);
+  assert(strcmp(info.units, "nanoseconds") == 0);
+  assert(strcmp(info.component, "perf_event") == 0);
+
+  // Touching fresh pages takes time and faults
+  assert(stopwatch_record_start_measurements(1, "touch", 0) == STOPWATCH_OK);
+  const size_t size = 16 * 1024 * 1024;
+  char *buffer = malloc(size);
+  memset(buffer, 1, size);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  free(buffer);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_event_values[0] > 0);
+  assert(result.total_event_values[1] > 0);
+  assert(result.total_event_values[2] >= 0);
+  stopwatch_destroy();
+
+  setenv("STOPWATCH_EVENTS", "PAPI_TOT_CYC", 1);
+  assert(stopwatch_init() == STOPWATCH_INVALID_EVENT);
+  unsetenv("STOPWATCH_EVENTS");
+}
+
+// The default backend always initializes, falling back to the timer where it cannot count its default events
+void test_default_backend() {
+  unsetenv("STOPWATCH_BACKEND");
+  assert(stopwatch_init() == STOPWATCH_OK);
+  measure(1, "step", 2);
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 2);
+  assert(result.num_of_events == stopwatch_num_events());
+  stopwatch_destroy();
+}
+
+// Backends that are not built in cannot be selected
+void test_unknown_backend() {
+  setenv("STOPWATCH_BACKEND", "unknown", 1);
+  assert(stopwatch_init() == STOPWATCH_ERR);
+}
+
+int main() {
+  test_timer_backend();
+  test_perf_event_backend();
+  test_default_backend();
+  test_unknown_backend();
+  unsetenv("STOPWATCH_BACKEND");
+}
@@ -0,0 +1,129 @@
+// Tests for the header only C++ interface
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "stopwatch/stopwatch.hpp"
+
+// Reference values of the 64 bit FNV-1a hash
+static_assert(stopwatch::fnv1a("") == 14695981039346656037ull, "FNV-1a offset basis");
+static_assert(stopwatch::fnv1a("a") == 0xaf63dc4c8601ec8cull, "FNV-1a of a single character");
+static_assert(stopwatch::fnv1a("foobar") == 0x85944171f73967e8ull, "FNV-1a of a string");
+
+// Prevents the compiler from removing the work that is measured
+static volatile int sink = 0;
+
+static void inner() {
+  STOPWATCH_REGION("cpp-inner");
+  sink++;
+}
+
+static int recursive_region(int depth) {
+  STOPWATCH_REGION("cpp-recursive");
+  sink++;
+  return depth > 0 ? recursive_region(depth - 1) + 1 : 0;
+}
+
+// Runs a timed body that runs the same timed body again on the same thread, as a worker of a parallel algorithm does
+// when it picks up a nested task
+static int reentrant_body(int depth) {
+  auto body = STOPWATCH_TIMED("cpp-reentrant", reentrant_body);
+  return depth > 0 ? body(depth - 1) + 1 : 0;
+}
+
+// Regions with the same name share a routine ID and are nested under the enclosing region
+void test_region_nesting() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  {
+    STOPWATCH_REGION("cpp-outer");
+    inner();
+    inner();
+  }
+
+  const std::size_t outer_id = stopwatch::RoutineHandle<stopwatch::fnv1a("cpp-outer")>::id;
+  const std::size_t inner_id = stopwatch::RoutineHandle<stopwatch::fnv1a("cpp-inner")>::id;
+  assert(outer_id != 0 && inner_id != 0 && outer_id != inner_id);
+
+  StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(outer_id, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 1);
+  assert(std::strcmp(result.routine_name, "cpp-outer") == 0);
+
+  assert(stopwatch_get_measurement_results(inner_id, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 2);
+  assert(result.caller_routine_id == outer_id);
+
+  stopwatch_destroy();
+}
+
+// Calls of a timed function on other threads are nested under the region that created it
+void test_timed_threads() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  const int num_threads = 4;
+  const int calls_per_thread = 100;
+  {
+    STOPWATCH_REGION("cpp-parallel");
+    auto body = STOPWATCH_TIMED("cpp-body", [](int value) { return value + 1; });
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < num_threads; thread++) {
+      threads.emplace_back([&body]() {
+        for (int call = 0; call < calls_per_thread; call++) {
+          assert(body(call) == call + 1);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  const std::size_t parallel_id = stopwatch::RoutineHandle<stopwatch::fnv1a("cpp-parallel")>::id;
+  const std::size_t body_id = stopwatch::RoutineHandle<stopwatch::fnv1a("cpp-body")>::id;
+
+  StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(body_id, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == num_threads * calls_per_thread);
+  assert(result.caller_routine_id == parallel_id);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+// Recursive regions and reentrant timed calls count every call, and leave the region that was open before them as the
+// innermost one
+void test_recursion() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  {
+    STOPWATCH_REGION("cpp-recursion-outer");
+    assert(recursive_region(3) == 3);
+    auto body = STOPWATCH_TIMED("cpp-reentrant", reentrant_body);
+    assert(body(3) == 3);
+    assert(stopwatch_current_routine_id() == stopwatch::RoutineHandle<stopwatch::fnv1a("cpp-recursion-outer")>::id);
+  }
+  assert(stopwatch_current_routine_id() == 0);
+
+  const std::size_t outer_id = stopwatch::RoutineHandle<stopwatch::fnv1a("cpp-recursion-outer")>::id;
+  StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(outer_id, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 1);
+
+  const std::size_t recursive_id = stopwatch::RoutineHandle<stopwatch::fnv1a("cpp-recursive")>::id;
+  assert(stopwatch_get_measurement_results(recursive_id, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 4);
+  assert(result.caller_routine_id == outer_id);
+
+  const std::size_t reentrant_id = stopwatch::RoutineHandle<stopwatch::fnv1a("cpp-reentrant")>::id;
+  assert(stopwatch_get_measurement_results(reentrant_id, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 4);
+  assert(result.caller_routine_id == outer_id);
+
+  stopwatch_destroy();
+}
+
+int main() {
+  test_region_nesting();
+  test_timed_threads();
+  test_recursion();
+}
@@ -0,0 +1,152 @@
+// Tests for dumping the totals, both directly and from the signal handler
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+
+static char dump_file_name[64];
+
+static void sleep_usec(long usec) {
+  const struct timespec sleep_time = {0, usec * 1000};
+  nanosleep(&sleep_time, NULL);
+}
+
+// Returns the line of `file` whose first two columns are `thread` and `routine_id`, or NULL if there is none
+static char *find_row(FILE *file, char *line, size_t line_size, long thread, long routine_id) {
+  rewind(file);
+  while (fgets(line, (int) line_size, file)) {
+    long row_thread;
+    long row_id;
+    if (sscanf(line, "%ld,%ld,", &row_thread, &row_id) == 2 && row_thread == thread && row_id == routine_id) {
+      return line;
+    }
+  }
+  return NULL;
+}
+
+// Returns the value of the last column of `line`
+static long long last_column(const char *line) {
+  return strtoll(strrchr(line, ',') + 1, NULL, 10);
+}
+
+// Raising the signal writes the totals of ended routines and the elapsed time of open ones
+void test_dump_on_signal() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  for (int idx = 0; idx < 3; idx++) {
+    assert(stopwatch_record_start_measurements(2, "inner", 1) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  }
+  assert(stopwatch_record_start_measurements(1, "outer", 0) == STOPWATCH_OK);
+  sleep_usec(2000);
+  assert(raise(SIGUSR1) == 0);
+
+  FILE *file = fopen(dump_file_name, "r");
+  assert(file != NULL);
+  char line[512];
+  assert(fgets(line, sizeof(line), file));
+  // A column for each event the backend counts
+  char header[512] = "THREAD,ID,NAME,CALLER_ID,TIMES_CALLED,TOTAL_REAL_MICROSECONDS";
+  for (size_t idx = 0; idx < stopwatch_num_events(); idx++) {
+    strcat(header, ",");
+    strcat(header, stopwatch_event_name(idx));
+  }
+  strcat(header, ",OPEN_REAL_MICROSECONDS\n");
+  assert(strcmp(line, header) == 0);
+
+  assert(find_row(file, line, sizeof(line), 0, 2));
+  assert(strncmp(line, "0,2,inner,1,3,", strlen("0,2,inner,1,3,")) == 0);
+  assert(last_column(line) == 0);
+
+  assert(find_row(file, line, sizeof(line), 0, 1));
+  assert(strncmp(line, "0,1,outer,0,0,0,", strlen("0,1,outer,0,0,0,")) == 0);
+  assert(last_column(line) >= 2000);
+
+  assert(!find_row(file, line, sizeof(line), 0, 3));
+  fclose(file);
+  remove(dump_file_name);
+
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  stopwatch_destroy();
+}
+
+// The previous disposition is restored by destroy
+void test_dump_handler_restored() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  stopwatch_destroy();
+
+  struct sigaction action;
+  assert(sigaction(SIGUSR1, NULL, &action) == 0);
+  assert(action.sa_handler == SIG_DFL);
+}
+
+// Dumping to a descriptor writes one row per routine that was called
+void test_dump_to_pipe() {
+  unsetenv("STOPWATCH_DUMP_FILE");
+  assert(stopwatch_init() == STOPWATCH_OK);
+  struct sigaction action;
+  assert(sigaction(SIGUSR1, NULL, &action) == 0);
+  assert(action.sa_handler == SIG_DFL);
+
+  assert(stopwatch_record_start_measurements(4, "step", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(4) == STOPWATCH_OK);
+
+  int fds[2];
+  assert(pipe(fds) == 0);
+  assert(stopwatch_dump(fds[1]) == STOPWATCH_OK);
+  close(fds[1]);
+
+  FILE *file = fdopen(fds[0], "r");
+  char line[512];
+  size_t num_lines = 0;
+  while (fgets(line, sizeof(line), file)) {
+    num_lines++;
+  }
+  fclose(file);
+  assert(num_lines == 2);
+
+  // Writing to a closed descriptor fails
+  assert(stopwatch_dump(fds[1]) == STOPWATCH_ERR);
+  stopwatch_destroy();
+}
+
+// An open invocation that sampling skips only counted, so its open time is unknown and left empty
+void test_dump_unsampled_open() {
+  unsetenv("STOPWATCH_DUMP_FILE");
+  setenv("STOPWATCH_SAMPLED", "sampled", 1);
+  setenv("STOPWATCH_SAMPLING_INTERVAL", "4", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  // The first invocation is measured and the next three are skipped
+  assert(stopwatch_record_start_measurements(5, "sampled", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(5) == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(5, "sampled", 0) == STOPWATCH_OK);
+
+  FILE *file = tmpfile();
+  assert(file != NULL);
+  assert(stopwatch_dump(fileno(file)) == STOPWATCH_OK);
+  char line[512];
+  assert(find_row(file, line, sizeof(line), 0, 5));
+  assert(strncmp(line, "0,5,sampled,0,1,", strlen("0,5,sampled,0,1,")) == 0);
+  assert(strcmp(strrchr(line, ','), ",\n") == 0);
+  fclose(file);
+
+  assert(stopwatch_record_end_measurements(5) == STOPWATCH_OK);
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_SAMPLING_INTERVAL");
+  unsetenv("STOPWATCH_SAMPLED");
+}
+
+int main() {
+  snprintf(dump_file_name, sizeof(dump_file_name), "dump_tests_%d.csv", (int) getpid());
+  setenv("STOPWATCH_DUMP_FILE", dump_file_name, 1);
+  test_dump_on_signal();
+  test_dump_handler_restored();
+  test_dump_to_pipe();
+  test_dump_unsampled_open();
+}
@@ -0,0 +1,173 @@
+// Tests for the routine filters read from the environment by stopwatch_init and for pausing measurements
+#include <assert.h>
+#include <stdlib.h>
+
+#include "stopwatch/stopwatch.h"
+
+// Measures main -> solve -> kernel_a and main -> solve -> kernel_b, each once
+static void measure_call_tree() {
+  assert(stopwatch_record_start_measurements(1, "main", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(2, "solve", 1) == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(3, "kernel_a", 2) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(3) == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(4, "kernel_b", 2) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(4) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+}
+
+static long long times_called(size_t routine_id) {
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(routine_id, &result) == STOPWATCH_OK);
+  return result.total_times_called;
+}
+
+// Every routine is measured without any filters
+void test_no_filters() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  measure_call_tree();
+  for (size_t idx = 1; idx <= 4; idx++) {
+    assert(times_called(idx) == 1);
+  }
+  stopwatch_destroy();
+}
+
+// Only routines matching an include glob are measured
+void test_include_filter() {
+  setenv("STOPWATCH_INCLUDE", "main,kernel_*", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  measure_call_tree();
+  assert(times_called(1) == 1);
+  assert(times_called(2) == 0);
+  assert(times_called(3) == 1);
+  assert(times_called(4) == 1);
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_INCLUDE");
+}
+
+// Routines matching an exclude glob are not measured, even if included
+void test_exclude_filter() {
+  setenv("STOPWATCH_INCLUDE", ",kernel_*", 1);
+  setenv("STOPWATCH_EXCLUDE", "*_b", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  measure_call_tree();
+  assert(times_called(1) == 0);
+  assert(times_called(2) == 0);
+  assert(times_called(3) == 1);
+  assert(times_called(4) == 0);
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_INCLUDE");
+  unsetenv("STOPWATCH_EXCLUDE");
+}
+
+// Routines nested deeper than the maximum depth are not measured
+void test_max_depth() {
+  setenv("STOPWATCH_MAX_DEPTH", "2", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  measure_call_tree();
+  assert(times_called(1) == 1);
+  assert(times_called(2) == 1);
+  assert(times_called(3) == 0);
+  assert(times_called(4) == 0);
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_MAX_DEPTH");
+}
+
+// Nothing is measured when disabled, but every call still succeeds
+void test_disabled() {
+  setenv("STOPWATCH_ENABLE", "off", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  measure_call_tree();
+  for (size_t idx = 1; idx <= 4; idx++) {
+    assert(times_called(idx) == 0);
+  }
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_ENABLE");
+
+  // Measuring again once re-enabled
+  assert(stopwatch_init() == STOPWATCH_OK);
+  measure_call_tree();
+  assert(times_called(1) == 1);
+  stopwatch_destroy();
+}
+
+// Routines started while paused are not measured. Routines started before pausing are still measured.
+void test_pause_resume() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(1, "main", 0) == STOPWATCH_OK);
+
+  stopwatch_pause();
+  assert(stopwatch_record_start_measurements(2, "warm_up", 1) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  stopwatch_resume();
+
+  assert(stopwatch_record_start_measurements(2, "warm_up", 1) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+
+  stopwatch_pause();
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  stopwatch_resume();
+
+  assert(times_called(1) == 1);
+  assert(times_called(2) == 1);
+  assert(stopwatch_current_routine_id() == 0);
+  stopwatch_destroy();
+}
+
+// The innermost open routine is the one started last and not yet ended, whatever order routines end in and whether
+// they were measured or not
+void test_open_routines() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  // Ended out of order
+  assert(stopwatch_record_start_measurements(1, "first", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(2, "second", 1) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 2);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 0);
+
+  // Ending routines that are not open changes nothing
+  assert(stopwatch_record_start_measurements(1, "first", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(3) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 1);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 0);
+
+  // A recursive invocation started while paused ends itself rather than the open invocation
+  assert(stopwatch_record_start_measurements(1, "first", 0) == STOPWATCH_OK);
+  stopwatch_pause();
+  assert(stopwatch_record_start_measurements(1, "first", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  stopwatch_resume();
+  assert(stopwatch_current_routine_id() == 1);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 0);
+
+  // Recursion
+  for (size_t depth = 0; depth < 4; depth++) {
+    assert(stopwatch_record_start_measurements(2, "second", 0) == STOPWATCH_OK);
+    assert(stopwatch_current_routine_id() == 2);
+  }
+  for (size_t depth = 0; depth < 4; depth++) {
+    assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  }
+  assert(stopwatch_current_routine_id() == 0);
+
+  assert(times_called(1) == 4);
+  assert(times_called(2) == 5);
+  stopwatch_destroy();
+}
+
+int main() {
+  test_no_filters();
+  test_include_filter();
+  test_exclude_filter();
+  test_max_depth();
+  test_disabled();
+  test_pause_resume();
+  test_open_routines();
+}
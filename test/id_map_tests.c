@@ -0,0 +1,187 @@
+// Tests for the sparse routine IDs and the map translating them to the entries the measurements are stored at
+#include "id_map.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+
+#define NUM_MAP_IDS 10000
+
+// Stands in for the 64-bit hash of a routine name used as its ID
+static size_t hashed_id(size_t seed) {
+  uint64_t hash = (uint64_t) seed + 0x9E3779B97F4A7C15ull;
+  hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+  hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+  hash ^= hash >> 31;
+  return hash ? (size_t) hash : 1;
+}
+
+// The map keeps every ID through growing, both consecutive and hashed IDs
+void test_map_growth() {
+  // Static as maps are never freed
+  static struct IdMap map = {NULL};
+  assert(id_map_find(&map, 0) == 0);
+  assert(id_map_find(&map, 1) == ID_MAP_NOT_FOUND);
+
+  for (size_t entry = 1; entry <= NUM_MAP_IDS; entry++) {
+    assert(id_map_insert(&map, entry, entry));
+    assert(id_map_insert(&map, hashed_id(entry), NUM_MAP_IDS + entry));
+  }
+  const struct IdMapTable *table = map.table;
+  assert(2 * table->num_ids <= table->num_buckets);
+  assert(table->num_ids == 2 * NUM_MAP_IDS);
+  for (size_t entry = 1; entry <= NUM_MAP_IDS; entry++) {
+    assert(id_map_find(&map, entry) == entry);
+    assert(id_map_find(&map, hashed_id(entry)) == NUM_MAP_IDS + entry);
+  }
+  assert(id_map_find(&map, NUM_MAP_IDS + 1) == ID_MAP_NOT_FOUND);
+  assert(id_map_find(&map, SIZE_MAX) == ID_MAP_NOT_FOUND);
+}
+
+struct LookupArgs {
+  struct IdMap *map;
+  size_t num_inserted;  // Only accessed through atomic builtins
+};
+
+// Every ID inserted before the lookup started must be found, whichever table it is in
+static void *look_up_inserted(void *arg) {
+  struct LookupArgs *args = arg;
+  size_t num_inserted;
+  do {
+    num_inserted = __atomic_load_n(&args->num_inserted, __ATOMIC_ACQUIRE);
+    for (size_t seed = 1; seed <= num_inserted; seed++) {
+      assert(id_map_find(args->map, hashed_id(seed)) == seed);
+    }
+  } while (num_inserted < NUM_MAP_IDS);
+  return NULL;
+}
+
+// Lookups running while the map grows never miss an ID
+void test_concurrent_lookups() {
+  static struct IdMap map = {NULL};
+  struct LookupArgs args = {&map, 0};
+  pthread_t threads[2];
+  for (size_t idx = 0; idx < 2; idx++) {
+    assert(pthread_create(&threads[idx], NULL, look_up_inserted, &args) == 0);
+  }
+  for (size_t seed = 1; seed <= NUM_MAP_IDS; seed++) {
+    assert(id_map_insert(&map, hashed_id(seed), seed));
+    __atomic_store_n(&args.num_inserted, seed, __ATOMIC_RELEASE);
+  }
+  for (size_t idx = 0; idx < 2; idx++) {
+    assert(pthread_join(threads[idx], NULL) == 0);
+  }
+}
+
+// Hashed IDs are measured, nested and reported like small ones
+void test_hashed_routine_ids() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  const size_t outer = hashed_id(1);
+  const size_t inner = hashed_id(2);
+  for (size_t idx = 0; idx < 3; idx++) {
+    assert(stopwatch_record_start_measurements(outer, "outer", 0) == STOPWATCH_OK);
+    assert(stopwatch_current_routine_id() == outer);
+    assert(stopwatch_record_start_measurements(inner, "inner", outer) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(inner) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(outer) == STOPWATCH_OK);
+  }
+  // Ending a routine never started is ignored
+  assert(stopwatch_record_end_measurements(hashed_id(3)) == STOPWATCH_OK);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(inner, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 3);
+  assert(result.caller_routine_id == outer);
+  assert(strcmp(result.routine_name, "inner") == 0);
+  assert(stopwatch_get_measurement_results(hashed_id(3), &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 0);
+
+  size_t routine_ids[4];
+  assert(stopwatch_get_routine_ids(routine_ids, 4) == 2);
+  assert(routine_ids[0] == outer);
+  assert(routine_ids[1] == inner);
+  assert(stopwatch_get_routine_ids(routine_ids, 1) == 1);
+
+  char file_name[64];
+  snprintf(file_name, sizeof(file_name), "id_map_tests_%d.csv", (int) getpid());
+  assert(stopwatch_result_to_csv(file_name) == STOPWATCH_OK);
+  FILE *csv = fopen(file_name, "r");
+  assert(csv != NULL);
+  char line[1024];
+  char expected[64];
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  snprintf(expected, sizeof(expected), "%zu,outer,", outer);
+  assert(strncmp(line, expected, strlen(expected)) == 0);
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  snprintf(expected, sizeof(expected), "%zu,inner,", inner);
+  assert(strncmp(line, expected, strlen(expected)) == 0);
+  fclose(csv);
+  remove(file_name);
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+// Registered IDs count down from SIZE_MAX and skip IDs that were already used by hand
+void test_registered_ids() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(SIZE_MAX, "by hand", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(SIZE_MAX) == STOPWATCH_OK);
+
+  size_t first_id = 0;
+  size_t second_id = 0;
+  assert(stopwatch_register_routine("first", &first_id) == STOPWATCH_OK);
+  assert(stopwatch_register_routine("second", &second_id) == STOPWATCH_OK);
+  assert(first_id == SIZE_MAX - 1);
+  assert(second_id == SIZE_MAX - 2);
+  // Already registered
+  assert(stopwatch_register_routine("first", &first_id) == STOPWATCH_OK);
+  assert(first_id == SIZE_MAX - 1);
+
+  assert(stopwatch_record_start_registered(first_id) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(first_id) == STOPWATCH_OK);
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(first_id, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 1);
+  assert(strcmp(result.routine_name, "first") == 0);
+  stopwatch_destroy();
+}
+
+// Entries taken so far, main included
+static size_t num_entries() {
+  size_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  return 1 + stopwatch_get_routine_ids(routine_ids, STOPWATCH_MAX_FUNCTION_CALLS);
+}
+
+// Once every entry is taken new IDs are refused, while the ones already seen are still measured
+void test_exhausted_entries() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  // Entries taken by the earlier tests count as well
+  for (size_t seed = 1; num_entries() < STOPWATCH_MAX_FUNCTION_CALLS; seed++) {
+    assert(stopwatch_record_start_measurements(hashed_id(seed), "routine", 0) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(hashed_id(seed)) == STOPWATCH_OK);
+  }
+  assert(stopwatch_record_start_measurements(hashed_id(STOPWATCH_MAX_FUNCTION_CALLS), "routine", 0) == STOPWATCH_ERR);
+  assert(stopwatch_add_work(hashed_id(STOPWATCH_MAX_FUNCTION_CALLS), 0, 1) == STOPWATCH_ERR);
+  assert(stopwatch_record_start_measurements(hashed_id(1), "routine", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(hashed_id(1)) == STOPWATCH_OK);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(hashed_id(1), &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 2);
+  stopwatch_destroy();
+}
+
+int main() {
+  test_map_growth();
+  test_concurrent_lookups();
+  test_hashed_routine_ids();
+  test_registered_ids();
+  // Last, as entries are never given back
+  test_exhausted_entries();
+}
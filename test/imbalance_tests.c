@@ -0,0 +1,99 @@
+// Tests for the load imbalance report, which compares the totals of a routine between the threads that measured it
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+
+#define NUM_THREADS 4
+
+// A fixed amount of work rather than a wall clock duration, so that the order of the threads does not depend on how
+// long each one happens to be preempted
+static void spin(size_t iterations) {
+  volatile size_t sum = 0;
+  for (size_t idx = 0; idx < iterations; idx++) {
+    sum += idx;
+  }
+}
+
+// The last thread does twenty times the work of the others
+static void *work(void *arg) {
+  const size_t thread_num = *(const size_t *) arg;
+  assert(stopwatch_record_start_measurements(1, "sweep", 0) == STOPWATCH_OK);
+  spin(thread_num == NUM_THREADS - 1 ? 40000000 : 2000000);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  return NULL;
+}
+
+// Threads are started one after the other so that their thread indices follow their numbers
+static void run_threads() {
+  size_t thread_nums[NUM_THREADS];
+  for (size_t idx = 0; idx < NUM_THREADS; idx++) {
+    thread_nums[idx] = idx;
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, work, &thread_nums[idx]) == 0);
+    assert(pthread_join(thread, NULL) == 0);
+  }
+}
+
+// The spread of a routine covers only the threads that measured it, and names the slowest one
+void test_imbalance() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  assert(stopwatch_record_start_measurements(2, "main only", 0) == STOPWATCH_OK);
+  run_threads();
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+
+  struct StopwatchImbalance imbalance;
+  assert(stopwatch_get_imbalance(1, &imbalance) == STOPWATCH_OK);
+  assert(imbalance.routine_id == 1);
+  assert(imbalance.num_threads == NUM_THREADS);
+  assert(imbalance.slowest_thread_index == NUM_THREADS);
+  assert(imbalance.min_real_usec > 0 && imbalance.min_real_usec < imbalance.max_real_usec);
+  assert(imbalance.min_real_usec <= imbalance.avg_real_usec && imbalance.avg_real_usec <= imbalance.max_real_usec);
+  // About (20 - 23 / 4) / 20 when the threads are not preempted, and still well above zero when they are
+  assert(imbalance.imbalance > 0.3 && imbalance.imbalance < 1);
+  assert(imbalance.min_event_values[0] > 0);
+  assert(imbalance.min_event_values[0] <= imbalance.avg_event_values[0]);
+  assert(imbalance.avg_event_values[0] <= imbalance.max_event_values[0]);
+
+  // A routine of a single thread is perfectly balanced
+  assert(stopwatch_get_imbalance(2, &imbalance) == STOPWATCH_OK);
+  assert(imbalance.num_threads == 1);
+  assert(imbalance.slowest_thread_index == 0);
+  assert(imbalance.min_real_usec == imbalance.max_real_usec);
+  assert(imbalance.imbalance == 0);
+
+  // Nothing measured the routine
+  assert(stopwatch_get_imbalance(3, &imbalance) == STOPWATCH_OK);
+  assert(imbalance.num_threads == 0);
+  assert(imbalance.max_real_usec == 0);
+  assert(stopwatch_get_imbalance(STOPWATCH_MAX_FUNCTION_CALLS, &imbalance) == STOPWATCH_OK);
+  assert(imbalance.num_threads == 0);
+
+  // Only routines measured on more than one thread are saved
+  char file_name[64];
+  snprintf(file_name, sizeof(file_name), "imbalance_tests_%d.csv", (int) getpid());
+  assert(stopwatch_imbalance_to_csv(file_name) == STOPWATCH_OK);
+  FILE *csv = fopen(file_name, "r");
+  assert(csv != NULL);
+  char line[512];
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  const char *header = "ID,NAME,THREADS,MIN_REAL_MICROSECONDS,AVG_REAL_MICROSECONDS,MAX_REAL_MICROSECONDS,IMBALANCE,"
+                       "SLOWEST_THREAD,MIN_";
+  assert(strncmp(line, header, strlen(header)) == 0);
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  assert(strncmp(line, "1,sweep,4,", 10) == 0);
+  assert(fgets(line, sizeof(line), csv) == NULL);
+  fclose(csv);
+  remove(file_name);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+int main() {
+  test_imbalance();
+}
@@ -0,0 +1,82 @@
+// Tests for the stopwatch_instrument library. This file is compiled with -finstrument-functions so every function in
+// it is measured automatically once the stopwatch is initialized.
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_instrument.h"
+
+// Prevents the compiler from removing calls to the functions that are measured
+static volatile int sink = 0;
+
+static void leaf() {
+  sink++;
+}
+
+static void branch() {
+  leaf();
+  leaf();
+}
+
+static int recurse(int depth) {
+  return depth == 0 ? 0 : recurse(depth - 1) + 1;
+}
+
+// Searches every ID for a routine with the given name. Returns false if there is none.
+static bool find_routine(const char *name, size_t *routine_id, struct StopwatchMeasurementResult *result) {
+  size_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  const size_t num_routines = stopwatch_get_routine_ids(routine_ids, STOPWATCH_MAX_FUNCTION_CALLS);
+  for (size_t idx = 0; idx < num_routines; idx++) {
+    assert(stopwatch_get_measurement_results(routine_ids[idx], result) == STOPWATCH_OK);
+    if (result->total_times_called > 0 && strcmp(result->routine_name, name) == 0) {
+      *routine_id = routine_ids[idx];
+      return true;
+    }
+  }
+  return false;
+}
+
+// Functions called after initialization are measured, named and nested under the function that called them
+void test_instrument_call_tree() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  branch();
+  branch();
+
+  size_t branch_id;
+  size_t leaf_id;
+  struct StopwatchMeasurementResult branch_result;
+  struct StopwatchMeasurementResult leaf_result;
+  assert(find_routine("branch", &branch_id, &branch_result));
+  assert(find_routine("leaf", &leaf_id, &leaf_result));
+
+  assert(branch_result.total_times_called == 2);
+  assert(leaf_result.total_times_called == 4);
+  assert(leaf_result.caller_routine_id == branch_id);
+
+  // Instrumented functions are given IDs from the top of the ID space
+  assert(branch_id >= SIZE_MAX - STOPWATCH_INSTRUMENT_MAX_FUNCTIONS);
+  assert(leaf_id >= SIZE_MAX - STOPWATCH_INSTRUMENT_MAX_FUNCTIONS);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+// Only the outermost call of a recursive function is measured
+void test_instrument_recursion() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(recurse(10) == 10);
+
+  size_t recurse_id;
+  struct StopwatchMeasurementResult result;
+  assert(find_routine("recurse", &recurse_id, &result));
+  assert(result.total_times_called == 1);
+
+  stopwatch_destroy();
+}
+
+int main() {
+  test_instrument_call_tree();
+  test_instrument_recursion();
+}
@@ -0,0 +1,118 @@
+// Tests for the I/O metrics. Built once linked to the wrapping library and once without it, in which case it is run
+// with and without the preloaded library.
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+
+#define BLOCK_SIZE 4096
+#define WRITER_DELAY_USEC 20000
+
+#define NUM_IO_METRICS 5
+
+// Index of the first metric, which follows however many events the backend counts
+static size_t first_metric;
+
+static long long metric_total(size_t routine_id, size_t metric_idx) {
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(routine_id, &result) == STOPWATCH_OK);
+  return result.total_event_values[first_metric + metric_idx];
+}
+
+static void *write_late(void *arg) {
+  const int fd = *(const int *) arg;
+  const struct timespec delay = {0, WRITER_DELAY_USEC * 1000};
+  nanosleep(&delay, NULL);
+  const char byte = 'x';
+  assert(write(fd, &byte, 1) == 1);
+  return NULL;
+}
+
+// Bytes and calls are attributed to the routine open on the thread, along with the time blocked in the calls
+void test_io_metrics() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_num_events() >= NUM_IO_METRICS);
+  first_metric = stopwatch_num_events() - NUM_IO_METRICS;
+  assert(strcmp(stopwatch_event_name(first_metric), "read-calls") == 0);
+  assert(strcmp(stopwatch_event_name(first_metric + 1), "write-calls") == 0);
+  assert(strcmp(stopwatch_event_name(first_metric + 2), "read-bytes") == 0);
+  assert(strcmp(stopwatch_event_name(first_metric + 3), "write-bytes") == 0);
+  assert(strcmp(stopwatch_event_name(first_metric + 4), "io-blocked-usec") == 0);
+
+  char path[] = "/tmp/stopwatch_io_tests_XXXXXX";
+  const int file_fd = mkstemp(path);
+  assert(file_fd >= 0);
+  unlink(path);
+
+  static char block[BLOCK_SIZE];
+  memset(block, 'a', sizeof(block));
+  assert(stopwatch_record_start_measurements(1, "save", 0) == STOPWATCH_OK);
+  for (int idx = 0; idx < 3; idx++) {
+    assert(write(file_fd, block, sizeof(block)) == BLOCK_SIZE);
+  }
+  assert(stopwatch_record_start_measurements(2, "load", 1) == STOPWATCH_OK);
+  assert(pread(file_fd, block, sizeof(block), BLOCK_SIZE) == BLOCK_SIZE);
+  // Reading past the end is still a call
+  assert(pread(file_fd, block, sizeof(block), 3 * BLOCK_SIZE) == 0);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  assert(pwrite(file_fd, block, 100, 0) == 100);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  close(file_fd);
+
+  assert(metric_total(1, 0) == 2);
+  assert(metric_total(1, 1) == 4);
+  assert(metric_total(1, 2) == BLOCK_SIZE);
+  assert(metric_total(1, 3) == 3 * BLOCK_SIZE + 100);
+  assert(metric_total(2, 0) == 2);
+  assert(metric_total(2, 1) == 0);
+  assert(metric_total(2, 2) == BLOCK_SIZE);
+
+  // Waiting for the pipe is blocked time, which is part of the real time of the routine
+  int pipe_fds[2];
+  assert(pipe(pipe_fds) == 0);
+  pthread_t writer;
+  assert(pthread_create(&writer, NULL, write_late, &pipe_fds[1]) == 0);
+  assert(stopwatch_record_start_measurements(3, "wait", 0) == STOPWATCH_OK);
+  char byte;
+  assert(read(pipe_fds[0], &byte, 1) == 1);
+  assert(stopwatch_record_end_measurements(3) == STOPWATCH_OK);
+  assert(pthread_join(writer, NULL) == 0);
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(3, &result) == STOPWATCH_OK);
+  assert(result.total_event_values[first_metric] == 1);
+  assert(result.total_event_values[first_metric + 2] == 1);
+  assert(result.total_event_values[first_metric + 4] >= WRITER_DELAY_USEC / 2);
+  assert(result.total_event_values[first_metric + 4] <= result.total_real_usec);
+  // The writing thread has its own counters
+  assert(result.total_event_values[first_metric + 1] == 0);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+// Without an I/O accounting library the metrics cannot be measured
+void test_io_metrics_missing() {
+  assert(stopwatch_init() == STOPWATCH_INVALID_EVENT);
+}
+
+int main() {
+  setenv("STOPWATCH_IO_METRICS", "all", 1);
+#ifdef IO_TESTS_WRAPPED
+  test_io_metrics();
+#else
+  if (getenv("LD_PRELOAD")) {
+    test_io_metrics();
+  } else {
+    test_io_metrics_missing();
+  }
+#endif
+  unsetenv("STOPWATCH_IO_METRICS");
+}
@@ -0,0 +1,150 @@
+// Tests for the MPI library. Run on four ranks, the totals are only checked on rank 0 after they are reduced.
+#include <assert.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_mpi.h"
+
+#define NUM_STEPS 3
+#define NUM_VALUES 100
+#define SUMMARY_FILE "mpi_tests_summary.csv"
+
+// Finds the routine named `name` whose caller is `caller_id`. Returns 0 if there is none.
+static size_t find_routine(const char *name, size_t caller_id) {
+  size_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  const size_t num_routines = stopwatch_get_routine_ids(routine_ids, STOPWATCH_MAX_FUNCTION_CALLS);
+  struct StopwatchMeasurementResult result;
+  for (size_t idx = 0; idx < num_routines; idx++) {
+    if (stopwatch_get_measurement_results(routine_ids[idx], &result) == STOPWATCH_OK && result.total_times_called > 0 &&
+        strcmp(result.routine_name, name) == 0 && result.caller_routine_id == caller_id) {
+      return routine_ids[idx];
+    }
+  }
+  return 0;
+}
+
+// Copies the row of the summary whose path is `path` into `row`. Returns whether there is one.
+static int find_row(const char *path, char *row, size_t row_size) {
+  FILE *csv = fopen(SUMMARY_FILE, "r");
+  assert(csv != NULL);
+  const size_t path_length = strlen(path);
+  int found = 0;
+  while (!found && fgets(row, (int) row_size, csv) != NULL) {
+    found = strncmp(row, path, path_length) == 0 && row[path_length] == ',';
+  }
+  fclose(csv);
+  return found;
+}
+
+// Each rank exchanges with its neighbours in a ring while rank 3 computes the longest
+static void run_steps(int rank, int num_ranks) {
+  double send_values[NUM_VALUES] = {0};
+  double recv_values[NUM_VALUES];
+  for (int step = 0; step < NUM_STEPS; step++) {
+    assert(stopwatch_record_start_measurements(1, "step", 0) == STOPWATCH_OK);
+
+    assert(stopwatch_record_start_measurements(2, "compute", 1) == STOPWATCH_OK);
+    usleep(rank == 3 ? 20000 : 2000);
+    assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+
+    MPI_Sendrecv(send_values,
+                 NUM_VALUES,
+                 MPI_DOUBLE,
+                 (rank + 1) % num_ranks,
+                 0,
+                 recv_values,
+                 NUM_VALUES,
+                 MPI_DOUBLE,
+                 (rank + num_ranks - 1) % num_ranks,
+                 0,
+                 MPI_COMM_WORLD,
+                 MPI_STATUS_IGNORE);
+    long long local_sums[4] = {rank, rank, rank, rank};
+    long long global_sums[4];
+    MPI_Allreduce(local_sums, global_sums, 4, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  }
+}
+
+// MPI calls are nested in the region they are called in, and the totals of every rank are reduced into one file
+void test_mpi_summary(int rank, int num_ranks) {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  run_steps(rank, num_ranks);
+
+  // Calls made before by MPI_Init or outside of any region are not nested
+  const size_t allreduce_id = find_routine("MPI_Allreduce", 1);
+  assert(allreduce_id != 0);
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(allreduce_id, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == NUM_STEPS);
+  assert(find_routine("MPI_Sendrecv", 1) != 0);
+  assert(find_routine("MPI_Barrier", 1) != 0);
+  if (rank == 0) {
+    stopwatch_print_result_table();
+  }
+
+  setenv("STOPWATCH_MPI_SUMMARY", SUMMARY_FILE, 1);
+  MPI_Finalize();
+
+  if (rank == 0) {
+    char row[1024];
+    FILE *csv = fopen(SUMMARY_FILE, "r");
+    assert(csv != NULL);
+    assert(fgets(row, sizeof(row), csv) != NULL);
+    const char *header = "PATH,RANKS,TOTAL_CALLS,TOTAL_BYTES,MIN_REAL_MICROSECONDS,AVG_REAL_MICROSECONDS,"
+                         "MAX_REAL_MICROSECONDS,IMBALANCE,SLOWEST_RANK";
+    assert(strncmp(row, header, strlen(header)) == 0);
+    // Followed by the spread of each event the backend counts
+    char first_event[STOPWATCH_EVENT_NAME_LEN + 8] = "\n";
+    if (stopwatch_num_events() > 0) {
+      snprintf(first_event, sizeof(first_event), ",MIN_%s,", stopwatch_event_name(0));
+    }
+    assert(strncmp(row + strlen(header), first_event, strlen(first_event)) == 0);
+    fclose(csv);
+
+    assert(find_row("step", row, sizeof(row)));
+    assert(strncmp(row, "step,4,12,0,", 12) == 0);
+    assert(find_row("step/MPI_Allreduce", row, sizeof(row)));
+    assert(strncmp(row, "step/MPI_Allreduce,4,12,384,", 28) == 0);
+    assert(find_row("step/MPI_Sendrecv", row, sizeof(row)));
+    assert(strncmp(row, "step/MPI_Sendrecv,4,12,9600,", 28) == 0);
+    assert(find_row("step/MPI_Barrier", row, sizeof(row)));
+
+    // Rank 3 computes ten times as long as the others
+    assert(find_row("step/compute", row, sizeof(row)));
+    long long min_usec;
+    double avg_usec;
+    long long max_usec;
+    double imbalance;
+    int slowest_rank;
+    assert(sscanf(row,
+                  "step/compute,4,12,0,%lld,%lf,%lld,%lf,%d",
+                  &min_usec,
+                  &avg_usec,
+                  &max_usec,
+                  &imbalance,
+                  &slowest_rank) == 5);
+    assert(min_usec >= NUM_STEPS * 2000 && max_usec >= NUM_STEPS * 20000);
+    assert(min_usec <= avg_usec && avg_usec <= max_usec);
+    assert(imbalance > 0.3);
+    assert(slowest_rank == 3);
+    remove(SUMMARY_FILE);
+  }
+  stopwatch_destroy();
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  int rank;
+  int num_ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  assert(num_ranks == 4);
+  test_mpi_summary(rank, num_ranks);
+}
@@ -0,0 +1,97 @@
+// Tests for the OpenMP tool. Compiled with -fopenmp but run on LLVM libomp, as libgomp does not support OMPT.
+#include <assert.h>
+#include <omp.h>
+#include <string.h>
+#include <time.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_ompt.h"
+
+#define NUM_THREADS 4
+
+// Busy waits rather than sleeping so that the threads are working
+static void spin_usec(long usec) {
+  struct timespec start;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < usec);
+}
+
+// Finds the routine named `name` whose caller is `caller_id`. Returns 0 if there is none.
+static size_t find_routine(const char *name, size_t caller_id) {
+  size_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  const size_t num_routines = stopwatch_get_routine_ids(routine_ids, STOPWATCH_MAX_FUNCTION_CALLS);
+  struct StopwatchMeasurementResult result;
+  for (size_t idx = 0; idx < num_routines; idx++) {
+    if (stopwatch_get_measurement_results(routine_ids[idx], &result) == STOPWATCH_OK && result.total_times_called > 0 &&
+        strcmp(result.routine_name, name) == 0 && result.caller_routine_id == caller_id) {
+      return routine_ids[idx];
+    }
+  }
+  return 0;
+}
+
+static struct StopwatchMeasurementResult get_result(size_t routine_id) {
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(routine_id, &result) == STOPWATCH_OK);
+  return result;
+}
+
+// Parallel regions, their threads, loops and waits are nested under the region of the program that encloses them
+void test_parallel_region() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  omp_lock_t lock;
+  omp_init_lock(&lock);
+  assert(stopwatch_record_start_measurements(1, "solve", 0) == STOPWATCH_OK);
+  for (int step = 0; step < 2; step++) {
+#pragma omp parallel num_threads(NUM_THREADS)
+    {
+      // Thread 0 works the longest so the others wait at the barrier ending the loop
+#pragma omp for schedule(dynamic, 1)
+      for (int idx = 0; idx < NUM_THREADS; idx++) {
+        spin_usec(idx == 0 ? 20000 : 1000);
+      }
+
+      omp_set_lock(&lock);
+      spin_usec(1000);
+      omp_unset_lock(&lock);
+    }
+  }
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  omp_destroy_lock(&lock);
+
+  const size_t parallel_id = find_routine("omp parallel", 1);
+  assert(parallel_id != 0);
+  assert(get_result(parallel_id).total_times_called == 2);
+
+  const size_t thread_id = find_routine("omp thread", parallel_id);
+  assert(thread_id != 0);
+  // libomp keeps the threads of a team waiting for the next region and only ends their implicit tasks when that
+  // region starts, so the workers of the last region are not counted yet
+  const long long thread_calls = get_result(thread_id).total_times_called;
+  assert(thread_calls >= 2 && thread_calls <= 2 * NUM_THREADS);
+
+  const size_t loop_id = find_routine("omp loop", thread_id);
+  assert(loop_id != 0);
+  assert(get_result(loop_id).total_times_called >= 2);
+
+  // The faster threads wait for thread 0 at the barrier ending the loop
+  const size_t barrier_id = find_routine("omp barrier", thread_id);
+  assert(barrier_id != 0);
+  assert(get_result(barrier_id).total_real_usec >= 15000);
+
+  // Every thread acquires the lock once per step, waiting for it or not
+  const size_t lock_wait_id = find_routine("omp lock wait", thread_id);
+  assert(lock_wait_id != 0);
+  assert(get_result(lock_wait_id).total_times_called == 2 * NUM_THREADS);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+int main() {
+  test_parallel_region();
+}
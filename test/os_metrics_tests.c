@@ -0,0 +1,113 @@
+// Tests for the operating system metrics measured alongside the events
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stopwatch/stopwatch.h"
+
+#define NUM_OS_METRICS 5
+
+// Events of the backend, which the metrics follow. None with the timer backend.
+static size_t num_backend_events;
+static char first_event_name[STOPWATCH_EVENT_NAME_LEN];
+
+static long long metric_total(size_t routine_id, size_t metric_idx) {
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(routine_id, &result) == STOPWATCH_OK);
+  return result.total_event_values[num_backend_events + metric_idx];
+}
+
+static void find_backend_events() {
+  unsetenv("STOPWATCH_OS_METRICS");
+  assert(stopwatch_init() == STOPWATCH_OK);
+  num_backend_events = stopwatch_num_events();
+  if (num_backend_events > 0) {
+    strncpy(first_event_name, stopwatch_event_name(0), sizeof(first_event_name) - 1);
+  }
+  stopwatch_destroy();
+}
+
+// Every metric follows the events of the backend and accumulates per region
+void test_all_os_metrics() {
+  setenv("STOPWATCH_OS_METRICS", "all", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_num_events() == num_backend_events + NUM_OS_METRICS);
+  assert(strcmp(stopwatch_event_name(num_backend_events), "minor-faults") == 0);
+  assert(strcmp(stopwatch_event_name(num_backend_events + 4), "max-rss-growth") == 0);
+
+  struct StopwatchEventInfo info;
+  assert(stopwatch_get_event_info(num_backend_events + 4, &info) == STOPWATCH_OK);
+  assert(strcmp(info.component, "rusage") == 0);
+  assert(strcmp(info.units, "kilobytes") == 0);
+
+  // Touching fresh pages faults them in and grows the resident set
+  const size_t size = 64 * 1024 * 1024;
+  assert(stopwatch_record_start_measurements(1, "touch", 0) == STOPWATCH_OK);
+  char *buffer = malloc(size);
+  memset(buffer, 1, size);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  free(buffer);
+  assert(metric_total(1, 0) > 0);
+  assert(metric_total(1, 4) > 0);
+
+  // Sleeping gives up the processor
+  assert(stopwatch_record_start_measurements(2, "sleep", 0) == STOPWATCH_OK);
+  const struct timespec sleep_time = {0, 1000000};
+  nanosleep(&sleep_time, NULL);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  assert(metric_total(2, 2) > 0);
+
+  const char *file_name = "os_metrics_tests.csv";
+  assert(stopwatch_result_to_csv(file_name) == STOPWATCH_OK);
+  FILE *file = fopen(file_name, "r");
+  char line[1024];
+  assert(fgets(line, sizeof(line), file));
+  fclose(file);
+  remove(file_name);
+  // Metrics are reported like events, spread included
+  assert(strstr(line, ",minor-faults,major-faults,voluntary-switches,involuntary-switches,max-rss-growth,"));
+  assert(strstr(line, ",max-rss-growth_MIN,max-rss-growth_MAX,max-rss-growth_STDDEV\n"));
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+// Only the listed metrics are measured, and unknown ones are rejected like unknown events
+void test_selected_os_metrics() {
+  setenv("STOPWATCH_OS_METRICS", "major-faults,involuntary-switches", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_num_events() == num_backend_events + 2);
+  assert(strcmp(stopwatch_event_name(num_backend_events + 1), "involuntary-switches") == 0);
+  stopwatch_destroy();
+
+  setenv("STOPWATCH_OS_METRICS", "minor-faults,page-ins", 1);
+  assert(stopwatch_init() == STOPWATCH_INVALID_EVENT);
+  unsetenv("STOPWATCH_OS_METRICS");
+}
+
+// Metrics share the slots of the events, so the events of a backend that counts any can leave too few for them
+void test_os_metrics_share_slots() {
+  if (num_backend_events == 0) {
+    printf("Skipping the shared slots, as the backend counts no events\n");
+    return;
+  }
+  char events[(STOPWATCH_EVENT_NAME_LEN + 1) * STOPWATCH_MAX_EVENTS] = "";
+  for (size_t idx = 0; idx + NUM_OS_METRICS <= STOPWATCH_MAX_EVENTS; idx++) {
+    strcat(events, idx == 0 ? "" : ",");
+    strcat(events, first_event_name);
+  }
+  setenv("STOPWATCH_EVENTS", events, 1);
+  setenv("STOPWATCH_OS_METRICS", "all", 1);
+  assert(stopwatch_init() == STOPWATCH_TOO_MANY_EVENTS);
+  unsetenv("STOPWATCH_EVENTS");
+  unsetenv("STOPWATCH_OS_METRICS");
+}
+
+int main() {
+  find_backend_events();
+  test_all_os_metrics();
+  test_selected_os_metrics();
+  test_os_metrics_share_slots();
+}
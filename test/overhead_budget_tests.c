@@ -0,0 +1,112 @@
+// Tests for the overhead budget, which measures routines less when measuring them costs more than allowed
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+
+#define NUM_HOT_CALLS 5000000
+
+// Busy waits rather than sleeping so that every invocation takes about the same time
+static void spin_usec(long usec) {
+  struct timespec start;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < usec);
+}
+
+static void call(size_t routine_id, const char *name, size_t times, long usec) {
+  for (size_t idx = 0; idx < times; idx++) {
+    assert(stopwatch_record_start_measurements(routine_id, name, 0) == STOPWATCH_OK);
+    if (usec > 0) {
+      spin_usec(usec);
+    }
+    assert(stopwatch_record_end_measurements(routine_id) == STOPWATCH_OK);
+  }
+}
+
+// An empty routine is moved down one step at a time until it is off, while a slow routine is left alone
+void test_throttle_steps() {
+  setenv("STOPWATCH_OVERHEAD_BUDGET", "0.1", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  call(1, "empty", NUM_HOT_CALLS, 0);
+  call(2, "slow", 100, 1000);
+
+  struct StopwatchThrottleDecision decisions[8];
+  assert(stopwatch_get_throttle_decisions(decisions, 8) == 3);
+  assert(decisions[0].routine_id == 1);
+  assert(decisions[0].thread_index == 0);
+  assert(decisions[0].throttling == STOPWATCH_THROTTLE_SAMPLED);
+  assert(decisions[0].sampling_interval > 1);
+  assert(decisions[0].overhead > 0.001);
+  assert(decisions[1].routine_id == 1);
+  assert(decisions[1].throttling == STOPWATCH_THROTTLE_COUNT_ONLY);
+  assert(decisions[2].routine_id == 1);
+  assert(decisions[2].throttling == STOPWATCH_THROTTLE_OFF);
+  assert(decisions[0].time_usec <= decisions[1].time_usec && decisions[1].time_usec <= decisions[2].time_usec);
+  assert(stopwatch_get_throttle_decisions(decisions, 1) == 1);
+
+  // Invocations after switching off are not counted anymore
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called < NUM_HOT_CALLS);
+  assert(result.sampled_times_called < result.total_times_called);
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 100);
+  assert(result.sampled_times_called == 100);
+
+  // Switched off routines are not the current routine either
+  assert(stopwatch_record_start_measurements(1, "empty", 0) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 0);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+
+  char file_name[64];
+  snprintf(file_name, sizeof(file_name), "overhead_budget_tests_%d.csv", (int) getpid());
+  assert(stopwatch_throttle_decisions_to_csv(file_name) == STOPWATCH_OK);
+  FILE *csv = fopen(file_name, "r");
+  assert(csv != NULL);
+  char line[256];
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  assert(strcmp(line,
+                "ID,NAME,THREAD,TIME_MICROSECONDS,THROTTLED_TO,SAMPLING_INTERVAL,MEAN_REAL_NANOSECONDS,OVERHEAD\n") == 0);
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  assert(strncmp(line, "1,empty,0,", 10) == 0);
+  assert(strstr(line, ",sampled,") != NULL);
+  size_t num_rows = 1;
+  while (fgets(line, sizeof(line), csv) != NULL) {
+    num_rows++;
+  }
+  assert(num_rows == 3);
+  fclose(csv);
+  remove(file_name);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_OVERHEAD_BUDGET");
+}
+
+// Without a budget nothing is throttled and decisions from a previous initialization are gone
+void test_no_budget() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  call(1, "empty", 100000, 0);
+
+  struct StopwatchThrottleDecision decision;
+  assert(stopwatch_get_throttle_decisions(&decision, 1) == 0);
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 100000);
+  assert(result.sampled_times_called == 100000);
+
+  stopwatch_destroy();
+}
+
+int main() {
+  test_throttle_steps();
+  test_no_budget();
+}
@@ -0,0 +1,143 @@
+// Tests for sampled routines, whose totals are scaled up from the invocations that were measured
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stopwatch/stopwatch.h"
+
+// Busy waits rather than sleeping so that every invocation takes about the same time
+static void spin_usec(long usec) {
+  struct timespec start;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < usec);
+}
+
+static void call(size_t routine_id, const char *name, size_t times, long usec) {
+  for (size_t idx = 0; idx < times; idx++) {
+    assert(stopwatch_record_start_measurements(routine_id, name, 0) == STOPWATCH_OK);
+    spin_usec(usec);
+    assert(stopwatch_record_end_measurements(routine_id) == STOPWATCH_OK);
+  }
+}
+
+// Calls stay exact while the time and events are scaled up from every 10th invocation
+void test_fixed_interval() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_enable_sampling(1, 10) == STOPWATCH_OK);
+  assert(stopwatch_enable_sampling(1, STOPWATCH_MAX_SAMPLING_INTERVAL + 1) == STOPWATCH_ERR);
+
+  // Alternating calls see the same load on the machine. Invocations far longer than a measurement keep the overhead of
+  // measuring every invocation out of the comparison, and keep a preempted invocation from dwarfing the others.
+  for (size_t idx = 0; idx < 400; idx++) {
+    call(1, "sampled", 1, 500);
+    call(2, "measured", 1, 500);
+  }
+
+  struct StopwatchMeasurementResult sampled;
+  struct StopwatchMeasurementResult measured;
+  assert(stopwatch_get_measurement_results(1, &sampled) == STOPWATCH_OK);
+  assert(stopwatch_get_measurement_results(2, &measured) == STOPWATCH_OK);
+  assert(sampled.total_times_called == 400);
+  assert(sampled.sampled_times_called == 40);
+  assert(sampled.real_usec_error > 0);
+  assert(measured.total_times_called == 400);
+  assert(measured.sampled_times_called == 400);
+  assert(measured.real_usec_error == 0);
+
+  // Every invocation spins for at least its duration, so the scaled up time cannot fall short of it. Preempting an
+  // invocation that is not sampled only raises the measured time, so the sampled time is only held to the measured one
+  // from above, where preempting a sampled invocation shows in the error.
+  assert(sampled.total_real_usec >= 400 * 500);
+  const double tolerance = fmax(3 * sampled.real_usec_error, 0.25 * (double) measured.total_real_usec);
+  assert((double) (sampled.total_real_usec - measured.total_real_usec) <= tolerance);
+  // Events are scaled the same way as the time. The timer backend that is fallen back to without PAPI has none.
+  assert(sampled.num_of_events == measured.num_of_events);
+  if (measured.num_of_events > 0) {
+    const double sampled_rate = (double) sampled.total_event_values[0] / (double) sampled.total_real_usec;
+    const double measured_rate = (double) measured.total_event_values[0] / (double) measured.total_real_usec;
+    assert(fabs(sampled_rate - measured_rate) <= 0.2 * measured_rate);
+  }
+
+  // Skipped invocations are still the current routine
+  assert(stopwatch_record_start_measurements(1, "sampled", 0) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 1);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  assert(stopwatch_current_routine_id() == 0);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+}
+
+// Routines are sampled by name from the environment and the CSV flags them
+void test_sampled_from_environment() {
+  setenv("STOPWATCH_SAMPLED", "hot*", 1);
+  setenv("STOPWATCH_SAMPLING_INTERVAL", "4", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  call(1, "hot_loop", 100, 0);
+  call(2, "cold", 3, 0);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 100);
+  assert(result.sampled_times_called == 25);
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  assert(result.sampled_times_called == 3);
+
+  const char *file_name = "sampling_tests.csv";
+  assert(stopwatch_result_to_csv(file_name) == STOPWATCH_OK);
+  FILE *file = fopen(file_name, "r");
+  char line[512];
+  assert(fgets(line, sizeof(line), file));
+  assert(strncmp(line, "ID,NAME,CALLER_ID,TIMES_CALLED,TOTAL_REAL_MICROSECONDS,SAMPLED_TIMES_CALLED,REAL_MICROSECONDS_ERROR,",
+                 98) == 0);
+  assert(fgets(line, sizeof(line), file));
+  assert(strncmp(line, "1,hot_loop,0,100,", 17) == 0);
+  fclose(file);
+  remove(file_name);
+  stopwatch_destroy();
+
+  // Random sampling measures the same share of invocations on average
+  setenv("STOPWATCH_SAMPLING_RANDOM", "1", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  call(1, "hot_loop", 10000, 0);
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 10000);
+  assert(result.sampled_times_called > 2000 && result.sampled_times_called < 3000);
+  stopwatch_destroy();
+
+  unsetenv("STOPWATCH_SAMPLING_RANDOM");
+  unsetenv("STOPWATCH_SAMPLING_INTERVAL");
+  unsetenv("STOPWATCH_SAMPLED");
+}
+
+// Routines that cost less than measuring them are thinned out, while long ones keep being measured on every call
+void test_auto_interval() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_enable_sampling(1, 0) == STOPWATCH_OK);
+  assert(stopwatch_enable_sampling(2, 0) == STOPWATCH_OK);
+
+  call(1, "tiny", 100000, 0);
+  call(2, "long", 100, 1000);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 100000);
+  assert(result.sampled_times_called >= 64);
+  assert(result.sampled_times_called < 100000 / 2);
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  assert(result.sampled_times_called == 100);
+  stopwatch_destroy();
+}
+
+int main() {
+  test_fixed_interval();
+  test_sampled_from_environment();
+  test_auto_interval();
+}
@@ -0,0 +1,132 @@
+// Tests for the scoped measurement macros. Also compiled with STOPWATCH_DISABLE defined, in which case nothing may be
+// measured.
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch_scope.h"
+
+// Prevents the compiler from removing the work that is measured
+static volatile int sink = 0;
+
+static void inner() {
+  STOPWATCH_SCOPE("inner");
+  sink++;
+}
+
+static int recurse(int depth) {
+  STOPWATCH_SCOPE("recurse");
+  sink++;
+  return depth > 0 ? recurse(depth - 1) + 1 : 0;
+}
+
+static int outer(int early_return) {
+  STOPWATCH_SCOPE("outer");
+  inner();
+  if (early_return) {
+    return 1;
+  }
+  inner();
+  return 0;
+}
+
+// Searches every routine seen for one with the given name. Returns false if there is none.
+static bool find_routine(const char *name, size_t *routine_id, struct StopwatchMeasurementResult *result) {
+  size_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  const size_t num_routines = stopwatch_get_routine_ids(routine_ids, STOPWATCH_MAX_FUNCTION_CALLS);
+  for (size_t idx = 0; idx < num_routines; idx++) {
+    assert(stopwatch_get_measurement_results(routine_ids[idx], result) == STOPWATCH_OK);
+    if (result->total_times_called > 0 && strcmp(result->routine_name, name) == 0) {
+      *routine_id = routine_ids[idx];
+      return true;
+    }
+  }
+  return false;
+}
+
+// Scopes are registered once, nested under the enclosing scope and ended on every way out of the scope
+void test_scope_nesting() {
+  assert(STOPWATCH_INIT() == STOPWATCH_OK);
+  assert(outer(0) == 0);
+  assert(outer(1) == 1);
+
+  size_t outer_id;
+  size_t inner_id;
+  struct StopwatchMeasurementResult outer_result;
+  struct StopwatchMeasurementResult inner_result;
+#ifdef STOPWATCH_DISABLE
+  assert(!find_routine("outer", &outer_id, &outer_result));
+  assert(!find_routine("inner", &inner_id, &inner_result));
+#else
+  assert(find_routine("outer", &outer_id, &outer_result));
+  assert(find_routine("inner", &inner_id, &inner_result));
+  assert(outer_result.total_times_called == 2);
+  assert(outer_result.caller_routine_id == 0);
+  assert(inner_result.total_times_called == 3);
+  assert(inner_result.caller_routine_id == outer_id);
+#endif
+
+  STOPWATCH_PRINT_RESULT_TABLE();
+  STOPWATCH_DESTROY();
+}
+
+// Nesting within a hand measured region. The stopwatch is initialized directly as the hand measured region is measured
+// even if the macros are disabled.
+void test_scope_in_manual_region() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(1, "manual", 0) == STOPWATCH_OK);
+  {
+    STOPWATCH_SCOPE("in-manual");
+    sink++;
+  }
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+
+  size_t routine_id;
+  struct StopwatchMeasurementResult result;
+#ifdef STOPWATCH_DISABLE
+  assert(!find_routine("in-manual", &routine_id, &result));
+#else
+  assert(find_routine("in-manual", &routine_id, &result));
+  assert(result.total_times_called == 1);
+  assert(result.caller_routine_id == 1);
+#endif
+
+  stopwatch_destroy();
+}
+
+// Every call of a recursive scope is counted, while its time is only measured once by the outermost call, and the
+// innermost region open afterwards is the one that was open before
+void test_recursive_scope() {
+  assert(STOPWATCH_INIT() == STOPWATCH_OK);
+  assert(recurse(3) == 3);
+  assert(recurse(0) == 0);
+  {
+    STOPWATCH_SCOPE("after-recursion");
+    sink++;
+  }
+
+  size_t recurse_id;
+  size_t after_id;
+  struct StopwatchMeasurementResult recurse_result;
+  struct StopwatchMeasurementResult after_result;
+#ifdef STOPWATCH_DISABLE
+  assert(!find_routine("recurse", &recurse_id, &recurse_result));
+#else
+  assert(stopwatch_current_routine_id() == 0);
+  assert(find_routine("recurse", &recurse_id, &recurse_result));
+  assert(recurse_result.total_times_called == 5);
+  assert(recurse_result.sampled_times_called == 5);
+  assert(recurse_result.caller_routine_id == 0);
+  assert(find_routine("after-recursion", &after_id, &after_result));
+  assert(after_result.total_times_called == 1);
+  assert(after_result.caller_routine_id == 0);
+#endif
+
+  STOPWATCH_DESTROY();
+}
+
+int main() {
+  test_scope_nesting();
+  test_scope_in_manual_region();
+  test_recursive_scope();
+}
@@ -0,0 +1,155 @@
+#include "series.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch.h"
+
+// Values that grow, shrink and jump to the extremes round trip exactly
+void test_series_round_trip() {
+  const long long samples[][3] = {{0, 0, 0},
+                                  {100, 5000, -7},
+                                  {101, 4990, 1LL << 40},
+                                  {LLONG_MAX, LLONG_MIN, -1},
+                                  {LLONG_MIN, LLONG_MAX, 0},
+                                  {3, 3, 3}};
+  const size_t num_samples = sizeof(samples) / sizeof(samples[0]);
+
+  struct Series *series = create_series(1024, 1, 3);
+  for (size_t idx = 0; idx < num_samples; idx++) {
+    series_record(series, samples[idx]);
+  }
+  assert(series->num_samples == num_samples);
+  assert(series->num_dropped == 0);
+
+  struct SeriesIter iter;
+  series_iter_init(&iter, series);
+  for (size_t idx = 0; idx < num_samples; idx++) {
+    assert(series_iter_has_next(&iter));
+    assert(series_sample_invocation(series, idx) == (long long) idx + 1);
+    const long long *values = series_iter_next(&iter);
+    assert(memcmp(values, samples[idx], sizeof(samples[idx])) == 0);
+  }
+  assert(!series_iter_has_next(&iter));
+  destroy_series(series);
+}
+
+// Similar consecutive values take a single byte each
+void test_series_compression() {
+  struct Series *series = create_series(1024, 1, 2);
+  const long long first[] = {1000, 123456};
+  const long long second[] = {1010, 123450};
+  series_record(series, first);
+  const size_t first_size = series->size;
+  series_record(series, second);
+  assert(series->size - first_size == 2);
+  destroy_series(series);
+}
+
+// Only every n-th invocation is recorded starting with the first
+void test_series_decimation() {
+  struct Series *series = create_series(1024, 3, 1);
+  for (long long idx = 1; idx <= 10; idx++) {
+    series_record(series, &idx);
+  }
+  assert(series->num_invocations == 10);
+  assert(series->num_samples == 4);
+
+  struct SeriesIter iter;
+  series_iter_init(&iter, series);
+  for (size_t idx = 0; series_iter_has_next(&iter); idx++) {
+    const long long invocation = series_sample_invocation(series, idx);
+    assert(*series_iter_next(&iter) == invocation);
+  }
+  destroy_series(series);
+}
+
+// Samples that do not fit are dropped whole
+void test_series_capacity() {
+  struct Series *series = create_series(5, 1, 2);
+  const long long small[] = {1, 1};
+  const long long large[] = {1000000, 1};
+  series_record(series, small);
+  series_record(series, large);
+  series_record(series, small);
+  assert(series->num_samples == 2);
+  assert(series->num_dropped == 1);
+  assert(series->size <= series->capacity);
+
+  struct SeriesIter iter;
+  series_iter_init(&iter, series);
+  assert(series_iter_next(&iter)[0] == 1);
+  assert(series_iter_next(&iter)[0] == 1);
+  destroy_series(series);
+
+  assert(create_series(16, 0, 1) == NULL);
+  assert(create_series(16, 1, SERIES_MAX_VALUES + 1) == NULL);
+}
+
+// Routines keep a series when enabled explicitly or through the environment
+void test_stopwatch_series() {
+  setenv("STOPWATCH_SERIES", "step*", 1);
+  setenv("STOPWATCH_SERIES_DECIMATION", "2", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_enable_series(2, 1024, 1) == STOPWATCH_OK);
+  assert(stopwatch_enable_series(3, 1024, 0) == STOPWATCH_ERR);
+
+  for (int iter = 0; iter < 10; iter++) {
+    assert(stopwatch_record_start_measurements(1, "step", 0) == STOPWATCH_OK);
+    assert(stopwatch_record_start_measurements(2, "kernel", 1) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+    assert(stopwatch_record_start_measurements(3, "other", 1) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(3) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  }
+
+  struct StopwatchSeriesSample samples[16];
+  struct StopwatchMeasurementResult result;
+
+  // Matched by the environment so every other invocation is kept
+  assert(stopwatch_get_series(1, samples, 16) == 5);
+  assert(samples[4].invocation == 9);
+
+  // Every invocation is kept and the samples add up to the totals
+  assert(stopwatch_get_series(2, samples, 16) == 10);
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  long long real_usec = 0;
+  long long event_value = 0;
+  for (size_t idx = 0; idx < 10; idx++) {
+    assert(samples[idx].invocation == (long long) idx + 1);
+    real_usec += samples[idx].real_usec;
+    event_value += samples[idx].event_values[0];
+  }
+  assert(real_usec == result.total_real_usec);
+  assert(event_value == result.total_event_values[0]);
+  assert(stopwatch_get_series(2, samples, 3) == 3);
+
+  assert(stopwatch_get_series(3, samples, 16) == 0);
+
+  const char *file_name = "series_tests.csv";
+  assert(stopwatch_series_to_csv(file_name) == STOPWATCH_OK);
+  FILE *file = fopen(file_name, "r");
+  char line[256];
+  size_t num_lines = 0;
+  while (fgets(line, sizeof(line), file)) {
+    num_lines++;
+  }
+  fclose(file);
+  remove(file_name);
+  assert(num_lines == 1 + 5 + 10);
+
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_SERIES");
+  unsetenv("STOPWATCH_SERIES_DECIMATION");
+}
+
+int main() {
+  test_series_round_trip();
+  test_series_compression();
+  test_series_decimation();
+  test_series_capacity();
+  test_stopwatch_series();
+}
@@ -0,0 +1,155 @@
+// Tests for publishing the totals to shared memory. Reads the segment the same way an external viewer does.
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+#include "stopwatch/stopwatch_shm.h"
+
+// Routines are published at the entry they were given, so a sparse ID is published as well as a small one
+#define WORKER_ID ((size_t) 0xC2B2AE3D27D4EB4Full)
+
+static char segment_name[64];
+
+static const struct StopwatchShmSegment *map_segment() {
+  const int fd = shm_open(segment_name, O_RDONLY, 0);
+  assert(fd >= 0);
+  const struct StopwatchShmSegment *segment =
+      mmap(NULL, sizeof(struct StopwatchShmSegment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  assert(segment != MAP_FAILED);
+  return segment;
+}
+
+// Entry of the routine whose ID is `routine_id`
+static size_t find_entry(const uint64_t *routine_ids, size_t routine_id) {
+  for (size_t entry = 1; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+    if (routine_ids[entry] == routine_id) {
+      return entry;
+    }
+  }
+  assert(0);
+  return 0;
+}
+
+static void *measure_on_thread(void *arg) {
+  (void) arg;
+  for (int idx = 0; idx < 4; idx++) {
+    assert(stopwatch_record_start_measurements(WORKER_ID, "worker", 0) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(WORKER_ID) == STOPWATCH_OK);
+  }
+  return NULL;
+}
+
+// Totals, names and events of every thread are published after each end measurement
+void test_shm_publish() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  const struct StopwatchShmSegment *segment = map_segment();
+
+  assert(segment->magic == STOPWATCH_SHM_MAGIC);
+  assert(segment->version == STOPWATCH_SHM_VERSION);
+  assert(segment->size == sizeof(struct StopwatchShmSegment));
+  assert(segment->pid == getpid());
+  assert(segment->num_events == 2);
+  assert(strcmp(segment->event_names[0], "PAPI_TOT_CYC") == 0);
+  assert(strcmp(segment->event_names[1], "PAPI_TOT_INS") == 0);
+
+  for (int idx = 0; idx < 3; idx++) {
+    assert(stopwatch_record_start_measurements(1, "outer", 0) == STOPWATCH_OK);
+    assert(stopwatch_record_start_measurements(2, "inner", 1) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  }
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, measure_on_thread, NULL) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+
+  assert(segment->num_threads == 2);
+
+  static uint64_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  static char routine_names[STOPWATCH_MAX_FUNCTION_CALLS][NULL_TERM_MAX_ROUTINE_NAME_LEN];
+  static uint64_t caller_routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  stopwatch_shm_read_routines(segment, routine_ids, routine_names, caller_routine_ids);
+  const size_t outer = find_entry(routine_ids, 1);
+  const size_t inner = find_entry(routine_ids, 2);
+  const size_t worker = find_entry(routine_ids, WORKER_ID);
+  assert(strcmp(routine_names[outer], "outer") == 0);
+  assert(strcmp(routine_names[inner], "inner") == 0);
+  assert(strcmp(routine_names[worker], "worker") == 0);
+  assert(caller_routine_ids[inner] == 1);
+
+  static struct StopwatchShmRoutine main_totals[STOPWATCH_MAX_FUNCTION_CALLS];
+  static struct StopwatchShmRoutine worker_totals[STOPWATCH_MAX_FUNCTION_CALLS];
+  assert(stopwatch_shm_read_thread(&segment->threads[0], main_totals) == 1);
+  assert(stopwatch_shm_read_thread(&segment->threads[1], worker_totals) == 1);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(main_totals[outer].total_times_called == 3);
+  assert(main_totals[outer].total_real_usec == result.total_real_usec);
+  assert(main_totals[outer].total_event_values[0] == result.total_event_values[0]);
+  assert(main_totals[inner].total_times_called == 3);
+  assert(main_totals[worker].total_times_called == 0);
+  assert(worker_totals[worker].total_times_called == 4);
+
+  // Resetting is published as well
+  stopwatch_reset();
+  assert(stopwatch_shm_read_thread(&segment->threads[0], main_totals) == 1);
+  assert(main_totals[outer].total_times_called == 0);
+
+  munmap((void *) segment, sizeof(struct StopwatchShmSegment));
+  stopwatch_destroy();
+
+  // Unlinked by destroy
+  assert(shm_open(segment_name, O_RDONLY, 0) < 0);
+}
+
+// Invocations that sampling skips are only counted, and their calls are published as well
+void test_shm_publish_sampled() {
+  setenv("STOPWATCH_SAMPLED", "sampled", 1);
+  setenv("STOPWATCH_SAMPLING_INTERVAL", "4", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  const struct StopwatchShmSegment *segment = map_segment();
+
+  // The first and fifth invocations are measured
+  for (int idx = 0; idx < 7; idx++) {
+    assert(stopwatch_record_start_measurements(3, "sampled", 0) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(3) == STOPWATCH_OK);
+  }
+
+  static uint64_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  static char routine_names[STOPWATCH_MAX_FUNCTION_CALLS][NULL_TERM_MAX_ROUTINE_NAME_LEN];
+  static uint64_t caller_routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  stopwatch_shm_read_routines(segment, routine_ids, routine_names, caller_routine_ids);
+  static struct StopwatchShmRoutine totals[STOPWATCH_MAX_FUNCTION_CALLS];
+  assert(stopwatch_shm_read_thread(&segment->threads[0], totals) == 1);
+  assert(totals[find_entry(routine_ids, 3)].total_times_called == 7);
+
+  munmap((void *) segment, sizeof(struct StopwatchShmSegment));
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_SAMPLING_INTERVAL");
+  unsetenv("STOPWATCH_SAMPLED");
+}
+
+// Nothing is published without a segment name
+void test_shm_unset() {
+  unsetenv("STOPWATCH_SHM");
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(1, "outer", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  assert(shm_open(segment_name, O_RDONLY, 0) < 0);
+  stopwatch_destroy();
+}
+
+int main() {
+  snprintf(segment_name, sizeof(segment_name), "/stopwatch_shm_tests_%d", (int) getpid());
+  setenv("STOPWATCH_SHM", segment_name, 1);
+  test_shm_publish();
+  test_shm_publish_sampled();
+  test_shm_unset();
+}
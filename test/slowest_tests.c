@@ -0,0 +1,156 @@
+#include "slowest.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+
+static void sleep_usec(long usec) {
+  const struct timespec delay = {usec / 1000000, (usec % 1000000) * 1000};
+  nanosleep(&delay, NULL);
+}
+
+// The heap keeps the largest durations seen in any order of arrival
+void test_slowest_heap() {
+  const long long durations[] = {5, 1, 9, 3, 7, 9, 2, 8, 6, 4};
+  const size_t num_durations = sizeof(durations) / sizeof(durations[0]);
+
+  struct SlowestInvocations *slowest = create_slowest(4);
+  for (size_t idx = 0; idx < num_durations; idx++) {
+    struct StopwatchInvocation invocation = {0};
+    invocation.start_usec = (long long) idx;
+    invocation.real_usec = durations[idx];
+    slowest_record(slowest, &invocation);
+  }
+  assert(slowest->size == 4);
+  assert(!slowest_qualifies(slowest, 7));
+  assert(slowest_qualifies(slowest, 8));
+
+  struct StopwatchInvocation sorted[4];
+  assert(slowest_sorted(slowest, sorted) == 4);
+  const long long expected_durations[] = {9, 9, 8, 7};
+  for (size_t idx = 0; idx < 4; idx++) {
+    assert(sorted[idx].real_usec == expected_durations[idx]);
+  }
+  // Ties keep the earlier start first
+  assert(sorted[0].start_usec == 2);
+  assert(sorted[1].start_usec == 5);
+  destroy_slowest(slowest);
+
+  assert(create_slowest(0) == NULL);
+}
+
+static void *measure_on_thread(void *arg) {
+  (void) arg;
+  assert(stopwatch_record_start_measurements(2, "step", 1) == STOPWATCH_OK);
+  sleep_usec(300000);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  return NULL;
+}
+
+// Each invocation records when it started, on which thread and which invocation of its caller it was part of
+void test_slowest_invocations() {
+  setenv("STOPWATCH_SLOWEST", "3", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  // The long steps are an order of magnitude longer than the short ones, so that a loaded machine delaying the short
+  // steps cannot make them slowest. The order of the long steps is only checked through the measured durations.
+  const long step_usec[] = {1000, 60000, 1000, 1000, 90000, 30000};
+  const size_t num_steps = sizeof(step_usec) / sizeof(step_usec[0]);
+  assert(stopwatch_record_start_measurements(1, "solve", 0) == STOPWATCH_OK);
+  for (size_t idx = 0; idx < num_steps; idx++) {
+    assert(stopwatch_record_start_measurements(2, "step", 1) == STOPWATCH_OK);
+    sleep_usec(step_usec[idx]);
+    assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+  }
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+
+  struct StopwatchInvocation invocations[STOPWATCH_MAX_SLOWEST];
+  assert(stopwatch_get_slowest(2, invocations, STOPWATCH_MAX_SLOWEST) == 3);
+  // Steps 2, 5 and 6, slowest first
+  for (size_t idx = 0; idx < 3; idx++) {
+    assert(invocations[idx].real_usec >= 30000);
+  }
+  assert(invocations[0].real_usec >= invocations[1].real_usec);
+  assert(invocations[1].real_usec >= invocations[2].real_usec);
+
+  struct StopwatchInvocation solve;
+  assert(stopwatch_get_slowest(1, &solve, 1) == 1);
+  assert(solve.caller_routine_id == 0);
+  assert(solve.caller_start_usec == -1);
+  for (size_t idx = 0; idx < 3; idx++) {
+    assert(invocations[idx].routine_id == 2);
+    assert(invocations[idx].thread_index == 0);
+    assert(invocations[idx].caller_routine_id == 1);
+    assert(invocations[idx].caller_start_usec == solve.start_usec);
+    assert(invocations[idx].start_usec >= solve.start_usec);
+  }
+
+  // The slowest are merged over all threads
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, measure_on_thread, NULL) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+  // The step of the thread is an order of magnitude longer than the third slowest step of the initializing thread
+  assert(stopwatch_get_slowest(2, invocations, STOPWATCH_MAX_SLOWEST) == 3);
+  size_t num_thread_steps = 0;
+  for (size_t idx = 0; idx < 3; idx++) {
+    assert(idx == 0 || invocations[idx - 1].real_usec >= invocations[idx].real_usec);
+    if (invocations[idx].thread_index == 1) {
+      num_thread_steps++;
+      assert(invocations[idx].real_usec >= 300000);
+      assert(invocations[idx].caller_routine_id == 1);
+      assert(invocations[idx].caller_start_usec == -1);
+    } else {
+      assert(invocations[idx].thread_index == 0);
+    }
+  }
+  assert(num_thread_steps == 1);
+
+  stopwatch_print_result_table();
+
+  char file_name[64];
+  snprintf(file_name, sizeof(file_name), "/tmp/stopwatch_slowest_%d.csv", (int) getpid());
+  assert(stopwatch_slowest_to_csv(file_name) == STOPWATCH_OK);
+  FILE *file = fopen(file_name, "r");
+  assert(file);
+  char line[512];
+  assert(fgets(line, sizeof(line), file));
+  assert(strncmp(line, "ID,NAME,THREAD,START_MICROSECONDS,REAL_MICROSECONDS,CALLER_ID,CALLER_START_MICROSECONDS,", 88) ==
+         0);
+  size_t num_rows = 0;
+  while (fgets(line, sizeof(line), file)) {
+    num_rows++;
+  }
+  // One solve and the three slowest steps
+  assert(num_rows == 4);
+  fclose(file);
+  remove(file_name);
+
+  // Resetting clears them along with the totals
+  stopwatch_reset();
+  assert(stopwatch_get_slowest(2, invocations, STOPWATCH_MAX_SLOWEST) == 0);
+
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_SLOWEST");
+}
+
+// Nothing is kept unless enabled
+void test_slowest_disabled() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(stopwatch_record_start_measurements(1, "solve", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  struct StopwatchInvocation invocation;
+  assert(stopwatch_get_slowest(1, &invocation, 1) == 0);
+  stopwatch_destroy();
+}
+
+int main() {
+  test_slowest_heap();
+  test_slowest_invocations();
+  test_slowest_disabled();
+}
@@ -0,0 +1,131 @@
+// Tests for snapshots of the totals and for resetting them without re-initializing
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stopwatch/stopwatch.h"
+
+static void measure(size_t routine_id, const char *name, size_t times) {
+  for (size_t idx = 0; idx < times; idx++) {
+    assert(stopwatch_record_start_measurements(routine_id, name, 0) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(routine_id) == STOPWATCH_OK);
+  }
+}
+
+static long long snapshot_times_called(const struct StopwatchSnapshot *snapshot, size_t routine_id) {
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_snapshot_get_results(snapshot, routine_id, &result) == STOPWATCH_OK);
+  return result.total_times_called;
+}
+
+// Snapshots are unaffected by later measurements and their difference holds what was measured in between
+void test_snapshot_phases() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  measure(1, "setup", 2);
+  struct StopwatchSnapshot *after_setup = stopwatch_snapshot();
+  measure(2, "solve", 5);
+  measure(1, "setup", 1);
+  struct StopwatchSnapshot *after_solve = stopwatch_snapshot();
+
+  assert(snapshot_times_called(after_setup, 1) == 2);
+  assert(snapshot_times_called(after_setup, 2) == 0);
+  assert(snapshot_times_called(after_solve, 1) == 3);
+  assert(snapshot_times_called(after_solve, 2) == 5);
+
+  struct StopwatchSnapshot *solve_phase = stopwatch_snapshot_diff(after_setup, after_solve);
+  assert(snapshot_times_called(solve_phase, 1) == 1);
+  assert(snapshot_times_called(solve_phase, 2) == 5);
+
+  struct StopwatchMeasurementResult result;
+  struct StopwatchMeasurementResult diff_result;
+  struct StopwatchMeasurementResult before_result;
+  assert(stopwatch_snapshot_get_results(after_solve, 2, &result) == STOPWATCH_OK);
+  assert(stopwatch_snapshot_get_results(after_setup, 2, &before_result) == STOPWATCH_OK);
+  assert(stopwatch_snapshot_get_results(solve_phase, 2, &diff_result) == STOPWATCH_OK);
+  assert(strcmp(diff_result.routine_name, "solve") == 0);
+  assert(diff_result.total_real_usec == result.total_real_usec - before_result.total_real_usec);
+  assert(diff_result.num_of_events == result.num_of_events);
+  for (size_t idx = 0; idx < result.num_of_events; idx++) {
+    assert(diff_result.total_event_values[idx] ==
+        result.total_event_values[idx] - before_result.total_event_values[idx]);
+  }
+  // The extremes of the phase cannot be taken apart from those before it
+  assert(result.event_extremes_known);
+  assert(!diff_result.event_extremes_known);
+  for (size_t idx = 0; idx < diff_result.num_of_events; idx++) {
+    assert(diff_result.min_event_values[idx] == 0 && diff_result.max_event_values[idx] == 0);
+  }
+  // Routines that were never seen have an empty result
+  assert(stopwatch_snapshot_get_results(solve_phase, STOPWATCH_MAX_FUNCTION_CALLS, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 0);
+
+  stopwatch_print_snapshot_table(solve_phase);
+
+  const char *file_name = "snapshot_tests.csv";
+  assert(stopwatch_snapshot_to_csv(solve_phase, file_name) == STOPWATCH_OK);
+  FILE *file = fopen(file_name, "r");
+  char line[256];
+  size_t num_lines = 0;
+  while (fgets(line, sizeof(line), file)) {
+    num_lines++;
+  }
+  fclose(file);
+  remove(file_name);
+  assert(num_lines == 3);
+
+  stopwatch_destroy_snapshot(solve_phase);
+  stopwatch_destroy_snapshot(after_solve);
+  stopwatch_destroy_snapshot(after_setup);
+  stopwatch_destroy();
+}
+
+// Resetting clears the totals while routines being measured still end normally
+void test_reset() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+
+  measure(2, "setup", 3);
+  assert(stopwatch_record_start_measurements(1, "outer", 0) == STOPWATCH_OK);
+  stopwatch_reset();
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 0);
+  assert(result.total_real_usec == 0);
+  for (size_t idx = 0; idx < result.num_of_events; idx++) {
+    assert(result.total_event_values[idx] == 0);
+  }
+
+  measure(2, "setup", 1);
+  assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 1);
+  assert(stopwatch_get_measurement_results(2, &result) == STOPWATCH_OK);
+  assert(result.total_times_called == 1);
+
+  stopwatch_destroy();
+}
+
+// Snapshots of different events cannot be compared
+void test_snapshot_diff_different_events() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  struct StopwatchSnapshot *before = stopwatch_snapshot();
+  stopwatch_destroy();
+
+  setenv("STOPWATCH_EVENTS", "PAPI_TOT_INS", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  struct StopwatchSnapshot *after = stopwatch_snapshot();
+  assert(stopwatch_snapshot_diff(before, after) == NULL);
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_EVENTS");
+
+  stopwatch_destroy_snapshot(before);
+  stopwatch_destroy_snapshot(after);
+}
+
+int main() {
+  test_snapshot_phases();
+  test_reset();
+  test_snapshot_diff_different_events();
+}
@@ -3,6 +3,8 @@
 // Currently there is a subtle issue where each test is not isolated from each other.
 #include "stopwatch/stopwatch.h"
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 // Initialize and destroy the event timers once
@@ -40,11 +42,36 @@ void test_stopwatch_times_called_initial_value() {
   }
 }
 
+// The events named in `STOPWATCH_EVENTS` are described in the same order, and stay described after destroying
+void test_stopwatch_event_info() {
+  setenv("STOPWATCH_EVENTS", "PAPI_TOT_INS,PAPI_TOT_CYC", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  unsetenv("STOPWATCH_EVENTS");
+
+  assert(stopwatch_num_events() == 2);
+  struct StopwatchEventInfo info;
+  assert(stopwatch_get_event_info(0, &info) == STOPWATCH_OK);
+  assert(strcmp(info.name, "PAPI_TOT_INS") == 0);
+  const int tot_ins_code = info.code;
+  assert(info.description[0] != '\0');
+  assert(info.component[0] != '\0');
+  assert(strcmp(stopwatch_event_name(1), "PAPI_TOT_CYC") == 0);
+  assert(stopwatch_get_event_info(2, &info) == STOPWATCH_ERR);
+  assert(stopwatch_event_name(2) == NULL);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.event_names[0] == tot_ins_code);
+  stopwatch_destroy();
+  assert(strcmp(stopwatch_event_name(0), "PAPI_TOT_INS") == 0);
+}
+
 int main() {
   test_stopwatch_setup_teardown();
   test_stopwatch_setup_teardown_multiple_times();
   test_stopwatch_setup_twice();
   //test_stopwatch_teardown_twice();
   test_stopwatch_times_called_initial_value();
+  test_stopwatch_event_info();
 }
 
@@ -0,0 +1,168 @@
+// Tests for the work counters, which count units of work done by a routine and derive its rates from them
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch.h"
+
+#define NUM_CALLS 10
+#define ITEMS_PER_CALL 100
+#define BYTES_PER_CALL 4096
+
+// Busy waits rather than sleeping so that the events keep counting
+static void spin_usec(long usec) {
+  struct timespec start;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < usec);
+}
+
+static void run_kernel(size_t times) {
+  for (size_t idx = 0; idx < times; idx++) {
+    assert(stopwatch_record_start_measurements(1, "kernel", 0) == STOPWATCH_OK);
+    spin_usec(200);
+    assert(stopwatch_add_work(1, 0, ITEMS_PER_CALL) == STOPWATCH_OK);
+    assert(stopwatch_add_work(1, 1, BYTES_PER_CALL) == STOPWATCH_OK);
+    assert(stopwatch_record_end_measurements(1) == STOPWATCH_OK);
+  }
+}
+
+// Copies the field at `col` of the comma delimited `line` into `field`
+static void get_field(const char *line, size_t col, char *field, size_t field_size) {
+  for (size_t idx = 0; idx < col; idx++) {
+    line = strchr(line, ',');
+    assert(line != NULL);
+    line++;
+  }
+  const size_t length = strcspn(line, ",\n");
+  assert(length < field_size);
+  memcpy(field, line, length);
+  field[length] = '\0';
+}
+
+// Work is summed like the events and the rates are derived from it in every output
+void test_named_counters() {
+  setenv("STOPWATCH_WORK_COUNTERS", "items,bytes", 1);
+  assert(stopwatch_init() == STOPWATCH_OK);
+  assert(strcmp(stopwatch_work_counter_name(0), "items") == 0);
+  assert(strcmp(stopwatch_work_counter_name(1), "bytes") == 0);
+  assert(strcmp(stopwatch_work_counter_name(2), "WORK2") == 0);
+  assert(stopwatch_work_counter_name(STOPWATCH_MAX_WORK_COUNTERS) == NULL);
+
+  run_kernel(NUM_CALLS);
+  assert(stopwatch_record_start_measurements(2, "idle", 0) == STOPWATCH_OK);
+  assert(stopwatch_record_end_measurements(2) == STOPWATCH_OK);
+
+  assert(stopwatch_add_work(1, STOPWATCH_MAX_WORK_COUNTERS, 1) == STOPWATCH_ERR);
+
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_work[0] == NUM_CALLS * ITEMS_PER_CALL);
+  assert(result.total_work[1] == NUM_CALLS * BYTES_PER_CALL);
+  assert(result.total_work[2] == 0);
+  const long long real_usec = result.total_real_usec;
+  const long long first_event = result.total_event_values[0];
+
+  char file_name[64];
+  snprintf(file_name, sizeof(file_name), "work_tests_%d.csv", (int) getpid());
+  assert(stopwatch_result_to_csv(file_name) == STOPWATCH_OK);
+  FILE *csv = fopen(file_name, "r");
+  assert(csv != NULL);
+  char line[1024];
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  // Only the named counters are reported as nothing else was added to
+  char expected[512];
+  const size_t num_events = stopwatch_num_events();
+  // Each event has its total, smallest, largest and standard deviation
+  const size_t work_col = 5 + 4 * num_events;
+  char field[128];
+  get_field(line, work_col, field, sizeof(field));
+  assert(strcmp(field, "items") == 0);
+  get_field(line, work_col + 1, field, sizeof(field));
+  assert(strcmp(field, "items_PER_SECOND") == 0);
+  get_field(line, work_col + 2, field, sizeof(field));
+  assert(strcmp(field, "NANOSECONDS_PER_items") == 0);
+  snprintf(expected, sizeof(expected), "%s_PER_items", stopwatch_event_name(0));
+  get_field(line, work_col + 3, field, sizeof(field));
+  assert(strcmp(field, expected) == 0);
+  get_field(line, work_col + 3 + num_events, field, sizeof(field));
+  assert(strcmp(field, "bytes") == 0);
+  assert(strstr(line, "WORK2") == NULL);
+
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  assert(strncmp(line, "1,kernel,", 9) == 0);
+  get_field(line, work_col, field, sizeof(field));
+  assert(atoll(field) == NUM_CALLS * ITEMS_PER_CALL);
+  get_field(line, work_col + 1, field, sizeof(field));
+  assert(fabs(atof(field) - NUM_CALLS * ITEMS_PER_CALL * 1e6 / (double) real_usec) < 1);
+  get_field(line, work_col + 2, field, sizeof(field));
+  assert(fabs(atof(field) - (double) real_usec * 1e3 / (NUM_CALLS * ITEMS_PER_CALL)) < 1);
+  get_field(line, work_col + 3, field, sizeof(field));
+  assert(fabs(atof(field) - (double) first_event / (NUM_CALLS * ITEMS_PER_CALL)) < 1);
+
+  // A routine without work has no rates
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  assert(strncmp(line, "2,idle,", 7) == 0);
+  get_field(line, work_col, field, sizeof(field));
+  assert(strcmp(field, "0") == 0);
+  get_field(line, work_col + 1, field, sizeof(field));
+  assert(strcmp(field, "") == 0);
+  fclose(csv);
+  remove(file_name);
+
+  stopwatch_print_result_table();
+  stopwatch_destroy();
+  unsetenv("STOPWATCH_WORK_COUNTERS");
+}
+
+// Unnamed counters are reported once added to, snapshots subtract work and resetting clears it
+void test_unnamed_counters() {
+  assert(stopwatch_init() == STOPWATCH_OK);
+  struct StopwatchSnapshot *before = stopwatch_snapshot();
+  run_kernel(NUM_CALLS);
+  assert(stopwatch_add_work(1, 3, 7) == STOPWATCH_OK);
+  struct StopwatchSnapshot *after = stopwatch_snapshot();
+
+  struct StopwatchSnapshot *diff = stopwatch_snapshot_diff(before, after);
+  assert(diff != NULL);
+  struct StopwatchMeasurementResult result;
+  assert(stopwatch_snapshot_get_results(diff, 1, &result) == STOPWATCH_OK);
+  assert(result.total_work[0] == NUM_CALLS * ITEMS_PER_CALL);
+  assert(result.total_work[3] == 7);
+
+  char file_name[64];
+  snprintf(file_name, sizeof(file_name), "work_tests_%d.csv", (int) getpid());
+  assert(stopwatch_snapshot_to_csv(diff, file_name) == STOPWATCH_OK);
+  FILE *csv = fopen(file_name, "r");
+  assert(csv != NULL);
+  char line[2048];
+  assert(fgets(line, sizeof(line), csv) != NULL);
+  // Counters keep their index, so the ones before the last one used are reported as well
+  assert(strstr(line, ",WORK0,") != NULL);
+  assert(strstr(line, ",WORK2,") != NULL);
+  assert(strstr(line, ",WORK3,") != NULL);
+  fclose(csv);
+  remove(file_name);
+  stopwatch_print_snapshot_table(diff);
+
+  stopwatch_destroy_snapshot(diff);
+  stopwatch_destroy_snapshot(after);
+  stopwatch_destroy_snapshot(before);
+
+  stopwatch_reset();
+  assert(stopwatch_get_measurement_results(1, &result) == STOPWATCH_OK);
+  assert(result.total_work[0] == 0);
+  assert(result.total_work[3] == 0);
+  stopwatch_destroy();
+}
+
+int main() {
+  test_named_counters();
+  test_unnamed_counters();
+}
@@ -0,0 +1,268 @@
+// Live viewer of the totals that a program measured with the stopwatch publishes to shared memory when it is run with
+// `STOPWATCH_SHM` set. Maps the segment read only and never writes to it, so the measured program is not slowed down.
+//
+//   stopwatch-top [-d seconds] [-n refreshes] [-k routines] <segment name>
+//
+// Every refresh shows the routines whose totals changed the most since the previous refresh, as rates per second.
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stopwatch/stopwatch_shm.h"
+
+#define DEFAULT_NUM_ROUTINES 20
+
+// Totals of every routine summed over all threads at one point in time
+struct Sample {
+  struct timespec time;
+  struct StopwatchShmRoutine totals[STOPWATCH_MAX_FUNCTION_CALLS];
+};
+
+// Change of a routine between two samples
+struct Rate {
+  size_t entry;
+  double calls_per_sec;
+  double real_usec_per_sec;
+  double events_per_sec[STOPWATCH_MAX_EVENTS];
+};
+
+// =====================================================================================================================
+// Helper functions definitions
+// =====================================================================================================================
+static const struct StopwatchShmSegment *attach(const char *name);
+
+static void take_sample(const struct StopwatchShmSegment *segment, struct Sample *sample);
+
+static size_t compute_rates(const struct StopwatchShmSegment *segment,
+                            const struct Sample *before,
+                            const struct Sample *after,
+                            struct Rate *rates);
+
+static int compare_rates(const void *lhs, const void *rhs);
+
+static void print_rates(const struct StopwatchShmSegment *segment,
+                        const char *name,
+                        const struct Rate *rates,
+                        size_t num_rates,
+                        size_t max_rates);
+
+static void usage(const char *program);
+
+// =====================================================================================================================
+// Main
+// =====================================================================================================================
+int main(int argc, char **argv) {
+  double interval = 1.0;
+  long num_refreshes = -1;
+  size_t max_rates = DEFAULT_NUM_ROUTINES;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:n:k:h")) != -1) {
+    switch (opt) {
+      case 'd':
+        interval = strtod(optarg, NULL);
+        break;
+      case 'n':
+        num_refreshes = strtol(optarg, NULL, 10);
+        break;
+      case 'k':
+        max_rates = (size_t) strtoul(optarg, NULL, 10);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1 || interval <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *name = argv[optind];
+
+  const struct StopwatchShmSegment *segment = attach(name);
+  if (segment == NULL) {
+    return 1;
+  }
+
+  struct Sample *before = malloc(sizeof(struct Sample));
+  struct Sample *after = malloc(sizeof(struct Sample));
+  struct Rate *rates = malloc(sizeof(struct Rate) * STOPWATCH_MAX_FUNCTION_CALLS);
+  if (before == NULL || after == NULL || rates == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  const struct timespec sleep_time = {(time_t) interval, (long) ((interval - (double) (time_t) interval) * 1e9)};
+  take_sample(segment, before);
+  for (long refresh = 0; num_refreshes < 0 || refresh < num_refreshes; refresh++) {
+    nanosleep(&sleep_time, NULL);
+    take_sample(segment, after);
+
+    const size_t num_rates = compute_rates(segment, before, after, rates);
+    print_rates(segment, name, rates, num_rates, max_rates);
+
+    struct Sample *tmp = before;
+    before = after;
+    after = tmp;
+
+    // The segment stays mapped after the program exits but nothing changes anymore
+    if (kill((pid_t) segment->pid, 0) != 0 && errno == ESRCH) {
+      printf("Process %lld has exited\n", (long long) segment->pid);
+      break;
+    }
+  }
+
+  free(rates);
+  free(after);
+  free(before);
+  munmap((void *) segment, sizeof(struct StopwatchShmSegment));
+  return 0;
+}
+
+// =====================================================================================================================
+// Helper functions implementations
+// =====================================================================================================================
+static const struct StopwatchShmSegment *attach(const char *name) {
+  const int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot open shared memory segment %s: %s\n", name, strerror(errno));
+    return NULL;
+  }
+
+  struct stat segment_stat;
+  if (fstat(fd, &segment_stat) != 0 || (size_t) segment_stat.st_size < sizeof(struct StopwatchShmSegment)) {
+    fprintf(stderr, "%s is not a stopwatch segment of this version\n", name);
+    close(fd);
+    return NULL;
+  }
+
+  const struct StopwatchShmSegment *segment =
+      mmap(NULL, sizeof(struct StopwatchShmSegment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) {
+    fprintf(stderr, "Cannot map shared memory segment %s: %s\n", name, strerror(errno));
+    return NULL;
+  }
+
+  if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != STOPWATCH_SHM_MAGIC ||
+      segment->version != STOPWATCH_SHM_VERSION || segment->size != sizeof(struct StopwatchShmSegment)) {
+    fprintf(stderr, "%s is not a stopwatch segment of this version\n", name);
+    munmap((void *) segment, sizeof(struct StopwatchShmSegment));
+    return NULL;
+  }
+  return segment;
+}
+
+static void take_sample(const struct StopwatchShmSegment *segment, struct Sample *sample) {
+  static struct StopwatchShmRoutine thread_totals[STOPWATCH_MAX_FUNCTION_CALLS];
+
+  clock_gettime(CLOCK_MONOTONIC, &sample->time);
+  memset(sample->totals, 0, sizeof(sample->totals));
+
+  uint64_t num_threads = __atomic_load_n(&segment->num_threads, __ATOMIC_ACQUIRE);
+  if (num_threads > STOPWATCH_SHM_MAX_THREADS) {
+    num_threads = STOPWATCH_SHM_MAX_THREADS;
+  }
+  for (uint64_t thread = 0; thread < num_threads; thread++) {
+    stopwatch_shm_read_thread(&segment->threads[thread], thread_totals);
+    for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+      struct StopwatchShmRoutine *total = &sample->totals[entry];
+      total->total_times_called += thread_totals[entry].total_times_called;
+      total->total_real_usec += thread_totals[entry].total_real_usec;
+      for (size_t idx = 0; idx < STOPWATCH_MAX_EVENTS; idx++) {
+        total->total_event_values[idx] += thread_totals[entry].total_event_values[idx];
+      }
+    }
+  }
+}
+
+// Computes the rates of the routines that were called between the samples, fastest growing real time first. Returns
+// the number of rates.
+static size_t compute_rates(const struct StopwatchShmSegment *segment,
+                            const struct Sample *before,
+                            const struct Sample *after,
+                            struct Rate *rates) {
+  const double elapsed_sec = (double) (after->time.tv_sec - before->time.tv_sec) +
+      (double) (after->time.tv_nsec - before->time.tv_nsec) / 1e9;
+
+  size_t num_rates = 0;
+  for (size_t entry = 0; entry < STOPWATCH_MAX_FUNCTION_CALLS; entry++) {
+    const struct StopwatchShmRoutine *old_total = &before->totals[entry];
+    const struct StopwatchShmRoutine *new_total = &after->totals[entry];
+    // Totals shrink when the program resets them
+    if (new_total->total_times_called <= old_total->total_times_called) {
+      continue;
+    }
+
+    struct Rate *rate = &rates[num_rates++];
+    rate->entry = entry;
+    rate->calls_per_sec = (double) (new_total->total_times_called - old_total->total_times_called) / elapsed_sec;
+    rate->real_usec_per_sec = (double) (new_total->total_real_usec - old_total->total_real_usec) / elapsed_sec;
+    for (size_t idx = 0; idx < segment->num_events && idx < STOPWATCH_MAX_EVENTS; idx++) {
+      rate->events_per_sec[idx] =
+          (double) (new_total->total_event_values[idx] - old_total->total_event_values[idx]) / elapsed_sec;
+    }
+  }
+
+  qsort(rates, num_rates, sizeof(struct Rate), compare_rates);
+  return num_rates;
+}
+
+static int compare_rates(const void *lhs, const void *rhs) {
+  const double lhs_rate = ((const struct Rate *) lhs)->real_usec_per_sec;
+  const double rhs_rate = ((const struct Rate *) rhs)->real_usec_per_sec;
+  return (lhs_rate < rhs_rate) - (lhs_rate > rhs_rate);
+}
+
+static void print_rates(const struct StopwatchShmSegment *segment,
+                        const char *name,
+                        const struct Rate *rates,
+                        size_t num_rates,
+                        size_t max_rates) {
+  static uint64_t routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  static char routine_names[STOPWATCH_MAX_FUNCTION_CALLS][NULL_TERM_MAX_ROUTINE_NAME_LEN];
+  static uint64_t caller_routine_ids[STOPWATCH_MAX_FUNCTION_CALLS];
+  stopwatch_shm_read_routines(segment, routine_ids, routine_names, caller_routine_ids);
+
+  // Redraw in place when watched from a terminal
+  if (isatty(STDOUT_FILENO)) {
+    printf("\033[H\033[2J");
+  }
+  printf("%s (pid %lld)\n", name, (long long) segment->pid);
+  printf("%5s %-16s %12s %14s", "ID", "NAME", "CALLS/S", "REAL USEC/S");
+  for (size_t idx = 0; idx < segment->num_events && idx < STOPWATCH_MAX_EVENTS; idx++) {
+    printf(" %16.*s", STOPWATCH_SHM_EVENT_NAME_LEN, segment->event_names[idx]);
+  }
+  printf("\n");
+
+  for (size_t row = 0; row < num_rates && row < max_rates; row++) {
+    const struct Rate *rate = &rates[row];
+    printf("%5llu %-16s %12.1f %14.1f",
+           (unsigned long long) routine_ids[rate->entry],
+           routine_names[rate->entry],
+           rate->calls_per_sec,
+           rate->real_usec_per_sec);
+    for (size_t idx = 0; idx < segment->num_events && idx < STOPWATCH_MAX_EVENTS; idx++) {
+      printf(" %16.4g", rate->events_per_sec[idx]);
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [-d seconds] [-n refreshes] [-k routines] <segment name>\n"
+          "  -d  Seconds between refreshes. Defaults to 1\n"
+          "  -n  Number of refreshes before exiting. Refreshes until the program exits by default\n"
+          "  -k  Number of routines shown. Defaults to %d\n",
+          program,
+          DEFAULT_NUM_ROUTINES);
+}